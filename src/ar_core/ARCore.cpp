@@ -6,6 +6,8 @@
 #include <custom_conversions/Conversions.h>
 #include <pwd.h>
 #include "ControlEvents.h"
+#include "ImageKernels.h"
+#include <sensor_msgs/image_encodings.h>
 #include <src/arm_to_world_calibration/ArmToWorldCalibration.h>
 // tasks
 #include "src/ar_core/tasks/TaskBuzzWire.h"
@@ -19,8 +21,20 @@
 
 // -----------------------------------------------------------------------------
 ARCore::ARCore(std::string node_name)
-        : n(node_name), running_task_id(0), task_ptr(NULL)
+        : ARCore(ros::NodeHandle(node_name))
 {
+}
+
+// -----------------------------------------------------------------------------
+ARCore::ARCore(const ros::NodeHandle &node_handle)
+        : n(node_handle), n_images(n), n_kinematics(n), n_control(n),
+          running_task_id(0), task_ptr(NULL),
+          frame_scheduler(NULL), ingest_bytes_copied(0)
+{
+    n_images.setCallbackQueue(&image_callback_queue);
+    n_kinematics.setCallbackQueue(&kinematics_callback_queue);
+    n_control.setCallbackQueue(&control_callback_queue);
+
     // assign the callback functions
     pose_current_tool_callbacks[0] = &ARCore::Tool1PoseCurrentCallback;
     pose_current_tool_callbacks[1] = &ARCore::Tool2PoseCurrentCallback;
@@ -28,11 +42,20 @@ ARCore::ARCore(std::string node_name)
     gripper_callbacks[0] = &ARCore::Tool1GripperCurrentCallback;
     gripper_callbacks[1] = &ARCore::Tool2GripperCurrentCallback;
 
-    it = new image_transport::ImageTransport(n);
+    it = new image_transport::ImageTransport(n_images);
 
     SetupROSandGetParameters();
 
     SetupGraphics();
+
+    SetupFrameScheduler();
+
+    SetupQualityGovernor();
+}
+
+// -----------------------------------------------------------------------------
+ARCore::~ARCore() {
+    Cleanup();
 }
 
 //------------------------------------------------------------------------------
@@ -45,6 +68,8 @@ void ARCore::SetupROSandGetParameters() {
 
     bool all_params_found = true;
 
+    SetupParameterCache();
+
     n.param<double>("desired_pose_update_frequency", haptic_loop_rate, 500);
 
     n.param<bool>("enable_guidance", with_guidance, true);
@@ -74,7 +99,7 @@ void ARCore::SetupROSandGetParameters() {
         path << std::string(home_dir) << std::string("/.ros/camera_info/")
              << left_cam_name << "_intrinsics.yaml";
         ReadCameraParameters(path.str(), camera_matrix[0],
-                             camera_distortion[0]);
+                             camera_distortion[0], camera_image_size[0]);
     } else {
         ROS_ERROR(
                 "Parameter '%s' is required. Place the intrinsic calibration "
@@ -89,7 +114,7 @@ void ARCore::SetupROSandGetParameters() {
         path << std::string(home_dir) << std::string("/.ros/camera_info/")
              << right_cam_name << "_intrinsics.yaml";
         ReadCameraParameters(path.str(), camera_matrix[1],
-                             camera_distortion[1]);
+                             camera_distortion[1], camera_image_size[1]);
     } else {
         ROS_ERROR(
                 "Parameter '%s' is required. Place the intrinsic calibration "
@@ -100,26 +125,53 @@ void ARCore::SetupROSandGetParameters() {
     }
 
     // ------------------------------------- IMAGES ----------------------------
-    // Left image subscriber
-    std::string left_image_topic_name = "/camera/left/image_color";;
-    if (n.getParam("left_image_topic_name", left_image_topic_name))
-        ROS_DEBUG(
-                "[SUBSCRIBERS] Left cam images from '%s'",
-                left_image_topic_name.c_str());
-    image_subscribers[0] = it->subscribe(
-            left_image_topic_name, 1, &ARCore::ImageLeftCallback,
-            this);
-
-    //--------
-    // Left image subscriber.
-    std::string right_image_topic_name = "/camera/right/image_color";
-    if (n.getParam("right_image_topic_name", right_image_topic_name))
-        ROS_DEBUG(
-                "[SUBSCRIBERS] Right cam images from '%s'",
-                right_image_topic_name.c_str());
-    image_subscribers[1] = it->subscribe(
-            right_image_topic_name, 1, &ARCore::ImageRightCallback,
-            this);
+    // The transport is read from the image_transport parameter, e.g. shm
+    // when the cameras are on this host.
+    const image_transport::TransportHints image_hints(
+            "raw", ros::TransportHints(), n);
+    ROS_INFO("Camera images through the '%s' transport.",
+             image_hints.getTransport().c_str());
+
+    // A camera sending both eyes in one image is read from a single topic,
+    // and each eye is a view in the shared message.
+    std::string stereo_image_topic_name;
+    if (n.getParam("stereo_image_topic_name", stereo_image_topic_name)) {
+        std::string layout;
+        n.param<std::string>("stereo_image_layout", layout, "side_by_side");
+        if(layout != "side_by_side" && layout != "top_bottom") {
+            ROS_WARN("Unknown stereo_image_layout '%s', using side_by_side.",
+                     layout.c_str());
+            layout = "side_by_side";
+        }
+        stereo_image_top_bottom = layout == "top_bottom";
+        ROS_INFO("[SUBSCRIBERS] Both cam images from '%s' (%s)",
+                 stereo_image_topic_name.c_str(), layout.c_str());
+        image_subscribers[0] = it->subscribe(
+                stereo_image_topic_name, 1, &ARCore::ImageStereoCallback,
+                this, image_hints);
+    }
+    else {
+        // Left image subscriber
+        std::string left_image_topic_name = "/camera/left/image_color";;
+        if (n.getParam("left_image_topic_name", left_image_topic_name))
+            ROS_DEBUG(
+                    "[SUBSCRIBERS] Left cam images from '%s'",
+                    left_image_topic_name.c_str());
+        image_subscribers[0] = it->subscribe(
+                left_image_topic_name, 1, &ARCore::ImageLeftCallback,
+                this, image_hints);
+
+        //--------
+        // Left image subscriber.
+        std::string right_image_topic_name = "/camera/right/image_color";
+        if (n.getParam("right_image_topic_name", right_image_topic_name))
+            ROS_DEBUG(
+                    "[SUBSCRIBERS] Right cam images from '%s'",
+                    right_image_topic_name.c_str());
+        image_subscribers[1] = it->subscribe(
+                right_image_topic_name, 1, &ARCore::ImageRightCallback,
+                this, image_hints);
+    }
 
     // KEPT FOR THE OLD OVERLAY NODE TO WORK THE NEW NODE HAS JUST ONE PUBLISHER
     // publishers for the overlayed images
@@ -169,7 +221,7 @@ void ARCore::SetupROSandGetParameters() {
                << "/world_to_camera_transform";
     ROS_DEBUG("[SUBSCRIBERS] Left came pose from '%s'",
               topic_name.str().c_str());
-    sub_cam_pose_left = n.subscribe(
+    sub_cam_pose_left = n_kinematics.subscribe(
             topic_name.str(), 1, &ARCore::LeftCamPoseCallback, this);
 
     topic_name.str("");
@@ -178,11 +230,11 @@ void ARCore::SetupROSandGetParameters() {
     // if the topic name is found, check if something is being published on it
     ROS_DEBUG("[SUBSCRIBERS] Right cam pose from '%s'",
               topic_name.str().c_str());
-    sub_cam_pose_right = n.subscribe(
+    sub_cam_pose_right = n_kinematics.subscribe(
             topic_name.str(), 1, &ARCore::RightCamPoseCallback, this);
 
     // ------------------------------------- Clutches---------------------------
-    sub_pedal_cam = n.subscribe( "/dvrk/footpedals/camera", 1,
+    sub_pedal_cam = n_control.subscribe( "/dvrk/footpedals/camera", 1,
                                  &ARCore::PedalCameraCallback, this);
 
     // ------------------------------------- TOOLS -----------------------------
@@ -201,10 +253,8 @@ void ARCore::SetupROSandGetParameters() {
 
         //getting the name of the arms
         std::stringstream param_name;
-        param_name << std::string("slave_") << n_arm + 1 << "_name";
-        n.getParam(param_name.str(), slave_names[n_arm]);
+        slave_names[n_arm] = slave_name_params[n_arm]->Get();
 
-        param_name.str("");
         param_name << std::string("master_") << n_arm + 1 << "_name";
         n.getParam(param_name.str(), master_names[n_arm]);
 
@@ -213,7 +263,7 @@ void ARCore::SetupROSandGetParameters() {
         param_name << std::string("/dvrk/") <<slave_names[n_arm]
                    << "/position_cartesian_current";
         subtool_current_pose[n_arm] =
-                n.subscribe(param_name.str(), 1,
+                n_kinematics.subscribe(param_name.str(), 1,
                             pose_current_tool_callbacks[n_arm], this);
 
         // the current pose of the tools (slaves)
@@ -221,7 +271,8 @@ void ARCore::SetupROSandGetParameters() {
         param_name << std::string("/dvrk/") <<master_names[n_arm]
                    << "/gripper_position_current";
         subtool_current_gripper[n_arm] =
-                n.subscribe(param_name.str(), 1, gripper_callbacks[n_arm], this);
+                n_kinematics.subscribe(param_name.str(), 1,
+                                       gripper_callbacks[n_arm], this);
 
         // the transformation from the coordinate frame of the slave (RCM)
         // to the task coordinate frame is needed in AR mode.
@@ -268,6 +319,8 @@ void ARCore::SetupROSandGetParameters() {
                 all_params_found = false;
             }
         }
+        slave_frame_to_world_channel[n_arm].Write(
+                slave_frame_to_world_frame[n_arm], ros::Time::now());
 
     }
 
@@ -276,14 +329,82 @@ void ARCore::SetupROSandGetParameters() {
     publisher_task_state = n.advertise<custom_msgs::TaskState>(
             task_state_topic_name.c_str(), 1);
 
-    subscriber_control_events = n.subscribe(
+    subscriber_control_events = n_control.subscribe(
             "/atar/control_events", 1, &ARCore::ControlEventsCallback, this);
 
+    // ------------------------------------- STEREO SYNC -----------------------
+    // left and right images whose stamps differ more than this are not
+    // shown together
+    double stereo_sync_tolerance;
+    n.param<double>("stereo_sync_tolerance", stereo_sync_tolerance, 0.015);
+    stereo_synchronizer.SetTolerance(stereo_sync_tolerance);
+    ROS_INFO("Stereo images are paired with a tolerance of %f s",
+             stereo_sync_tolerance);
+
+    publisher_diagnostics = n.advertise<diagnostic_msgs::DiagnosticArray>(
+            "/diagnostics", 1);
+
+    n.param<std::string>("latency_trace_file", latency_trace_file,
+                         "/tmp/ar_core_latency_trace.json");
+
+    // the inputs of the session can be recorded to be replayed later with
+    // ar_replay
+    std::string record_session_file;
+    n.param<std::string>("record_session_file", record_session_file, "");
+    if(!record_session_file.empty())
+        session_recorder = new SessionRecorder(record_session_file);
+
+    // from now on the callbacks run on their own threads
+    StartSpinners();
+    parameters->Start();
+
     if (!all_params_found)
         throw std::runtime_error("ERROR: some required parameters are not set");
 }
 
 
+// -----------------------------------------------------------------------------
+void ARCore::SetupParameterCache() {
+
+    double refresh_period;
+    n.param<double>("parameter_refresh_period", refresh_period, 1.0);
+    parameters.reset(new ParameterCache(n, refresh_period));
+
+    cam_pose_averaging_factor = &parameters->Add<double>(
+            "cam_pose_averaging_factor", 0.5);
+
+    for (int n_arm = 0; n_arm < 2; ++n_arm) {
+        std::stringstream param_name;
+        param_name << std::string("slave_") << n_arm + 1 << "_name";
+        slave_name_params[n_arm] = &parameters->Add<std::string>(
+                param_name.str(), "");
+    }
+
+    // used by the arm to world calibration
+    left_cam_name_param = &parameters->Add<std::string>("left_cam_name", "");
+    left_image_topic_name_param = &parameters->Add<std::string>(
+            "left_image_topic_name", "");
+    calib_points_distance_param = &parameters->Add<double>(
+            "calib_points_distance", 0.01);
+    board_params_param = &parameters->Add<std::vector<double> >(
+            "/calibrations/board_params", std::vector<double>(5, 0.0));
+    num_calibration_points = &parameters->Add<int>(
+            "number_of_calibration_points", 6);
+}
+
+// -----------------------------------------------------------------------------
+void ARCore::StartSpinners() {
+
+    // one thread per queue: a slow image conversion never delays the tool
+    // poses and the control events.
+    spinners[0].reset(new ros::AsyncSpinner(1, &image_callback_queue));
+    spinners[1].reset(new ros::AsyncSpinner(1, &kinematics_callback_queue));
+    spinners[2].reset(new ros::AsyncSpinner(1, &control_callback_queue));
+
+    for (int i = 0; i < 3; ++i)
+        spinners[i]->start();
+}
+
 // -----------------------------------------------------------------------------
 void ARCore::SetupGraphics() {
 
@@ -307,22 +428,93 @@ void ARCore::SetupGraphics() {
     std::vector<int> windows_position(4, 0);
     n.getParam("windows_position", windows_position);
 
-    // Create the window for the video feed if we publish the images
-    if (publish_overlayed_images) {
-        if (one_window_mode) {
-            cv_window_names[0] = "Augmented Stereo";
-            cvNamedWindow(cv_window_names[0].c_str(), CV_WINDOW_NORMAL);
-
-        } else {
-            cv_window_names[0] = "Augmented Left";
-            cv_window_names[1] = "Augmented Right";
-            cvNamedWindow(cv_window_names[0].c_str(), CV_WINDOW_NORMAL);
-            cvNamedWindow(cv_window_names[1].c_str(), CV_WINDOW_NORMAL);
-        }
+    // The rendered images are shown and published by a worker thread. Its
+    // windows are created with the first published frame.
+    std::vector<std::string> cv_window_names;
+    if (one_window_mode)
+        cv_window_names.push_back("Augmented Stereo");
+    else {
+        cv_window_names.push_back("Augmented Left");
+        cv_window_names.push_back("Augmented Right");
+    }
+    // frames waiting to be published, the oldest is dropped when it is full
+    int publish_queue_size;
+    n.param<int>("publish_queue_size", publish_queue_size, 2);
+    // Esc in a window stops the render loop as the exit event does, without
+    // shutting down the other nodelets of the process
+    std::function<void()> stop_callback = [this] {
+        std::lock_guard<std::mutex> lock(control_events_mutex);
+        pending_control_events.push_back(CE_EXIT);
+    };
+    frame_publisher = new FramePublisher(one_window_mode, publisher_overlayed,
+                                         publisher_stereo_overlayed,
+                                         cv_window_names, stop_callback,
+                                         &latency_tracer,
+                                         (size_t)std::max(1,
+                                                          publish_queue_size));
+    frame_publisher->Start();
+
+    n.param<bool>("skip_unchanged_frames", skip_unchanged_frames, true);
+    ROS_INFO("Frames identical to the previous one are skipped: %s",
+             skip_unchanged_frames ? "true" : "false");
+
+    // both eyes drawn by one renderer, culling and shadow maps shared
+    bool single_pass_stereo;
+    n.param<bool>("single_pass_stereo", single_pass_stereo, false);
+    if(single_pass_stereo && !one_window_mode) {
+        ROS_WARN("single_pass_stereo needs one_window_mode. Ignoring it.");
+        single_pass_stereo = false;
     }
+    ROS_INFO("Single pass stereo rendering: %s",
+             single_pass_stereo ? "true" : "false");
 
     graphics = new Rendering(ar_mode, 2 - (uint) one_window_mode, with_shadows,
-                             offScreen_rendering, windows_position);
+                             offScreen_rendering, windows_position,
+                             single_pass_stereo);
+
+    if(with_shadows) {
+        n.param<int>("shadow_map_resolution", shadow_map_resolution, 2048);
+        shadow_map_resolution = std::max(64, shadow_map_resolution);
+        graphics->SetShadowMapResolution((unsigned int)shadow_map_resolution);
+
+        // re-bake the shadow maps only when something in the scene moved
+        bool shadows_bake_on_change;
+        n.param<bool>("shadows_bake_on_change", shadows_bake_on_change, true);
+        graphics->SetShadowBakeOnlyOnChange(shadows_bake_on_change);
+        ROS_INFO("Shadow maps: %dx%d, baked %s", shadow_map_resolution,
+                 shadow_map_resolution,
+                 shadows_bake_on_change ? "on change" : "at each frame");
+    }
+
+    // 0: synchronous readback of the rendered images. 2 or 3: they are read
+    // through a ring of pixel buffers and published 1 or 2 frames later.
+    int readback_buffers;
+    n.param<int>("readback_buffers", readback_buffers, 0);
+    if(readback_buffers > 1) {
+        if(graphics->SetAsynchronousReadback(readback_buffers))
+            ROS_INFO("Asynchronous readback with %d pixel buffers.",
+                     readback_buffers);
+        else
+            ROS_WARN("Pixel buffer objects are not supported, the rendered "
+                             "images will be read synchronously.");
+    }
+
+    // Read back only the virtual objects and draw them over the camera
+    // images on the cpu, instead of reading the whole windows
+    bool virtual_layer_readback;
+    n.param<bool>("virtual_layer_readback", virtual_layer_readback, false);
+    if(virtual_layer_readback) {
+        if(readback_buffers > 1)
+            ROS_WARN("virtual_layer_readback replaces the asynchronous "
+                             "readback.");
+        if(graphics->SetVirtualLayerReadback(true))
+            ROS_INFO("The virtual layer is read back and composited over the "
+                             "camera images on the cpu.");
+        else
+            ROS_WARN("The virtual layer readback needs frame buffer objects "
+                             "and does not work with single_pass_stereo. "
+                             "The windows will be read back.");
+    }
 
     // in case camera poses are set as parameters
     graphics->SetWorldToCameraTransform(cam_rvec_curr, cam_tvec_curr);
@@ -330,18 +522,219 @@ void ARCore::SetupGraphics() {
     // set the intrinsics and configure the background image
     graphics->SetCameraIntrinsics(camera_matrix);
 
+    // The windows take the resolution of the cameras. In AR mode it is
+    // taken from the first images below.
+    if(camera_image_size[0].area() > 0)
+        graphics->SetCameraImageSize(camera_image_size[0].width,
+                                     camera_image_size[0].height);
+
+    // resolution of the virtual objects relative to the camera images
+    n.param<double>("scene_render_scale", scene_render_scale, 1.0);
+    scene_render_scale = std::min(1.0, std::max(0.1, scene_render_scale));
+    graphics->SetSceneRenderScale(scene_render_scale);
+
+    // The observer view shows the scene to the people who are not behind
+    // the console. It has its own window, or is published on
+    // observer/image_color, and is rendered at its own rate and size so
+    // that it costs little to the stereo frames.
+    bool observer_view;
+    n.param<bool>("observer_view", observer_view, true);
+    if (observer_view) {
+        double observer_view_rate, observer_view_scale;
+        n.param<double>("observer_view_rate", observer_view_rate, 10.0);
+        n.param<double>("observer_view_scale", observer_view_scale, 0.5);
+        n.param<bool>("observer_view_publish", observer_view_publish, false);
+        std::vector<int> observer_view_position(2, 0);
+        n.getParam("observer_view_position", observer_view_position);
+
+        observer_view_period = ros::Duration(
+                1.0 / std::max(observer_view_rate, 0.1));
+        graphics->EnableObserverView(observer_view_scale,
+                                     observer_view_publish,
+                                     observer_view_position);
+        if (observer_view_publish) {
+            publisher_observer = it->advertise("observer/image_color", 1);
+            image_transport::Publisher no_publishers[2];
+            observer_publisher = new FramePublisher(
+                    true, no_publishers, publisher_observer,
+                    std::vector<std::string>(), std::function<void()>(),
+                    NULL, 1);
+            observer_publisher->Start();
+        }
+        ROS_INFO("Observer view at %.1f Hz and %.2f of the resolution, %s",
+                 observer_view_rate, observer_view_scale,
+                 observer_view_publish ? "published" : "in its own window");
+    }
+
+    // The overlay is a pinhole projection, the background can be
+    // undistorted to match it. undistort_scale < 1 undistorts at a reduced
+    // resolution.
+    bool undistort_background;
+    n.param<bool>("undistort_background", undistort_background, false);
+    if (ar_mode && undistort_background) {
+        double undistort_scale;
+        n.param<double>("undistort_scale", undistort_scale, 1.0);
+        for (int i = 0; i < 2; ++i)
+            background_undistorter[i] = new ImageUndistorter(
+                    camera_matrix[i], camera_distortion[i], undistort_scale);
+        ROS_INFO("The background images are undistorted at scale %.2f",
+                 undistort_scale);
+    }
+
     // in AR mode we read real camera images and show them as the background
     // of our rendering
     if (ar_mode){
         cv::Mat cam_images[2];
         LockAndGetImages(ros::Duration(1), cam_images);
+        if(camera_image_size[0].area() > 0
+           && cam_images[0].size() != camera_image_size[0])
+            ROS_WARN("The camera images are %dx%d but the intrinsics were "
+                     "calibrated at %dx%d.", cam_images[0].cols,
+                     cam_images[0].rows, camera_image_size[0].width,
+                     camera_image_size[0].height);
         graphics->ConfigureBackgroundImage(cam_images);
         graphics->SetEnableBackgroundImage(true);
+        ROS_INFO("Rendering at the camera resolution: 2 x %dx%d, virtual "
+                 "scene at %.2f of it", cam_images[0].cols,
+                 cam_images[0].rows, scene_render_scale);
     }
 
     //    graphics->Render();
 
 }
+// -----------------------------------------------------------------------------
+void ARCore::SetupFrameScheduler() {
+
+    // "event": in AR mode a frame is rendered as soon as a new stereo pair
+    // arrives, in VR mode at vr_refresh_rate. "fixed": the old fixed loop
+    // rate in both modes.
+    std::string scheduler_mode;
+    n.param<std::string>("frame_scheduler", scheduler_mode, "event");
+
+    double vr_refresh_rate, fixed_loop_rate, ar_frame_budget;
+    n.param<double>("vr_refresh_rate", vr_refresh_rate, 60.0);
+    n.param<double>("fixed_loop_rate", fixed_loop_rate, 30.0);
+    // time after which an AR frame is considered late [s]
+    n.param<double>("ar_frame_budget", ar_frame_budget, 1.0 / 30.0);
+
+    if(scheduler_mode == "fixed") {
+        frame_scheduler = new FrameScheduler(FrameScheduler::TARGET_RATE,
+                                             fixed_loop_rate, ar_frame_budget);
+        ROS_INFO("Frame scheduler: fixed rate of %.1f Hz", fixed_loop_rate);
+    }
+    else if(ar_mode) {
+        frame_scheduler = new FrameScheduler(FrameScheduler::ON_NEW_IMAGES,
+                                             fixed_loop_rate, ar_frame_budget);
+        ROS_INFO("Frame scheduler: on new stereo images, budget %.1f ms",
+                 ar_frame_budget * 1000.0);
+    }
+    else {
+        frame_scheduler = new FrameScheduler(FrameScheduler::TARGET_RATE,
+                                             vr_refresh_rate, ar_frame_budget);
+        ROS_INFO("Frame scheduler: VR refresh rate of %.1f Hz",
+                 vr_refresh_rate);
+    }
+}
+
+// -----------------------------------------------------------------------------
+void ARCore::SetupQualityGovernor() {
+
+    bool adaptive_quality;
+    n.param<bool>("adaptive_quality", adaptive_quality, false);
+    if(!adaptive_quality)
+        return;
+
+    // The order in which the quality is given up. The first steps cost the
+    // least to the operator.
+    QualityStep step;
+    if(graphics->HasObserverView()) {
+        step.knob = QualityStep::OBSERVER_VIEW;
+        step.value = 0.0;
+        quality_steps.push_back(step);
+    }
+    if(shadow_map_resolution > 0) {
+        step.knob = QualityStep::SHADOW_RESOLUTION;
+        for (int k = 1; k <= 2; ++k) {
+            step.value = std::max(256, shadow_map_resolution >> k);
+            quality_steps.push_back(step);
+        }
+    }
+    step.knob = QualityStep::MESH_LOD;
+    for (int k = 1; k <= 2; ++k) {
+        step.value = k;
+        quality_steps.push_back(step);
+    }
+    step.knob = QualityStep::RENDER_SCALE;
+    step.value = 0.75;
+    quality_steps.push_back(step);
+    step.value = 0.5;
+    quality_steps.push_back(step);
+
+    // by default the budget of the frame scheduler
+    double frame_budget;
+    n.param<double>("quality_frame_budget", frame_budget,
+                    frame_scheduler->GetFrameBudget());
+    double headroom;
+    n.param<double>("quality_headroom", headroom, 0.7);
+
+    quality_governor = new QualityGovernor(
+            frame_budget, (int)quality_steps.size() + 1, headroom);
+    publisher_quality_level = n.advertise<std_msgs::Int8>("quality_level", 1,
+                                                         true);
+    ApplyQualityLevel(0);
+    ROS_INFO("Adaptive quality: %d levels for a frame budget of %.1f ms",
+             quality_governor->GetNumberOfLevels(), frame_budget * 1000.0);
+}
+
+// -----------------------------------------------------------------------------
+void ARCore::ApplyQualityLevel(const int level) {
+
+    bool observer_view = true;
+    int shadow_resolution = shadow_map_resolution;
+    int mesh_lod = 0;
+    double render_scale = 1.0;
+    for (int k = 0; k < level && k < (int)quality_steps.size(); ++k) {
+        const QualityStep &step = quality_steps[k];
+        if(step.knob == QualityStep::OBSERVER_VIEW)
+            observer_view = false;
+        else if(step.knob == QualityStep::SHADOW_RESOLUTION)
+            shadow_resolution = (int)step.value;
+        else if(step.knob == QualityStep::MESH_LOD)
+            mesh_lod = (int)step.value;
+        else
+            render_scale = step.value;
+    }
+    // relative to the configured scene render scale
+    render_scale *= scene_render_scale;
+
+    observer_view_suspended = !observer_view;
+    if(shadow_resolution > 0)
+        graphics->SetShadowMapResolution((unsigned int)shadow_resolution);
+    graphics->SetMeshLevelOfDetail(mesh_lod);
+    graphics->SetSceneRenderScale(render_scale);
+
+    std_msgs::Int8 msg;
+    msg.data = (int8_t)level;
+    publisher_quality_level.publish(msg);
+    ROS_INFO("Quality level %d: observer view %s, shadow maps %d, mesh "
+             "level of detail %d, scene render scale %.2f", level,
+             observer_view ? "on" : "off", shadow_resolution, mesh_lod,
+             render_scale);
+}
+
+// -----------------------------------------------------------------------------
+void ARCore::WaitForNextFrame() {
+
+    frame_scheduler->WaitForNextFrame(
+            [this](FrameScheduler::Clock::duration timeout) {
+
+                if(stereo_synchronizer.HasNewPair() || !ros::ok())
+                    return true;
+
+                return stereo_synchronizer.WaitForNewPair(timeout);
+            });
+}
+
 // -----------------------------------------------------------------------------
 bool ARCore::UpdateWorld() {
 
@@ -355,7 +748,10 @@ bool ARCore::UpdateWorld() {
         graphics->SetWorldToCameraTransform(cam_rvec, cam_tvec);
 
     // -------------------------------------------------------------------------
-    if (control_event == CE_EXIT) {// Esc
+    // apply the control events received since the last frame
+    ApplyControlEvents();
+
+    if (exit_event) {// Esc
         graphics->RemoveAllActorsFromScene();
         Cleanup();
         return false;
@@ -369,30 +765,84 @@ bool ARCore::UpdateWorld() {
 
         // Time performance debug
         //        ros::Time start =ros::Time::now();
+        frame_stamp = ar_mode ? image_from_ros.image[0]->header.stamp
+                              : ros::Time::now();
+        latency_tracer.BeginFrame(ar_mode ? frame_stamp : ros::Time(),
+                                  task_ptr ? GetToolPoseStamp() : ros::Time());
 
         // update the moving graphics_actors
+        latency_tracer.BeginStage(LatencyTracer::STEP_WORLD);
         if(task_ptr)
             task_ptr->StepWorld();
+        latency_tracer.EndStage(LatencyTracer::STEP_WORLD);
 
         if(ar_mode) {
             // update the camera images
-            graphics->UpdateBackgroundImage(cam_images);
+            uint64_t bytes_copied = ingest_bytes_copied.exchange(0);
+            if(background_undistorter[0]) {
+                cv::Mat background_images[2];
+                for (int i = 0; i < 2; ++i)
+                    background_images[i] =
+                            background_undistorter[i]->Undistort(cam_images[i]);
+                graphics->UpdateBackgroundImage(background_images);
+                ROS_DEBUG_THROTTLE(5, "Undistortion time: left %.2f ms, "
+                                           "right %.2f ms",
+                                   background_undistorter[0]->GetLastTime()
+                                   * 1000.0,
+                                   background_undistorter[1]->GetLastTime()
+                                   * 1000.0);
+            }
+            else
+                graphics->UpdateBackgroundImage(cam_images);
+            ROS_DEBUG_THROTTLE(5, "Image bytes copied per frame: %lu",
+                               (unsigned long)bytes_copied);
 
             // update  view angle (in case window changes size)
             graphics->UpdateCameraViewForActualWindowSize();
         }
 
-        // Render!
-        graphics->Render();
+        // If we are already late and newer images are waiting, this frame
+        // would be outdated before it is shown. Skip it and render the
+        // newer pair right away. Never skip two in a row so that a constant
+        // overload still produces frames.
+        bool render = !(ar_mode && !skipped_last_frame
+                        && frame_scheduler->DeadlinePassed()
+                        && stereo_synchronizer.HasNewPair());
+        skipped_last_frame = !render;
+
+        // Render! Unless nothing moved since the last frame, which is
+        // frequent in VR mode.
+        bool rendered = false;
+        if(render) {
+            latency_tracer.BeginStage(LatencyTracer::RENDER);
+            if(skip_unchanged_frames)
+                rendered = graphics->RenderIfChanged(publish_overlayed_images);
+            else {
+                graphics->Render(publish_overlayed_images);
+                rendered = true;
+            }
+            latency_tracer.EndStage(LatencyTracer::RENDER);
+            ROS_DEBUG_THROTTLE(5, "Background upload time per frame: %.2f ms",
+                               graphics->GetLastUploadTime() * 1000.0);
+            // frames rendered without readback are not in the pipeline
+            if(rendered && !publish_overlayed_images)
+                pending_readbacks.clear();
+        }
 
         // arm calibration
-        if(control_event== CE_CALIB_ARM1)
+        if(calib_arm1_event) {
+            calib_arm1_event = false;
             StartArmToWorldFrameCalibration(0);
+        }
 
         // Copy the rendered image to memory, show it and/or publish it.
-        if(publish_overlayed_images)
+        if(rendered && publish_overlayed_images)
             PublishRenderedImages();
 
+        if(rendered && graphics->HasObserverView()
+           && !observer_view_suspended)
+            RenderObserverView();
+
         if(task_ptr) {
             // publish the task state
             PublishTaskState(task_ptr->GetTaskStateMsg());
@@ -407,11 +857,19 @@ bool ARCore::UpdateWorld() {
         //        std::cout <<  "it took: " <<
         //        (ros::Time::now() - start).toNSec() /1000000 << std::endl;
 
+        frame_scheduler->EndFrame(render);
+        // the frames read back are shown by the publisher, which records
+        // their latencies
+        latency_tracer.EndFrame(rendered && !publish_overlayed_images);
+
+        if(rendered && quality_governor
+           && quality_governor->AddFrameTime(
+                frame_scheduler->GetStatistics().last_frame_time))
+            ApplyQualityLevel(quality_governor->GetLevel());
+
     } // if new image
 
-    // if no task is running we need to spin
-    if(!task_ptr)
-        ros::spinOnce();
+    PublishDiagnostics();
 
     return true;
 }
@@ -454,13 +912,8 @@ void ARCore::StartTask(const uint task_id) {
 
         // getting the names of the slaves
         std::string slave_names[n_arms];
-        for(int n_arm = 0; n_arm<n_arms; n_arm++) {
-
-            //getting the name of the arms
-            std::stringstream param_name;
-            param_name << std::string("slave_") << n_arm + 1 << "_name";
-            n.getParam(param_name.str(), slave_names[n_arm]);
-        }
+        for(int n_arm = 0; n_arm<n_arms; n_arm++)
+            slave_names[n_arm] = slave_name_params[n_arm]->Get();
 
         // starting the task
         ROS_DEBUG("Starting new BuzzWireTask task. ");
@@ -494,13 +947,8 @@ void ARCore::StartTask(const uint task_id) {
         ROS_DEBUG("Starting new BuzzWireTask task. ");
         // getting the names of the slaves
         std::string slave_names[n_arms];
-        for (int n_arm = 0; n_arm < n_arms; n_arm++) {
-
-            //getting the name of the arms
-            std::stringstream param_name;
-            param_name << std::string("slave_") << n_arm + 1 << "_name";
-            n.getParam(param_name.str(), slave_names[n_arm]);
-        }
+        for (int n_arm = 0; n_arm < n_arms; n_arm++)
+            slave_names[n_arm] = slave_name_params[n_arm]->Get();
         // starting the task
         task_ptr = new TaskBuzzWire(
                 mesh_files_dir, show_reference_frames, (bool) (n_arms - 1),
@@ -510,16 +958,15 @@ void ARCore::StartTask(const uint task_id) {
     }
     else if(task_id == 8) {
         ROS_DEBUG("Starting new TestTask task. ");
-        task_ptr   = new TaskDemo(n, mesh_files_dir, &pose_cam[0]);
+        task_ptr   = new TaskDemo(n_kinematics, mesh_files_dir, &pose_cam[0]);
     }
     if(task_ptr) {
         // assign the tool pose pointers
-        ros::spinOnce();
-        task_ptr->SetCurrentToolPosePointer(pose_current_tool[0], 0);
-        task_ptr->SetCurrentToolPosePointer(pose_current_tool[1], 1);
+        task_ptr->SetCurrentToolPoseChannel(&pose_current_tool[0], 0);
+        task_ptr->SetCurrentToolPoseChannel(&pose_current_tool[1], 1);
 
-        task_ptr->SetCurrentGripperpositionPointer(gripper_current[0], 0);
-        task_ptr->SetCurrentGripperpositionPointer(gripper_current[1], 1);
+        task_ptr->SetCurrentGripperPositionChannel(&gripper_current[0], 0);
+        task_ptr->SetCurrentGripperPositionChannel(&gripper_current[1], 1);
 
         task_ptr->StepWorld();
 
@@ -547,38 +994,25 @@ void ARCore::LockAndGetImages(ros::Duration timeout,
     ros::Rate loop_rate(10);
     ros::Time timeout_time = ros::Time::now() + timeout;
 
-    while(image_from_ros[0].empty()) {
-        ros::spinOnce();
+    while(!stereo_synchronizer.GetNewPair(image_from_ros)) {
         loop_rate.sleep();
 
         if (ros::Time::now() > timeout_time)
-            ROS_WARN("Timeout: No new left Image. Trying again...");
+            ROS_WARN("Timeout: No new synchronized stereo images. Trying "
+                             "again...");
     }
-    image_from_ros[0].copyTo(images[0]);
-
-    new_image[0] = false;
-
-    while(image_from_ros[1].empty()) {
-        ros::spinOnce();
-        loop_rate.sleep();
-
-        if (ros::Time::now() > timeout_time) {
-            ROS_WARN("Timeout: No new right Image. Trying again...");
-        }
-    }
-    image_from_ros[1].copyTo(images[1]);
-
-    new_image[1] = false;
+    images[0] = image_from_ros.image[0]->image;
+    images[1] = image_from_ros.image[1]->image;
 }
 
 // -----------------------------------------------------------------------------
 bool ARCore::GetNewImages( cv::Mat images[]) {
 
-    if(new_image[0] && new_image[1]) {
-        image_from_ros[0].copyTo(images[0]);
-        image_from_ros[1].copyTo(images[1]);
-        new_image[0] = false;
-        new_image[1] = false;
+    // the synchronizer has already discarded the stale images, here we only
+    // take the newest matched pair.
+    if(stereo_synchronizer.GetNewPair(image_from_ros)) {
+        images[0] = image_from_ros.image[0]->image;
+        images[1] = image_from_ros.image[1]->image;
         return true;
     }
 
@@ -590,6 +1024,18 @@ bool ARCore::GetNewImages( cv::Mat images[]) {
 bool ARCore::GetNewCameraPoses(cv::Vec3d cam_rvec_out[2],
                                cv::Vec3d cam_tvec_out[2]) {
 
+    // take the poses that arrived since the last call
+    for (int k = 0; k < 2; ++k) {
+        uint64_t sequence = cam_pose_channel[k].GetSequence();
+        if (sequence != cam_pose_sequence[k]) {
+            cam_pose_sequence[k] = sequence;
+            cam_pose_channel[k].Read(pose_cam[k]);
+            conversions::KDLFrameToRvectvec(pose_cam[k], cam_rvec_curr[k],
+                                            cam_tvec_curr[k]);
+            new_cam_pose[k] = true;
+        }
+    }
+
     // if one of the poses is not available estimate the other one through
     // the left to right fixed transform
     if (new_cam_pose[0] && !new_cam_pose[1]) {
@@ -604,8 +1050,7 @@ bool ARCore::GetNewCameraPoses(cv::Vec3d cam_rvec_out[2],
     }
 
 
-    double avg_factor;
-    n.param<double>("cam_pose_averaging_factor", avg_factor, 0.5);
+    double avg_factor = cam_pose_averaging_factor->Get();
 
     // FIXME change to normal averaging with buffer.
     // populate the out values
@@ -638,7 +1083,8 @@ bool ARCore::GetNewCameraPoses(cv::Vec3d cam_rvec_out[2],
                 // no averaging is needed in VR mode
                 cam_rvec_out[k] = cam_rvec_curr[k];
                 cam_tvec_out[k] = cam_tvec_curr[k];
-                //new_cam_pose[k] = false;
+                // applied, so the next frames skip the camera update
+                new_cam_pose[k] = false;
             }
         }
         return true;
@@ -662,37 +1108,32 @@ void ARCore::DoArmToWorldFrameCalibration(const uint arm_id) {
 
     //getting the name of the arms
     std::stringstream param_name;
-    std::string slave_name;
-    param_name << std::string("slave_") << arm_id + 1 << "_name";
-    n.getParam(param_name.str(), slave_name);
+    std::string slave_name = slave_name_params[arm_id]->Get();
 
     std::stringstream arm_pose_namespace;
     arm_pose_namespace << std::string("/dvrk/") <<slave_name
                        << "/position_cartesian_current";
 
     std::stringstream cam_pose_namespace;
-    std::string left_cam_name;
-    n.getParam("left_cam_name", left_cam_name);
-    cam_pose_namespace << std::string("/") << left_cam_name
+    cam_pose_namespace << std::string("/") << left_cam_name_param->Get()
                        << "/world_to_camera_transform";
 
-    std::string cam_image_name_space ;
-    n.getParam("left_image_topic_name", cam_image_name_space);
+    std::string cam_image_name_space = left_image_topic_name_param->Get();
 
     // putting the calibration point on the corners of the board squares
     // the parameter can be set directly, unless there is the global
     // /calibrations/board_params
-    double calib_points_distance = 0.01;
-    std::vector<float> board_params = std::vector<float>(5, 0.0);
+    double calib_points_distance = calib_points_distance_param->Get();
+    std::vector<double> board_params = board_params_param->Get();
+    board_params.resize(5, 0.0);
 
-    if(!n.getParam("calib_points_distance", calib_points_distance)){
-        if(n.getParam("/calibrations/board_params", board_params))
+    if(!calib_points_distance_param->IsSet()){
+        if(board_params_param->IsSet())
             calib_points_distance = board_params[3];
 
     };
 
-    int num_calib_points;
-    n.param<int>("number_of_calibration_points", num_calib_points, 6);
+    int num_calib_points = num_calibration_points->Get();
 
     ArmToWorldCalibration AWC;
     KDL::Frame world_to_arm_frame;
@@ -716,16 +1157,41 @@ void ARCore::DoArmToWorldFrameCalibration(const uint arm_id) {
         conversions::KDLFrameToVector(world_to_arm_frame, vec7);
         n.setParam(param_name.str(), vec7);
 
-        // set output
+        // set output, the pose callbacks use it from now on
         slave_frame_to_world_frame[arm_id] = world_to_arm_frame.Inverse();
+        slave_frame_to_world_channel[arm_id].Write(
+                slave_frame_to_world_frame[arm_id], ros::Time::now());
     }
 
 }
 
 // -----------------------------------------------------------------------------
 void ARCore::Cleanup() {
+    if(!graphics)
+        return;
+    for (int i = 0; i < 3; ++i)
+        spinners[i]->stop();
+    if(session_recorder) {
+        delete session_recorder;
+        session_recorder = NULL;
+    }
     DeleteTask();
+    // the workers may still be showing or publishing a frame
+    delete frame_publisher;
+    frame_publisher = NULL;
+    delete observer_publisher;
+    observer_publisher = NULL;
     delete graphics;
+    graphics = NULL;
+    for (int i = 0; i < 2; ++i) {
+        delete background_undistorter[i];
+        background_undistorter[i] = NULL;
+    }
+    delete frame_scheduler;
+    frame_scheduler = NULL;
+    delete quality_governor;
+    quality_governor = NULL;
+    parameters->Stop();
 }
 
 // -----------------------------------------------------------------------------
@@ -744,46 +1210,213 @@ void ARCore::StartArmToWorldFrameCalibration(const uint arm_id) {
     }
     else // if no task is running just do the calibration
         DoArmToWorldFrameCalibration(arm_id);
-
-    control_event = (int8_t)running_task_id;
 }
 
 // -----------------------------------------------------------------------------
 void ARCore::PublishRenderedImages() {
 
-    cv::Mat augmented_images[2];
-
-    char key = (char)cv::waitKey(1);
-    if (key == 27) // Esc
-        ros::shutdown();
-    else if (key == 'f')  //full screen
-        SwitchFullScreenCV(cv_window_names[0]);
-
-    graphics->GetRenderedImage(augmented_images);
-    if(one_window_mode){
-        cv::imshow(cv_window_names[0], augmented_images[0]);
-        publisher_stereo_overlayed.publish(
-                cv_bridge::CvImage(std_msgs::Header(),
-                                   "bgr8", augmented_images[0]).toImageMsg());
-    }
-    else{
-        for (int i = 0; i < 2; ++i) {
-            cv::imshow(cv_window_names[i], augmented_images[i]);
-            publisher_overlayed[i].publish(
-                    cv_bridge::CvImage(std_msgs::Header(), "bgr8",
-                                       augmented_images[i]).toImageMsg());
-        }
-        if (key == 'f')  //full screen
-            SwitchFullScreenCV(cv_window_names[1]);
+    // the overlays keep the header of the camera images they were drawn on
+    PendingReadback rendered_frame;
+    for (int i = 0; i < 2; ++i) {
+        if(ar_mode && image_from_ros.image[i])
+            rendered_frame.headers[i] = image_from_ros.image[i]->header;
+        else
+            rendered_frame.headers[i].stamp = frame_stamp;
+    }
+    rendered_frame.sources = latency_tracer.GetFrameSources();
+    // with the asynchronous readback the images come from an earlier frame
+    pending_readbacks.push_back(rendered_frame);
+    while((int)pending_readbacks.size() > graphics->GetReadbackDelay() + 1)
+        pending_readbacks.pop_front();
+
+    // read back in the buffers of a frame of the publisher
+    FramePublisher::Frame *frame = frame_publisher->AcquireFrame();
+    latency_tracer.BeginStage(LatencyTracer::READBACK);
+    bool retrieved = graphics->GetRenderedImage(frame->images);
+    latency_tracer.EndStage(LatencyTracer::READBACK);
+    ROS_DEBUG_THROTTLE(5, "Readback time per frame: %.2f ms",
+                       graphics->GetLastReadbackTime() * 1000.0);
+    if(!retrieved) {
+        frame_publisher->Release(frame);
+        return;
+    }
+
+    frame->headers = pending_readbacks.front().headers;
+    frame->sources = pending_readbacks.front().sources;
+    pending_readbacks.pop_front();
+
+    // shown and published by the worker thread, which records the publish
+    // stage and the end-to-end latencies
+    frame_publisher->Push(frame);
+
+}
+
+
+// -----------------------------------------------------------------------------
+void ARCore::RenderObserverView() {
+
+    ros::Time now = ros::Time::now();
+    if (now - last_observer_view_time < observer_view_period)
+        return;
+    last_observer_view_time = now;
+
+    // the off screen observer view is only worth rendering for a subscriber
+    if (!observer_view_publish) {
+        graphics->RenderObserverView();
+        return;
+    }
+    if (publisher_observer.getNumSubscribers() == 0)
+        return;
+
+    // read back in the buffer of a frame of the observer publisher, which
+    // copies it in a message and publishes it from its own thread
+    FramePublisher::Frame *frame = observer_publisher->AcquireFrame();
+    if (!graphics->RenderObserverView(&frame->images[0])) {
+        observer_publisher->Release(frame);
+        return;
     }
 
+    if (ar_mode && image_from_ros.image[1])
+        frame->headers[0] = image_from_ros.image[1]->header;
+    else {
+        frame->headers[0] = std_msgs::Header();
+        frame->headers[0].stamp = frame_stamp;
+    }
+    observer_publisher->Push(frame);
 }
 
 
+// -----------------------------------------------------------------------------
+ros::Time ARCore::GetToolPoseStamp() {
+
+    ros::Time oldest;
+    for (int k = 0; k < n_arms; ++k) {
+        KDL::Frame pose;
+        ros::Time stamp;
+        if(pose_current_tool[k].Read(pose, &stamp)
+           && (oldest.isZero() || stamp < oldest))
+            oldest = stamp;
+    }
+    return oldest;
+}
+
+// -----------------------------------------------------------------------------
+void ARCore::PublishDiagnostics() {
+
+    // once per second is enough for monitoring
+    ros::Time now = ros::Time::now();
+    if((now - last_diagnostics_time).toSec() < 1.0)
+        return;
+    last_diagnostics_time = now;
+
+    StereoSynchronizer::Statistics stats = stereo_synchronizer.GetStatistics();
+
+    diagnostic_msgs::DiagnosticStatus status;
+    status.name = n.getNamespace() + ": stereo synchronizer";
+    status.hardware_id = "stereo_camera";
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = "OK";
+    if(stats.matched_pairs == 0) {
+        status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+        status.message = "No synchronized stereo pair received";
+    }
+
+    AddDiagnosticValues(status, {
+            {"last_skew_ms",        stats.last_skew * 1000.0},
+            {"max_skew_ms",         stats.max_skew * 1000.0},
+            {"matched_pairs",       (double)stats.matched_pairs},
+            {"dropped_left",        (double)stats.dropped[0]},
+            {"dropped_right",       (double)stats.dropped[1]},
+            {"overwritten_pairs",   (double)stats.overwritten_pairs},
+            {"queue_depth_left",    (double)stats.queue_depth[0]},
+            {"queue_depth_right",   (double)stats.queue_depth[1]}});
+
+    diagnostic_msgs::DiagnosticArray msg;
+    msg.header.stamp = now;
+    msg.status.push_back(status);
+
+    // frame scheduler
+    unsigned long shadow_bakes, shadow_bakes_skipped;
+    graphics->GetShadowBakeCounts(shadow_bakes, shadow_bakes_skipped);
+    unsigned long renders, renders_skipped, view_updates, view_updates_skipped;
+    graphics->GetRenderCounts(renders, renders_skipped);
+    graphics->GetCameraViewUpdateCounts(view_updates, view_updates_skipped);
+    unsigned long frames_published, frames_dropped;
+    frame_publisher->GetFrameCounts(frames_published, frames_dropped);
+    const FrameScheduler::Statistics &frames =
+            frame_scheduler->GetStatistics();
+    status = diagnostic_msgs::DiagnosticStatus();
+    status.name = n.getNamespace() + ": frame scheduler";
+    status.hardware_id = "render_loop";
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = "OK";
+
+    AddDiagnosticValues(status, {
+            {"frames",              (double)frames.frames},
+            {"missed_deadlines",    (double)frames.missed_deadlines},
+            {"skipped_slots",       (double)frames.skipped_slots},
+            {"skipped_frames",      (double)frames.skipped_frames},
+            {"last_frame_time_ms",  frames.last_frame_time * 1000.0},
+            {"background_upload_ms",
+                    graphics->GetLastUploadTime() * 1000.0},
+            {"undistort_left_ms",   background_undistorter[0] ?
+                    background_undistorter[0]->GetLastTime() * 1000.0 : 0.0},
+            {"undistort_right_ms",  background_undistorter[1] ?
+                    background_undistorter[1]->GetLastTime() * 1000.0 : 0.0},
+            {"readback_ms",         graphics->GetLastReadbackTime() * 1000.0},
+            {"readback_delay",      (double)graphics->GetReadbackDelay()},
+            {"shadow_bakes",        (double)shadow_bakes},
+            {"shadow_bakes_skipped", (double)shadow_bakes_skipped},
+            {"quality_level",       quality_governor ?
+                    (double)quality_governor->GetLevel() : 0.0},
+            {"quality_mean_frame_ms", quality_governor ?
+                    quality_governor->GetMeanFrameTime() * 1000.0 : 0.0},
+            {"renders",             (double)renders},
+            {"renders_skipped_unchanged", (double)renders_skipped},
+            {"camera_view_updates", (double)view_updates},
+            {"camera_view_updates_skipped", (double)view_updates_skipped},
+            {"frames_published",    (double)frames_published},
+            {"frames_dropped_publishing", (double)frames_dropped}});
+    msg.status.push_back(status);
+
+    // latencies since the last diagnostics
+    std::vector<LatencyHistogram> histograms = latency_tracer.TakeHistograms();
+    status = diagnostic_msgs::DiagnosticStatus();
+    status.name = n.getNamespace() + ": latency";
+    status.hardware_id = "render_loop";
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = "OK";
+
+    for (int i = 0; i < LatencyTracer::NUM_STAGES; ++i) {
+        const LatencyHistogram &histogram = histograms[i];
+        if(histogram.GetCount() == 0)
+            continue;
+
+        std::string stage =
+                LatencyTracer::GetStageName((LatencyTracer::Stage)i);
+        AddDiagnosticValues(status, {
+                {stage + "_count",      (double)histogram.GetCount()},
+                {stage + "_mean_ms",    histogram.GetMean() * 1000.0},
+                {stage + "_p50_ms",     histogram.GetPercentile(0.5) * 1000.0},
+                {stage + "_p95_ms",     histogram.GetPercentile(0.95) * 1000.0},
+                {stage + "_p99_ms",     histogram.GetPercentile(0.99) * 1000.0},
+                {stage + "_max_ms",     histogram.GetMax() * 1000.0}});
+
+        diagnostic_msgs::KeyValue bins;
+        bins.key = stage + "_histogram_ms";
+        bins.value = histogram.ToString();
+        status.values.push_back(bins);
+    }
+    msg.status.push_back(status);
+
+    publisher_diagnostics.publish(msg);
+}
+
 // -----------------------------------------------------------------------------
 void ARCore::ReadCameraParameters(const std::string file_path,
                                   cv::Mat &camera_matrix,
-                                  cv::Mat &camera_distortion) {
+                                  cv::Mat &camera_distortion,
+                                  cv::Size &image_size) {
     cv::FileStorage fs(file_path, cv::FileStorage::READ);
     ROS_INFO("Reading camera intrinsic data from: '%s'",file_path.c_str());
 
@@ -792,6 +1425,12 @@ void ARCore::ReadCameraParameters(const std::string file_path,
 
     fs["camera_matrix"] >> camera_matrix;
     fs["distortion_coefficients"] >> camera_distortion;
+    // optional, as written by the ros camera calibration
+    image_size = cv::Size();
+    if(!fs["image_width"].empty() && !fs["image_height"].empty()) {
+        fs["image_width"] >> image_size.width;
+        fs["image_height"] >> image_size.height;
+    }
 
     // check if we got something
     if(camera_matrix.empty()){
@@ -806,11 +1445,61 @@ void ARCore::ReadCameraParameters(const std::string file_path,
 
 // -----------------------------------------------------------------------------
 void ARCore::ImageRightCallback(const sensor_msgs::ImageConstPtr& msg)
+{
+    if(session_recorder)
+        session_recorder->Record(SR_IMAGE_RIGHT, *msg);
+    IngestImage(msg, 1);
+}
+
+// -----------------------------------------------------------------------------
+void ARCore::ImageLeftCallback(const sensor_msgs::ImageConstPtr& msg)
+{
+    if(session_recorder)
+        session_recorder->Record(SR_IMAGE_LEFT, *msg);
+    IngestImage(msg, 0);
+}
+
+// -----------------------------------------------------------------------------
+void ARCore::ImageStereoCallback(const sensor_msgs::ImageConstPtr& msg)
+{
+    if(session_recorder)
+        session_recorder->Record(SR_IMAGE_STEREO, *msg);
+    IngestStereoImage(msg);
+}
+
+// -----------------------------------------------------------------------------
+cv_bridge::CvImageConstPtr ARCore::DecodeImage(
+        const sensor_msgs::ImageConstPtr &msg)
+{
+    // The camera encodings are decoded here, in one pass, to the bgr8
+    // layout the background renderer takes. toCvShare handles bgr8,
+    // which it shares without copy, and the rare other encodings.
+    cv_bridge::CvImageConstPtr image;
+    if(msg->encoding != sensor_msgs::image_encodings::BGR8
+       && ImageKernels::CanDecodeToBGR(msg->encoding)) {
+        cv_bridge::CvImagePtr decoded(new cv_bridge::CvImage(
+                msg->header, sensor_msgs::image_encodings::BGR8));
+        if(ImageKernels::DecodeToBGR(cv_bridge::toCvShare(msg)->image,
+                                     msg->encoding, decoded->image))
+            image = decoded;
+    }
+    if(!image)
+        image = cv_bridge::toCvShare(msg, "bgr8");
+    if(!msg->data.empty() && image->image.data != &msg->data[0])
+        ingest_bytes_copied += image->image.total()
+                               * image->image.elemSize();
+    return image;
+}
+
+// -----------------------------------------------------------------------------
+void ARCore::IngestImage(const sensor_msgs::ImageConstPtr &msg,
+                         const int cam_id)
 {
     try
     {
-        image_from_ros[1] = cv_bridge::toCvCopy(msg, "bgr8")->image;
-        new_image[1] = true;
+        cv_bridge::CvImageConstPtr image = DecodeImage(msg);
+        latency_tracer.RecordIngest(cam_id, msg->header.stamp);
+        stereo_synchronizer.Push(image, cam_id);
     }
     catch (cv_bridge::Exception& e)
     {
@@ -819,17 +1508,40 @@ void ARCore::ImageRightCallback(const sensor_msgs::ImageConstPtr& msg)
 }
 
 // -----------------------------------------------------------------------------
-void ARCore::ImageLeftCallback(const sensor_msgs::ImageConstPtr& msg)
+void ARCore::IngestStereoImage(const sensor_msgs::ImageConstPtr &msg)
 {
+    cv_bridge::CvImageConstPtr stereo;
     try
     {
-        image_from_ros[0] = cv_bridge::toCvCopy(msg, "bgr8")->image;
-        new_image[0] = true;
-
+        stereo = DecodeImage(msg);
     }
     catch (cv_bridge::Exception& e)
     {
         ROS_ERROR("Could not convert from '%s' to 'bgr8'.", msg->encoding.c_str());
+        return;
+    }
+
+    const cv::Mat &image = stereo->image;
+    const cv::Rect halves[2] = {
+            stereo_image_top_bottom
+            ? cv::Rect(0, 0, image.cols, image.rows / 2)
+            : cv::Rect(0, 0, image.cols / 2, image.rows),
+            stereo_image_top_bottom
+            ? cv::Rect(0, image.rows / 2, image.cols, image.rows / 2)
+            : cv::Rect(image.cols / 2, 0, image.cols / 2, image.rows)};
+
+    for (int i = 0; i < 2; ++i) {
+        // A view in the stereo image. When it is shared with the message
+        // its Mat does not own the data, so the deleter of the view keeps
+        // the stereo image, and the message, alive as long as the view.
+        cv_bridge::CvImageConstPtr eye(
+                new cv_bridge::CvImage(stereo->header, stereo->encoding,
+                                       image(halves[i])),
+                [stereo](const cv_bridge::CvImage *view) { delete view; });
+        latency_tracer.RecordIngest(i, msg->header.stamp);
+        // both views have the stamp of the message, they are paired as soon
+        // as the right one is pushed
+        stereo_synchronizer.Push(eye, i);
     }
 }
 
@@ -837,49 +1549,66 @@ void ARCore::ImageLeftCallback(const sensor_msgs::ImageConstPtr& msg)
 void ARCore::LeftCamPoseCallback(
         const geometry_msgs::PoseStampedConstPtr & msg)
 {
-    new_cam_pose[0] = true;
-    tf::poseMsgToKDL(msg->pose, pose_cam[0]);
-    conversions::KDLFrameToRvectvec(pose_cam[0], cam_rvec_curr[0], cam_tvec_curr[0]);
+    if(session_recorder)
+        session_recorder->Record(SR_CAM_POSE_LEFT, *msg);
 
+    KDL::Frame frame;
+    tf::poseMsgToKDL(msg->pose, frame);
+    cam_pose_channel[0].Write(frame, msg->header.stamp);
 }
 
 void ARCore::RightCamPoseCallback(
         const geometry_msgs::PoseStampedConstPtr & msg)
 {
-    new_cam_pose[1] = true;
-    tf::poseMsgToKDL(msg->pose, pose_cam[1]);
-    conversions::KDLFrameToRvectvec(pose_cam[1], cam_rvec_curr[1], cam_tvec_curr[1]);
+    if(session_recorder)
+        session_recorder->Record(SR_CAM_POSE_RIGHT, *msg);
+
+    KDL::Frame frame;
+    tf::poseMsgToKDL(msg->pose, frame);
+    cam_pose_channel[1].Write(frame, msg->header.stamp);
 }
 
 // Reading the pose of the slaves and take them to task space
 // -----------------------------------------------------------------------------
 void ARCore::Tool1PoseCurrentCallback(
         const geometry_msgs::PoseStamped::ConstPtr &msg) {
+    if(session_recorder)
+        session_recorder->Record(SR_TOOL_POSE_1, *msg);
+
     // take the pose from the arm frame to the task frame
     KDL::Frame frame;
     tf::poseMsgToKDL(msg->pose, frame);
-    pose_current_tool[0] =  slave_frame_to_world_frame[0] * frame;
+    pose_current_tool[0].Write(slave_frame_to_world_channel[0].Get() * frame,
+                               msg->header.stamp);
 
 }
 
 void ARCore::Tool2PoseCurrentCallback(
         const geometry_msgs::PoseStamped::ConstPtr &msg) {
+    if(session_recorder)
+        session_recorder->Record(SR_TOOL_POSE_2, *msg);
+
     // take the pose from the arm frame to the task frame
     KDL::Frame frame;
     tf::poseMsgToKDL(msg->pose, frame);
-    pose_current_tool[1] =  slave_frame_to_world_frame[1] * frame;
+    pose_current_tool[1].Write(slave_frame_to_world_channel[1].Get() * frame,
+                               msg->header.stamp);
 }
 
 // -----------------------------------------------------------------------------
 // Reading the gripper positions
 void ARCore::Tool1GripperCurrentCallback(
         const std_msgs::Float32::ConstPtr &msg) {
-    gripper_current[0] =  msg->data;
+    if(session_recorder)
+        session_recorder->Record(SR_GRIPPER_1, *msg);
+    gripper_current[0].Write(msg->data, ros::Time::now());
 }
 
 void ARCore::Tool2GripperCurrentCallback(
         const std_msgs::Float32::ConstPtr &msg) {
-    gripper_current[1] =  msg->data;
+    if(session_recorder)
+        session_recorder->Record(SR_GRIPPER_2, *msg);
+    gripper_current[1].Write(msg->data, ros::Time::now());
 
 }
 
@@ -892,16 +1621,40 @@ void ARCore::PedalCameraCallback(const sensor_msgs::JoyConstPtr &msg){
 void ARCore::ControlEventsCallback(const std_msgs::Int8ConstPtr
                                    &msg) {
 
-    control_event = msg->data;
-    ROS_DEBUG("Received control event %d", control_event);
+    ROS_DEBUG("Received control event %d", msg->data);
+    if(session_recorder)
+        session_recorder->Record(SR_CONTROL_EVENT, *msg);
 
-    switch(control_event){
+    // the event is applied by the render thread at the next frame
+    std::lock_guard<std::mutex> lock(control_events_mutex);
+    pending_control_events.push_back(msg->data);
+}
+
+// -----------------------------------------------------------------------------
+void ARCore::ApplyControlEvents() {
+
+    std::deque<int8_t> events;
+    {
+        std::lock_guard<std::mutex> lock(control_events_mutex);
+        events.swap(pending_control_events);
+    }
+
+    for (const int8_t event : events)
+        HandleControlEvent(event);
+}
+
+// -----------------------------------------------------------------------------
+void ARCore::HandleControlEvent(const int8_t event) {
+
+    switch(event){
         case CE_RESET_TASK:
-            task_ptr->ResetTask();
+            if(task_ptr)
+                task_ptr->ResetTask();
             break;
 
         case CE_RESET_ACQUISITION:
-            task_ptr->ResetCurrentAcquisition();
+            if(task_ptr)
+                task_ptr->ResetCurrentAcquisition();
             break;
 
         case CE_PUBLISH_IMGS_ON:
@@ -916,6 +1669,15 @@ void ARCore::ControlEventsCallback(const std_msgs::Int8ConstPtr
             graphics->ToggleFullScreen();
             break;
 
+        case CE_WRITE_LATENCY_TRACE:
+            if(latency_tracer.WriteChromeTrace(latency_trace_file))
+                ROS_INFO("Latency trace written to '%s'",
+                         latency_trace_file.c_str());
+            else
+                ROS_ERROR("Could not write the latency trace to '%s'",
+                          latency_trace_file.c_str());
+            break;
+
         case CE_START_TASK1:
             running_task_id = 1;
             new_task_event = true;
@@ -956,19 +1718,29 @@ void ARCore::ControlEventsCallback(const std_msgs::Int8ConstPtr
             new_task_event = true;
             break;
 
+        case CE_CALIB_ARM1:
+            calib_arm1_event = true;
+            break;
+
+        case CE_EXIT:
+            exit_event = true;
+            break;
+
         default:
             break;
     }
 
 }
 
-
-void SwitchFullScreenCV(const std::string window_name) {
-
-    if (cvGetWindowProperty(window_name.c_str(), CV_WND_PROP_FULLSCREEN) ==
-        CV_WINDOW_NORMAL)
-        cvSetWindowProperty(window_name.c_str(), CV_WND_PROP_FULLSCREEN, CV_WINDOW_FULLSCREEN);
-    else
-        cvSetWindowProperty(window_name.c_str(), CV_WND_PROP_FULLSCREEN, CV_WINDOW_NORMAL);
-
+// -----------------------------------------------------------------------------
+void AddDiagnosticValues(diagnostic_msgs::DiagnosticStatus &status,
+                         const std::vector<std::pair<std::string, double> >
+                         &values) {
+
+    for (const auto &value : values) {
+        diagnostic_msgs::KeyValue key_value;
+        key_value.key = value.first;
+        key_value.value = std::to_string(value.second);
+        status.values.push_back(key_value);
+    }
 }
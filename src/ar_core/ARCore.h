@@ -8,10 +8,24 @@
 // related headers
 #include "SimTask.h"
 #include "Rendering.h"
+#include "ImageUndistorter.h"
+#include "StereoSynchronizer.h"
+#include "FrameScheduler.h"
+#include "FramePublisher.h"
+#include "QualityGovernor.h"
+#include "SeqLockChannel.h"
+#include "LatencyTracer.h"
+#include "ParameterCache.h"
+#include "SessionLog.h"
 #include <boost/thread/thread.hpp>
 #include <mutex>
+#include <memory>
+#include <atomic>
+#include <deque>
+#include <array>
 // ros and opencv
 #include "ros/ros.h"
+#include <ros/callback_queue.h>
 #include <kdl_conversions/kdl_msg.h>
 #include <cv_bridge/cv_bridge.h>
 #include "opencv2/highgui/highgui.hpp"
@@ -24,6 +38,7 @@
 #include <geometry_msgs/PoseStamped.h>
 #include <geometry_msgs/PoseArray.h>
 #include <geometry_msgs/TwistStamped.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
 #include "custom_msgs/ActiveConstraintParameters.h"
 #include "custom_msgs/TaskState.h"
 
@@ -34,17 +49,62 @@ public:
 
     ARCore(std::string node_name);
 
+    // Takes its parameters and topics from node_handle, e.g. the private
+    // node handle of a nodelet
+    ARCore(const ros::NodeHandle &node_handle);
+
+    // Calls Cleanup, so the session log is closed when the render loop is
+    // left without the exit event, e.g. on Ctrl-C.
+    ~ARCore();
+
+    // Blocks until the next frame is due. Depending on the frame scheduler
+    // mode that is when a new stereo pair arrives (AR) or at the next slot of
+    // the target refresh rate (VR).
+    void WaitForNextFrame();
+
+    // True if a stereo pair is waiting for the next frame. Used by the
+    // replay to feed the images one pair at a time.
+    bool HasNewImages() const { return stereo_synchronizer.HasNewPair(); }
+
+    // latencies of all the frames since the start
+    std::vector<LatencyHistogram> GetSessionLatencies() {
+        return latency_tracer.GetSessionHistograms();
+    }
+
+    FrameScheduler::Statistics GetFrameStatistics() const {
+        return frame_scheduler->GetStatistics();
+    }
+
     bool UpdateWorld();
 
+    // Stops the spinners and releases the task and the graphics. Called
+    // when the exit event is received, by the owner of the render loop
+    // when it stops it from outside, and by the destructor. Does nothing the
+    // second time.
+    void Cleanup();
+
 private:
-    std::mutex m;
 
     // Reads parameters and sets up subscribers and publishers
     void SetupROSandGetParameters();
 
+    // reads the parameters that are needed after the setup (render loop,
+    // task start, calibration) into the parameter cache
+    void SetupParameterCache();
+
     // reads required parameters and initializes the graphics
     void SetupGraphics();
 
+    // reads the scheduling parameters and creates the frame scheduler
+    void SetupFrameScheduler();
+
+    // creates the quality governor if adaptive_quality is set. Needs the
+    // graphics and the frame scheduler.
+    void SetupQualityGovernor();
+
+    // sets the quality knobs for a level of the governor and publishes it
+    void ApplyQualityLevel(const int level);
+
     // stop the running haptic thread (if any), destruct the previous task
     // (if any) and start a new task and thread.
     void HandleTaskEvent();
@@ -55,12 +115,40 @@ private:
     // stop the running haptic thread and destruct the  task object
     void DeleteTask();
 
+    // applies the control events received since the last frame. Called at
+    // the beginning of each frame so that the task and the graphics are
+    // only modified by the render thread.
+    void ApplyControlEvents();
+
+    void HandleControlEvent(const int8_t event);
+
+    // starts one spinner thread for each callback queue
+    void StartSpinners();
+
     // Locking call to retrieve the images
     void LockAndGetImages(ros::Duration timeout, cv::Mat images[]);
 
-    // return true if both images are newly received and copy them in imgs
+    // return true if both images are newly received. The images are not
+    // copied: imgs point to the data of the received messages, which stay
+    // alive until the next call.
     bool GetNewImages( cv::Mat images[]);
 
+    // The image of the message in bgr8, sharing its data when it already is
+    // bgr8. Throws cv_bridge::Exception for the encodings it can't convert.
+    cv_bridge::CvImageConstPtr DecodeImage(
+            const sensor_msgs::ImageConstPtr &msg);
+
+    // Shares the image data of the message and hands it to the stereo
+    // synchronizer.
+    void IngestImage(const sensor_msgs::ImageConstPtr &msg, const int cam_id);
+
+    // Hands the two halves of a stereo image to the stereo synchronizer, as
+    // views in the image of the message
+    void IngestStereoImage(const sensor_msgs::ImageConstPtr &msg);
+
+    // publishes the statistics of the image pipeline on /diagnostics
+    void PublishDiagnostics();
+
     // If the poses of the cameras are published, this method will return
     // true when any of the cam poses are updated. If left or right pose is
     // missing it will be found transforming the other available pose with the
@@ -83,14 +171,21 @@ private:
 
     void StartArmToWorldFrameCalibration(const uint arm_id);
 
-    void Cleanup();
-
     void PublishRenderedImages();
 
-    // reads the intrinsic camera parameters
+    // renders the observer view if its period elapsed, and publishes it if
+    // observer_view_publish is set
+    void RenderObserverView();
+
+    // stamp of the oldest tool pose the task is using, zero if none arrived
+    ros::Time GetToolPoseStamp();
+
+    // reads the intrinsic camera parameters. image_size is empty if the
+    // file does not have it.
     void ReadCameraParameters(const std::string file_path,
                               cv::Mat &camera_matrix,
-                              cv::Mat &camera_distortion);
+                              cv::Mat &camera_distortion,
+                              cv::Size &image_size);
 
 public:
     // -------------------------------------------------------------------------
@@ -99,6 +194,9 @@ public:
 
     void ImageRightCallback(const sensor_msgs::ImageConstPtr &msg);
 
+    // both eyes in one image, see stereo_image_layout
+    void ImageStereoCallback(const sensor_msgs::ImageConstPtr &msg);
+
     // The camera poses. Note that this actually defines the pose of the
     // task coordinate frame in camera coordinate frame
     void LeftCamPoseCallback(const geometry_msgs::PoseStampedConstPtr &msg);
@@ -130,6 +228,55 @@ private:
     SimTask *task_ptr;
 
     Rendering * graphics;
+    // NULL unless undistort_background is set
+    ImageUndistorter * background_undistorter[2] = {NULL, NULL};
+
+    FrameScheduler * frame_scheduler;
+    bool skipped_last_frame = false;
+
+    // the quality given up at each level of the governor, in order
+    struct QualityStep {
+        enum Knob { OBSERVER_VIEW, SHADOW_RESOLUTION, MESH_LOD, RENDER_SCALE };
+        Knob knob;
+        double value;
+    };
+    // NULL unless adaptive_quality is set
+    QualityGovernor * quality_governor = NULL;
+    std::vector<QualityStep> quality_steps;
+    ros::Publisher publisher_quality_level;
+    // 0 without shadows
+    int shadow_map_resolution = 0;
+    // the observer view is off at the current quality level
+    bool observer_view_suspended = false;
+
+    // follows the stamps of the source images and poses of each frame
+    // through the pipeline. The trace is written to latency_trace_file on
+    // CE_WRITE_LATENCY_TRACE.
+    LatencyTracer latency_tracer;
+    std::string latency_trace_file;
+
+    // records the received messages if record_session_file is set
+    SessionRecorder * session_recorder = NULL;
+    // stamp of the published overlay: the stamp of the camera images in AR
+    // mode, the start of the frame in VR mode
+    ros::Time frame_stamp;
+    // the rendered frames whose images are not read back yet, oldest first:
+    // the headers of their images and the sources of their latencies
+    struct PendingReadback {
+        std::array<std_msgs::Header, 2> headers;
+        LatencyTracer::FrameSources sources;
+    };
+    std::deque<PendingReadback> pending_readbacks;
+    // shows and publishes the rendered images from its own thread
+    FramePublisher * frame_publisher = NULL;
+
+    // observer view, rendered at most once per observer_view_period
+    ros::Duration observer_view_period;
+    ros::Time last_observer_view_time;
+    bool observer_view_publish = false;
+    // copies the observer view in a message and publishes it from its own
+    // thread, when observer_view_publish is set
+    FramePublisher * observer_publisher = NULL;
 
     boost::thread haptics_thread;
 
@@ -137,13 +284,47 @@ private:
     // ----------------------------------
 
     ros::NodeHandle n;
+
+    // Each group of callbacks has its own queue served by its own spinner
+    // thread: images, tool and camera kinematics, and control events. The
+    // node handles are copies of n that use these queues.
+    ros::CallbackQueue image_callback_queue;
+    ros::CallbackQueue kinematics_callback_queue;
+    ros::CallbackQueue control_callback_queue;
+    ros::NodeHandle n_images;
+    ros::NodeHandle n_kinematics;
+    ros::NodeHandle n_control;
+    std::unique_ptr<ros::AsyncSpinner> spinners[3];
+
+    // parameters read after the setup are served from here, never from the
+    // parameter server directly. Stopped by Cleanup, or at the latest when
+    // it is destroyed with ARCore.
+    std::unique_ptr<ParameterCache> parameters;
+    const CachedParam<double> * cam_pose_averaging_factor;
+    const CachedParam<std::string> * slave_name_params[2];
+    const CachedParam<std::string> * left_cam_name_param;
+    const CachedParam<std::string> * left_image_topic_name_param;
+    const CachedParam<double> * calib_points_distance_param;
+    const CachedParam<std::vector<double> > * board_params_param;
+    const CachedParam<int> * num_calibration_points;
+
+    // control events are queued by the callback and applied by the render
+    // thread at the beginning of the next frame.
+    std::mutex control_events_mutex;
+    std::deque<int8_t> pending_control_events;
     double   haptic_loop_rate;
     int n_arms;
     bool ar_mode                        = false;
     bool publish_overlayed_images       = false;
     bool one_window_mode                = false;
     bool new_task_event                 = false;
+    // set by the control events, all the events of a frame are applied
+    // before these are checked
+    bool exit_event                     = false;
+    bool calib_arm1_event               = false;
     bool show_reference_frames          = false;
+    // do not render frames that would be identical to the previous one
+    bool skip_unchanged_frames          = true;
 
     std::string mesh_files_dir;
 
@@ -151,10 +332,22 @@ private:
     bool with_guidance;
     cv::Mat camera_matrix[2];
     cv::Mat camera_distortion[2];
+    // resolution the intrinsics were calibrated at, empty if unknown
+    cv::Size camera_image_size[2];
+    // resolution of the virtual objects relative to the camera images
+    double scene_render_scale = 1.0;
+    // owned by the render thread, updated from cam_pose_channel
     KDL::Frame pose_cam[2];
-    KDL::Frame pose_current_tool[2];
-    double gripper_current[2];
+    // written by the kinematics callbacks and read without locks by the
+    // render and haptics threads
+    PoseChannel cam_pose_channel[2];
+    uint64_t cam_pose_sequence[2] = {0, 0};
+    PoseChannel pose_current_tool[2];
+    GripperChannel gripper_current[2];
+    // owned by the render thread, which publishes each change on
+    // slave_frame_to_world_channel for the tool pose callbacks
     KDL::Frame slave_frame_to_world_frame[2];
+    PoseChannel slave_frame_to_world_channel[2];
     KDL::Frame left_cam_to_right_cam_tr;
 
     //// estimate left to right cam trans
@@ -165,16 +358,23 @@ private:
     cv::Vec3d cam_tvec_curr[2];
     cv::Vec3d cam_rvec_avg[2];
     cv::Vec3d cam_tvec_avg[2];
-    bool new_image[2] = {false, false};
     bool new_cam_pose[2] = {false, false};;
 
-    cv::Mat image_from_ros[2];
+    // the image callbacks push the shared images here and the render loop
+    // takes the newest pair with matching stamps without copying.
+    StereoSynchronizer stereo_synchronizer;
+    // the pair currently used by the render loop
+    StereoFrame image_from_ros;
+    // bytes of image data copied by the callbacks because the encoding of
+    // the message was not bgr8 (written by the callbacks, read per frame).
+    std::atomic<uint64_t> ingest_bytes_copied;
     uint running_task_id;
-    std::string cv_window_names[2];
-    int8_t control_event;
 
     image_transport::ImageTransport *it;
+    // with a stereo image topic only the first one is used
     image_transport::Subscriber image_subscribers[2];
+    // layout of the stereo image: left eye on top instead of on the left
+    bool stereo_image_top_bottom = false;
 
     image_transport::Subscriber subscriber_image_left;
     image_transport::Subscriber subscriber_image_right;
@@ -187,10 +387,13 @@ private:
     ros::Subscriber * subtool_current_gripper;
     ros::Publisher * publisher_tool_pose_desired;
     ros::Publisher publisher_task_state;
+    ros::Publisher publisher_diagnostics;
+    ros::Time last_diagnostics_time;
 
     //overlay image publishers
     image_transport::Publisher publisher_overlayed[2];
     image_transport::Publisher publisher_stereo_overlayed;
+    image_transport::Publisher publisher_observer;
 
     // two function pointers for slave pose callbacks
     void (ARCore::*pose_current_tool_callbacks[2])
@@ -203,6 +406,9 @@ private:
 
 };
 
-void SwitchFullScreenCV(const std::string window_name);
+// appends each name/value couple as a key value of the diagnostic status
+void AddDiagnosticValues(diagnostic_msgs::DiagnosticStatus &status,
+                         const std::vector<std::pair<std::string, double> >
+                         &values);
 
 #endif //TELEOP_VISION_OVERLAYROSCONFIG_H
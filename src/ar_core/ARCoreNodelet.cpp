@@ -0,0 +1,87 @@
+//
+// ar_core as a nodelet, to share a manager with the camera drivers and the
+// board detectors.
+//
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <nodelet/nodelet.h>
+#include <ros/ros.h>
+#include "ARCore.h"
+
+namespace atar {
+
+/**
+ * \class ARCoreNodelet
+ * \brief Runs ARCore and its render loop in a nodelet manager.
+ *
+ * The images of the cameras and the poses of the board detectors loaded in
+ * the same manager reach ARCore as shared pointers, without serialization.
+ * ARCore takes its parameters from the private namespace of the nodelet,
+ * the same as those of the ar_core node.
+ *
+ * onInit must return, so the render loop has its own thread. ARCore is also
+ * built in that thread so that the OpenGL context of its windows is created
+ * and used by the same thread.
+ */
+class ARCoreNodelet : public nodelet::Nodelet {
+public:
+
+    ARCoreNodelet() : running_(false) {}
+
+    ~ARCoreNodelet();
+
+    virtual void onInit();
+
+private:
+    void RenderLoop();
+
+    std::atomic<bool> running_;
+    std::thread render_thread_;
+};
+
+//------------------------------------------------------------------------------
+ARCoreNodelet::~ARCoreNodelet() {
+
+    running_ = false;
+    if(render_thread_.joinable())
+        render_thread_.join();
+}
+
+//------------------------------------------------------------------------------
+void ARCoreNodelet::onInit() {
+
+    running_ = true;
+    render_thread_ = std::thread(&ARCoreNodelet::RenderLoop, this);
+}
+
+//------------------------------------------------------------------------------
+void ARCoreNodelet::RenderLoop() {
+
+    std::unique_ptr<ARCore> acore;
+    try {
+        acore.reset(new ARCore(getPrivateNodeHandle()));
+    }
+    catch (std::exception &e) {
+        NODELET_ERROR("Could not start ar_core: %s", e.what());
+        return;
+    }
+
+    // the frame scheduler wakes up at least every idle period when the
+    // cameras stop, so the loop sees the nodelet being unloaded
+    while (running_ && ros::ok()) {
+        acore->WaitForNextFrame();
+        if(!acore->UpdateWorld())
+            break;
+    }
+    // already done if the loop ended with the exit event
+    acore->Cleanup();
+    NODELET_INFO("ar_core stopped.");
+}
+
+}
+
+#include <pluginlib/class_list_macros.h>
+PLUGINLIB_EXPORT_CLASS(atar::ARCoreNodelet, nodelet::Nodelet)
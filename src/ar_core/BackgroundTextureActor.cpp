@@ -0,0 +1,214 @@
+//
+// Shows the camera images behind the virtual scene from persistent textures.
+//
+
+#include "BackgroundTextureActor.h"
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <vtkgl.h>
+#include <vtkRenderer.h>
+#include <vtkObjectFactory.h>
+#include <vtkOpenGLExtensionManager.h>
+
+vtkStandardNewMacro(BackgroundTextureActor);
+
+typedef std::chrono::steady_clock Clock;
+
+//------------------------------------------------------------------------------
+BackgroundTextureActor::BackgroundTextureActor()
+        : version_(0), upload_time_(0.0)
+{
+}
+
+//------------------------------------------------------------------------------
+void BackgroundTextureActor::SetImage(const cv::Mat &image) {
+
+    if(image.type() != CV_8UC3)
+        throw std::runtime_error("BackgroundTextureActor expects bgr8 images.");
+
+    image_ = image;
+    version_++;
+    Modified();
+}
+
+//------------------------------------------------------------------------------
+double BackgroundTextureActor::TakeUploadTime() {
+    double upload_time = upload_time_;
+    upload_time_ = 0.0;
+    return upload_time;
+}
+
+//------------------------------------------------------------------------------
+double *BackgroundTextureActor::GetBounds() {
+
+    // the pixel centers are on the integer coordinates
+    Bounds[0] = -0.5;
+    Bounds[1] = image_.cols - 0.5;
+    Bounds[2] = -0.5;
+    Bounds[3] = image_.rows - 0.5;
+    Bounds[4] = Bounds[5] = 0.0;
+    return Bounds;
+}
+
+//------------------------------------------------------------------------------
+int BackgroundTextureActor::RenderOpaqueGeometry(vtkViewport *viewport) {
+
+    vtkRenderer *renderer = vtkRenderer::SafeDownCast(viewport);
+    if(!renderer || image_.empty())
+        return 0;
+
+    vtkOpenGLRenderWindow *window =
+            vtkOpenGLRenderWindow::SafeDownCast(renderer->GetRenderWindow());
+    if(!window)
+        return 0;
+
+    WindowTexture &texture = GetWindowTexture(window);
+    if(texture.version != version_) {
+        Clock::time_point start = Clock::now();
+        Upload(texture);
+        upload_time_ +=
+                std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    Draw(texture);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+void BackgroundTextureActor::ReleaseGraphicsResources(vtkWindow *window) {
+
+    std::map<vtkWindow *, WindowTexture>::iterator it = textures_.find(window);
+    if(it == textures_.end())
+        return;
+
+    // called by vtk with the context of the window current
+    if(it->second.texture)
+        glDeleteTextures(1, &it->second.texture);
+    if(it->second.upload_buffer)
+        vtkgl::DeleteBuffers(1, &it->second.upload_buffer);
+    textures_.erase(it);
+}
+
+//------------------------------------------------------------------------------
+BackgroundTextureActor::WindowTexture &
+BackgroundTextureActor::GetWindowTexture(vtkOpenGLRenderWindow *window) {
+
+    std::map<vtkWindow *, WindowTexture>::iterator it = textures_.find(window);
+    if(it != textures_.end())
+        return it->second;
+
+    WindowTexture &texture = textures_[window];
+    std::memset(&texture, 0, sizeof(texture));
+    // so that the first image is uploaded
+    texture.version = version_ - 1;
+
+    vtkOpenGLExtensionManager *extensions = window->GetExtensionManager();
+    if(extensions->ExtensionSupported("GL_VERSION_1_5")
+       && (extensions->ExtensionSupported("GL_VERSION_2_1")
+           || extensions->ExtensionSupported("GL_ARB_pixel_buffer_object"))) {
+        extensions->LoadSupportedExtension("GL_VERSION_1_5");
+        vtkgl::GenBuffers(1, &texture.upload_buffer);
+    }
+    return texture;
+}
+
+//------------------------------------------------------------------------------
+void BackgroundTextureActor::Upload(WindowTexture &texture) {
+
+    const int width = image_.cols;
+    const int height = image_.rows;
+
+    glPushAttrib(GL_TEXTURE_BIT);
+    if(texture.texture == 0)
+        glGenTextures(1, &texture.texture);
+    glBindTexture(GL_TEXTURE_2D, texture.texture);
+
+    if(width != texture.width || height != texture.height) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
+                        vtkgl::CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
+                        vtkgl::CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0,
+                     vtkgl::BGR, GL_UNSIGNED_BYTE, NULL);
+        texture.width = width;
+        texture.height = height;
+    }
+
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    const size_t row_size = (size_t)width * 3;
+    bool uploaded = false;
+    if(texture.upload_buffer) {
+        vtkgl::BindBuffer(vtkgl::PIXEL_UNPACK_BUFFER, texture.upload_buffer);
+        // orphan the storage of the previous image, which the driver may
+        // still be reading, instead of waiting for it
+        vtkgl::BufferData(vtkgl::PIXEL_UNPACK_BUFFER,
+                          (vtkgl::GLsizeiptr)(row_size * height), NULL,
+                          vtkgl::STREAM_DRAW);
+        uchar *destination = static_cast<uchar *>(vtkgl::MapBuffer(
+                vtkgl::PIXEL_UNPACK_BUFFER, vtkgl::WRITE_ONLY));
+        if(destination) {
+            if(image_.isContinuous())
+                std::memcpy(destination, image_.data, row_size * height);
+            else
+                for (int row = 0; row < height; ++row)
+                    std::memcpy(destination + row * row_size,
+                                image_.ptr(row), row_size);
+            vtkgl::UnmapBuffer(vtkgl::PIXEL_UNPACK_BUFFER);
+            // the data pointer is an offset in the bound buffer
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                            vtkgl::BGR, GL_UNSIGNED_BYTE, 0);
+            uploaded = true;
+        }
+        vtkgl::BindBuffer(vtkgl::PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    if(!uploaded) {
+        // a view in a larger image, e.g. one eye of a side by side stereo
+        // image, is read in place with the row length of its parent
+        cv::Mat source = image_;
+        if(!source.isContinuous() && source.step[0] % source.elemSize() != 0)
+            source = image_.clone();
+        if(!source.isContinuous())
+            glPixelStorei(GL_UNPACK_ROW_LENGTH,
+                          (GLint)(source.step[0] / source.elemSize()));
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                        vtkgl::BGR, GL_UNSIGNED_BYTE, source.data);
+    }
+
+    glPopClientAttrib();
+    glPopAttrib();
+    texture.version = version_;
+}
+
+//------------------------------------------------------------------------------
+void BackgroundTextureActor::Draw(const WindowTexture &texture) const {
+
+    glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_CURRENT_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_BLEND);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, texture.texture);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+    glColor3f(1.f, 1.f, 1.f);
+
+    // the first row of the image is at v = 0, as with vtkImageImport
+    const double left = -0.5, right = texture.width - 0.5;
+    const double bottom = -0.5, top = texture.height - 0.5;
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.f, 0.f);
+    glVertex3d(left, bottom, 0.0);
+    glTexCoord2f(1.f, 0.f);
+    glVertex3d(right, bottom, 0.0);
+    glTexCoord2f(1.f, 1.f);
+    glVertex3d(right, top, 0.0);
+    glTexCoord2f(0.f, 1.f);
+    glVertex3d(left, top, 0.0);
+    glEnd();
+
+    glPopAttrib();
+}
@@ -0,0 +1,91 @@
+//
+// Shows the camera images behind the virtual scene from persistent textures.
+//
+
+#ifndef ATAR_BACKGROUNDTEXTUREACTOR_H
+#define ATAR_BACKGROUNDTEXTUREACTOR_H
+
+#include <map>
+#include <cstdint>
+#include <opencv2/core/core.hpp>
+#include <vtkProp.h>
+#include <vtkOpenGL.h>
+#include <vtkOpenGLRenderWindow.h>
+
+/**
+ * \class BackgroundTextureActor
+ * \brief Draws a bgr8 image in the plane z=0, pixel (u, v) centered at
+ * (u, v), like a vtkImageActor showing the output of a vtkImageImport.
+ *
+ * Each window showing the actor keeps its own texture, allocated once and
+ * updated in place when a new image is set. The upload goes through a
+ * pixel unpack buffer that is orphaned before each update, so the copy
+ * does not wait for the GPU to finish drawing the previous image. The
+ * image is uploaded as GL_BGR and the driver swizzles it into the texture,
+ * there is no color conversion on the cpu. Without pixel buffer objects
+ * the texture is updated directly from the image.
+ */
+class BackgroundTextureActor : public vtkProp {
+public:
+
+    static BackgroundTextureActor *New();
+
+    vtkTypeMacro(BackgroundTextureActor, vtkProp);
+
+    // Sets the image shown from the next render on. The data is uploaded
+    // during the next render of each window showing the actor and must
+    // stay valid until then.
+    void SetImage(const cv::Mat &image);
+
+    int GetImageWidth() const { return image_.cols; }
+
+    int GetImageHeight() const { return image_.rows; }
+
+    // The image last set, shown since the last render
+    const cv::Mat &GetImage() const { return image_; }
+
+    // Time spent uploading images since the last call [s]. This is the
+    // time taken on the render thread; the transfer itself is asynchronous.
+    double TakeUploadTime();
+
+    double *GetBounds();
+
+    int RenderOpaqueGeometry(vtkViewport *viewport);
+
+    int HasTranslucentPolygonalGeometry() { return 0; }
+
+    void ReleaseGraphicsResources(vtkWindow *window);
+
+protected:
+    BackgroundTextureActor();
+
+    ~BackgroundTextureActor() {}
+
+private:
+    BackgroundTextureActor(const BackgroundTextureActor &);  // Not implemented
+    void operator=(const BackgroundTextureActor &);  // Not implemented
+
+    // the textures are not shared between the contexts of the windows
+    struct WindowTexture {
+        GLuint texture;
+        // 0 if pixel buffer objects are not supported
+        GLuint upload_buffer;
+        int width;
+        int height;
+        // version of the image in the texture
+        uint64_t version;
+    };
+
+    WindowTexture &GetWindowTexture(vtkOpenGLRenderWindow *window);
+
+    void Upload(WindowTexture &texture);
+
+    void Draw(const WindowTexture &texture) const;
+
+    cv::Mat image_;
+    uint64_t version_;
+    double upload_time_;
+    std::map<vtkWindow *, WindowTexture> textures_;
+};
+
+#endif //ATAR_BACKGROUNDTEXTUREACTOR_H
@@ -7,6 +7,7 @@
 #include <vtkOpenGLRenderer.h>
 #include <vtkOpenGLRenderWindow.h>
 #include <ros/ros.h> // added only for ros_debug
+#include <algorithm>
 
 //
 //
@@ -23,6 +24,9 @@ CalibratedCamera::CalibratedCamera()
         , fy_(1)
         , cx_(0)
         , cy_(0)
+        , view_up_to_date_(false)
+        , face_image_up_to_date_(false)
+        , pose_up_to_date_(false)
 {
     intrinsic_matrix = vtkMatrix4x4::New();
     intrinsic_matrix->Identity();
@@ -36,6 +40,7 @@ void CalibratedCamera::SetCameraImageSize(const int &width, const int &height)
 {
     image_width_ = width;
     image_height_ = height;
+    view_up_to_date_ = false;
     camera->Modified();
 }
 
@@ -48,6 +53,7 @@ void CalibratedCamera::SetIntrinsicParameters(const double& fx, const double& fy
     fy_ = fy;
     cx_ = cx;
     cy_ = cy;
+    view_up_to_date_ = false;
 
     ROS_DEBUG_STREAM( std::string("Camera Matrix: fx= ") <<  fx_ << ", fy= " <<  fy_
               << ", cx= " <<  cx_ << ", cy= " <<  cy_ );
@@ -55,7 +61,7 @@ void CalibratedCamera::SetIntrinsicParameters(const double& fx, const double& fy
 
 
 //----------------------------------------------------------------------------
-void CalibratedCamera::SetExtrinsicParameters(vtkSmartPointer<vtkMatrix4x4> matrix)
+bool CalibratedCamera::SetExtrinsicParameters(vtkSmartPointer<vtkMatrix4x4> matrix)
 {
 
     double origin[4]     = {0,  0,   0, 1};
@@ -69,19 +75,38 @@ void CalibratedCamera::SetExtrinsicParameters(vtkSmartPointer<vtkMatrix4x4> matr
     viewUp[1] = viewUp[1] - origin[1];
     viewUp[2] = viewUp[2] - origin[2];
 
+    // each update modifies the camera, which makes the scene look changed
+    const double arguments[9] = {origin[0], origin[1], origin[2],
+                                 focalPoint[0], focalPoint[1], focalPoint[2],
+                                 viewUp[0], viewUp[1], viewUp[2]};
+    if(pose_up_to_date_
+       && std::equal(arguments, arguments + 9, pose_arguments_))
+        return false;
+    pose_up_to_date_ = true;
+    std::copy(arguments, arguments + 9, pose_arguments_);
+
     camera->SetPosition(origin[0], origin[1], origin[2]);
     camera->SetFocalPoint(focalPoint[0], focalPoint[1], focalPoint[2]);
     camera->SetViewUp(viewUp[0], viewUp[1], viewUp[2]);
     camera->SetClippingRange(0.05, 10);
 
     camera->Modified();
+    return true;
 }
 
 
 
-void CalibratedCamera::UpdateView(const double &window_width,
+bool CalibratedCamera::UpdateView(const double &window_width,
                                   const double &window_height) {
 
+    // each update modifies the camera, which makes the scene look changed
+    if(view_up_to_date_ && window_width == view_size_[0]
+       && window_height == view_size_[1])
+        return false;
+    view_up_to_date_ = true;
+    view_size_[0] = window_width;
+    view_size_[1] = window_height;
+
     //When window aspect ratio is different than that of the image we need to
     // take that into account
     double image_aspect_ratio =  image_width_ / image_height_;
@@ -106,12 +131,24 @@ void CalibratedCamera::UpdateView(const double &window_width,
     camera->SetWindowCenter(wc_x, wc_y);
 
     camera->Modified();
+    return true;
 }
 
-void CalibratedCamera::SetCemraToFaceImage(const int *window_size,
+bool CalibratedCamera::SetCemraToFaceImage(const int *window_size,
                                            const int imageSize[], const double spacing[],
                                            const double origin[]) {
 
+    const double arguments[9] = {(double)window_size[0],
+                                 (double)window_size[1],
+                                 (double)imageSize[0], (double)imageSize[1],
+                                 spacing[0], spacing[1],
+                                 origin[0], origin[1], origin[2]};
+    if(face_image_up_to_date_
+       && std::equal(arguments, arguments + 9, face_image_arguments_))
+        return false;
+    face_image_up_to_date_ = true;
+    std::copy(arguments, arguments + 9, face_image_arguments_);
+
 
     double clippingRange[2];
     clippingRange[0] = 1;
@@ -170,6 +207,7 @@ void CalibratedCamera::SetCemraToFaceImage(const int *window_size,
     camera->SetParallelScale(scale);
     camera->SetClippingRange(clippingRange);
 
+    return true;
 }
 
 
@@ -57,18 +57,24 @@ public:
     /**
     * \brief Update the view angle of the virtual Camera according to window size
      * Note that the windows is the opengl window here,
+     * Returns false, without touching the camera, if neither the window size
+     * nor the intrinsics changed since the last update.
     */
-    void UpdateView(const double &width, const double &height);
+    bool UpdateView(const double &width, const double &height);
 
     /**
      * \brief Sets the pose of the camera with respect to world (task frame)
+     * Returns false, without touching the camera, if the pose is that of
+     * the last call.
      */
-    void SetExtrinsicParameters(vtkSmartPointer<vtkMatrix4x4> matrix);
+    bool SetExtrinsicParameters(vtkSmartPointer<vtkMatrix4x4> matrix);
 
     /**
      * \brief FaceImage
+     * Returns false, without touching the camera, if the arguments are those
+     * of the last call.
      */
-    void SetCemraToFaceImage(const int *window_siz,
+    bool SetCemraToFaceImage(const int *window_siz,
                              const int imageSize[], const double spacing[],
                              const double origin[]);
 
@@ -90,6 +96,15 @@ private:
     double fy_;
     double cx_;
     double cy_;
+
+    // arguments of the last view updates, to skip the unchanged ones
+    bool view_up_to_date_;
+    double view_size_[2];
+    bool face_image_up_to_date_;
+    double face_image_arguments_[9];
+    bool pose_up_to_date_;
+    // position, focal point and view up
+    double pose_arguments_[9];
 };
 
 
@@ -0,0 +1,66 @@
+//
+// Detection of the changes of a vtk scene through the modification times.
+//
+
+#include "ChangeTracking.h"
+#include <algorithm>
+#include <vtkActor.h>
+#include <vtkAlgorithm.h>
+#include <vtkDataObject.h>
+#include <vtkLight.h>
+#include <vtkLightCollection.h>
+#include <vtkMapper.h>
+#include <vtkPropCollection.h>
+
+namespace {
+
+//------------------------------------------------------------------------------
+// Latest modification time of algorithm and of everything upstream of it:
+// the algorithms connected to its inputs, recursively, and the data objects
+// on these connections
+unsigned long GetPipelineMTime(vtkAlgorithm *algorithm) {
+
+    unsigned long mtime = algorithm->GetMTime();
+    for (int port = 0; port < algorithm->GetNumberOfInputPorts(); ++port) {
+        const int connections = algorithm->GetNumberOfInputConnections(port);
+        for (int i = 0; i < connections; ++i) {
+            if(vtkDataObject *data = algorithm->GetInputDataObject(port, i))
+                mtime = std::max<unsigned long>(mtime, data->GetMTime());
+            if(vtkAlgorithm *input = algorithm->GetInputAlgorithm(port, i))
+                mtime = std::max(mtime, GetPipelineMTime(input));
+        }
+    }
+    return mtime;
+}
+
+}
+
+//------------------------------------------------------------------------------
+unsigned long ChangeTracking::GetSceneMTime(vtkRenderer *renderer) {
+
+    // props or lights added or removed
+    unsigned long mtime = std::max<unsigned long>(
+            renderer->GetViewProps()->GetMTime(),
+            renderer->GetLights()->GetMTime());
+
+    vtkLightCollection *lights = renderer->GetLights();
+    vtkCollectionSimpleIterator light_it;
+    lights->InitTraversal(light_it);
+    while (vtkLight *light = lights->GetNextLight(light_it))
+        mtime = std::max<unsigned long>(mtime, light->GetMTime());
+
+    vtkPropCollection *props = renderer->GetViewProps();
+    vtkCollectionSimpleIterator prop_it;
+    props->InitTraversal(prop_it);
+    while (vtkProp *prop = props->GetNextProp(prop_it)) {
+        // includes the user matrix of the actors and their properties
+        mtime = std::max<unsigned long>(mtime, prop->GetMTime());
+
+        vtkActor *actor = vtkActor::SafeDownCast(prop);
+        if(!actor || !actor->GetMapper())
+            continue;
+        // deformed geometry, or any change up the pipeline of the mapper
+        mtime = std::max(mtime, GetPipelineMTime(actor->GetMapper()));
+    }
+    return mtime;
+}
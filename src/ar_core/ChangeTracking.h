@@ -0,0 +1,22 @@
+//
+// Detection of the changes of a vtk scene through the modification times.
+//
+
+#ifndef ATAR_CHANGETRACKING_H
+#define ATAR_CHANGETRACKING_H
+
+#include <vtkRenderer.h>
+
+namespace ChangeTracking {
+
+    // Latest modification time of what the image of the props of renderer
+    // depends on, apart from the camera: the props (their user matrix and
+    // properties included), the mappers of the actors and their whole
+    // input pipelines, the lights, and the collections of props and lights themselves.
+    // vtk's modification times are global, so a scene has changed since
+    // an earlier call if and only if this returns a larger value.
+    unsigned long GetSceneMTime(vtkRenderer *renderer);
+
+}
+
+#endif //ATAR_CHANGETRACKING_H
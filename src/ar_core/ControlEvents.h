@@ -31,6 +31,7 @@ enum {
     CE_TOGGLE_FULLSCREEN = 30,
     CE_PUBLISH_IMGS_ON = 31,
     CE_PUBLISH_IMGS_OFF = 32,
+    CE_WRITE_LATENCY_TRACE = 33,
 
     CE_EXIT = 100
 
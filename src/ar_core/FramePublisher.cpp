@@ -0,0 +1,244 @@
+//
+// Shows and publishes the rendered images away from the render thread.
+//
+
+#include "FramePublisher.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <ros/ros.h>
+#include <boost/make_shared.hpp>
+#include <sensor_msgs/image_encodings.h>
+#include "opencv2/highgui/highgui.hpp"
+
+namespace {
+
+//------------------------------------------------------------------------------
+void ToggleFullScreen(const std::string &window_name) {
+
+    if (cv::getWindowProperty(window_name, cv::WND_PROP_FULLSCREEN)
+        == cv::WINDOW_NORMAL)
+        cv::setWindowProperty(window_name, cv::WND_PROP_FULLSCREEN,
+                              cv::WINDOW_FULLSCREEN);
+    else
+        cv::setWindowProperty(window_name, cv::WND_PROP_FULLSCREEN,
+                              cv::WINDOW_NORMAL);
+}
+
+}
+
+//------------------------------------------------------------------------------
+FramePublisher::FramePublisher(
+        const bool one_window,
+        const image_transport::Publisher publishers[2],
+        const image_transport::Publisher &stereo_publisher,
+        const std::vector<std::string> &window_names,
+        const std::function<void()> &stop_callback,
+        LatencyTracer *latency_tracer,
+        const size_t queue_size)
+        : one_window_(one_window),
+          stereo_publisher_(stereo_publisher),
+          window_names_(window_names),
+          stop_callback_(stop_callback),
+          latency_tracer_(latency_tracer),
+          windows_created_(false),
+          queue_size_(std::max<size_t>(1, queue_size)),
+          running_(false),
+          num_published_(0),
+          num_dropped_(0)
+{
+    publishers_[0] = publishers[0];
+    publishers_[1] = publishers[1];
+
+    // the queued frames, one being read back and one being published
+    for (size_t i = 0; i < queue_size_ + 2; ++i) {
+        frames_.push_back(std::unique_ptr<Frame>(new Frame));
+        free_frames_.push_back(frames_.back().get());
+    }
+}
+
+//------------------------------------------------------------------------------
+FramePublisher::~FramePublisher() {
+    Stop();
+}
+
+//------------------------------------------------------------------------------
+void FramePublisher::Start() {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(running_)
+        return;
+
+    running_ = true;
+    worker_ = std::thread(&FramePublisher::WorkerThread, this);
+}
+
+//------------------------------------------------------------------------------
+void FramePublisher::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    queue_condition_.notify_all();
+
+    if(worker_.joinable())
+        worker_.join();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    while(!queued_frames_.empty()) {
+        free_frames_.push_back(queued_frames_.front());
+        queued_frames_.pop_front();
+    }
+}
+
+//------------------------------------------------------------------------------
+FramePublisher::Frame *FramePublisher::AcquireFrame() {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // can only happen if frames are acquired without being pushed back
+    if(free_frames_.empty()) {
+        if(queued_frames_.empty())
+            throw std::runtime_error("FramePublisher: all the frames are in "
+                                             "use.");
+        free_frames_.push_back(queued_frames_.front());
+        queued_frames_.pop_front();
+        num_dropped_++;
+    }
+    Frame *frame = free_frames_.front();
+    free_frames_.pop_front();
+    return frame;
+}
+
+//------------------------------------------------------------------------------
+void FramePublisher::Push(Frame *frame) {
+    frame->push_time = ros::Time::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(queued_frames_.size() >= queue_size_) {
+            free_frames_.push_back(queued_frames_.front());
+            queued_frames_.pop_front();
+            num_dropped_++;
+        }
+        queued_frames_.push_back(frame);
+    }
+    queue_condition_.notify_one();
+}
+
+//------------------------------------------------------------------------------
+void FramePublisher::Release(Frame *frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_frames_.push_back(frame);
+}
+
+//------------------------------------------------------------------------------
+void FramePublisher::GetFrameCounts(unsigned long &published,
+                                    unsigned long &dropped) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    published = num_published_;
+    dropped = num_dropped_;
+}
+
+//------------------------------------------------------------------------------
+void FramePublisher::WorkerThread() {
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(running_) {
+
+        // the windows need waitKey to process their events even when no
+        // frame arrives
+        queue_condition_.wait_for(
+                lock, std::chrono::milliseconds(30),
+                [this] { return !running_ || !queued_frames_.empty(); });
+        if(!running_)
+            break;
+
+        Frame *frame = NULL;
+        if(!queued_frames_.empty()) {
+            frame = queued_frames_.front();
+            queued_frames_.pop_front();
+        }
+
+        // the frame is neither free nor queued, the render thread will not
+        // touch it
+        lock.unlock();
+        if(frame)
+            ShowAndPublish(*frame);
+        if(windows_created_)
+            HandleKey(cv::waitKey(1));
+        lock.lock();
+
+        if(frame) {
+            free_frames_.push_back(frame);
+            num_published_++;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void FramePublisher::ShowAndPublish(const Frame &frame) {
+
+    const int num_images = one_window_ ? 1 : 2;
+    if(!windows_created_) {
+        for (size_t k = 0; k < window_names_.size(); ++k)
+            cv::namedWindow(window_names_[k], cv::WINDOW_NORMAL);
+        windows_created_ = !window_names_.empty();
+    }
+    for (int k = 0; k < num_images && k < (int)window_names_.size(); ++k)
+        if(!frame.images[k].empty())
+            cv::imshow(window_names_[k], frame.images[k]);
+
+    if(one_window_)
+        Publish(stereo_publisher_, frame.headers[0], frame.images[0],
+                messages_[0]);
+    else
+        for (int i = 0; i < 2; ++i)
+            Publish(publishers_[i], frame.headers[i], frame.images[i],
+                    messages_[i]);
+
+    // the frame is now on screen and sent to the subscribers
+    if(latency_tracer_)
+        latency_tracer_->RecordPublish(frame.sources, frame.push_time);
+}
+
+//------------------------------------------------------------------------------
+void FramePublisher::Publish(image_transport::Publisher &publisher,
+                             const std_msgs::Header &header,
+                             const cv::Mat &image,
+                             sensor_msgs::ImagePtr &msg) {
+
+    if(publisher.getNumSubscribers() == 0 || image.empty())
+        return;
+
+    // publish() serializes the message for the other processes before it
+    // returns, only the subscribers in this process keep a pointer to it
+    if(!msg || !msg.unique())
+        msg = boost::make_shared<sensor_msgs::Image>();
+
+    msg->header = header;
+    msg->height = (uint32_t)image.rows;
+    msg->width = (uint32_t)image.cols;
+    msg->encoding = sensor_msgs::image_encodings::BGR8;
+    msg->is_bigendian = 0;
+    msg->step = (uint32_t)(image.cols * image.elemSize());
+    msg->data.resize((size_t)msg->step * image.rows);
+    if(image.isContinuous())
+        std::memcpy(msg->data.data(), image.data, msg->data.size());
+    else
+        for (int row = 0; row < image.rows; ++row)
+            std::memcpy(msg->data.data() + (size_t)row * msg->step,
+                        image.ptr(row), msg->step);
+
+    publisher.publish(msg);
+}
+
+//------------------------------------------------------------------------------
+void FramePublisher::HandleKey(const int key) {
+
+    if((char)key == 27) { // Esc
+        if(stop_callback_)
+            stop_callback_();
+    }
+    else if((char)key == 'f')
+        for (size_t k = 0; k < window_names_.size(); ++k)
+            ToggleFullScreen(window_names_[k]);
+}
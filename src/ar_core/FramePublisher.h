@@ -0,0 +1,130 @@
+//
+// Shows and publishes the rendered images away from the render thread.
+//
+
+#ifndef ATAR_FRAMEPUBLISHER_H
+#define ATAR_FRAMEPUBLISHER_H
+
+#include <array>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include <opencv2/core/core.hpp>
+#include <image_transport/image_transport.h>
+#include <sensor_msgs/Image.h>
+#include <std_msgs/Header.h>
+#include "LatencyTracer.h"
+
+/**
+ * \class FramePublisher
+ * \brief A worker thread that shows the rendered images in OpenCV windows
+ * and publishes them, fed by a bounded queue of frames.
+ *
+ * The render thread takes a frame with AcquireFrame(), reads the rendered
+ * images back into it and hands it over with Push(). The frames come from
+ * a pool, so their images keep their buffers from one frame to the next.
+ * When the worker falls behind, the oldest queued frame is dropped: what is
+ * shown and published is always the latest frame and the render thread
+ * never waits.
+ *
+ * The worker converts a frame to a message only for the topics that have
+ * subscribers, and fills the message of the previous frame again unless a
+ * subscriber in this process still holds it. All the OpenCV window calls
+ * (creation, imshow, waitKey) are made from the worker. Esc in a window
+ * calls the stop callback and 'f' toggles the windows in full screen.
+ *
+ * Once a frame is shown and published, its publish stage and end-to-end
+ * latencies are recorded in the latency tracer, if one is given.
+ */
+class FramePublisher {
+public:
+
+    // The images rendered for one frame and the headers of the camera
+    // images they were drawn on
+    struct Frame {
+        cv::Mat images[2];
+        std::array<std_msgs::Header, 2> headers;
+        // the frame the images were rendered in
+        LatencyTracer::FrameSources sources;
+        // when the render thread pushed it
+        ros::Time push_time;
+    };
+
+    // With one_window, images[0] holds both eyes and is published on
+    // stereo_publisher, otherwise images[i] is published on publishers[i].
+    // window_names: one window per published image, created when the first
+    // frame is shown. stop_callback is called from the worker when Esc is
+    // pressed in a window; it must not wait for the worker.
+    // latency_tracer may be NULL.
+    FramePublisher(const bool one_window,
+                   const image_transport::Publisher publishers[2],
+                   const image_transport::Publisher &stereo_publisher,
+                   const std::vector<std::string> &window_names,
+                   const std::function<void()> &stop_callback,
+                   LatencyTracer *latency_tracer,
+                   const size_t queue_size = 2);
+
+    ~FramePublisher();
+
+    // Starts the worker thread
+    void Start();
+
+    // Stops and joins the worker thread. The queued frames are dropped.
+    void Stop();
+
+    // A frame to read the images of the next frame into. Never blocks.
+    Frame *AcquireFrame();
+
+    // Queues a frame taken with AcquireFrame() and sets its push_time
+    void Push(Frame *frame);
+
+    // Gives back a frame taken with AcquireFrame() without queuing it
+    void Release(Frame *frame);
+
+    // Frames shown and published, and frames dropped because the worker
+    // was behind
+    void GetFrameCounts(unsigned long &published,
+                        unsigned long &dropped) const;
+
+private:
+    void WorkerThread();
+
+    void ShowAndPublish(const Frame &frame);
+
+    // Copies image in msg and publishes it, if the topic has subscribers
+    void Publish(image_transport::Publisher &publisher,
+                 const std_msgs::Header &header, const cv::Mat &image,
+                 sensor_msgs::ImagePtr &msg);
+
+    void HandleKey(const int key);
+
+    bool one_window_;
+    image_transport::Publisher publishers_[2];
+    image_transport::Publisher stereo_publisher_;
+    std::vector<std::string> window_names_;
+    std::function<void()> stop_callback_;
+    LatencyTracer *latency_tracer_;
+    // only touched by the worker
+    bool windows_created_;
+    sensor_msgs::ImagePtr messages_[2];
+
+    size_t queue_size_;
+    std::vector<std::unique_ptr<Frame> > frames_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable queue_condition_;
+    bool running_;
+    std::thread worker_;
+    std::deque<Frame *> free_frames_;
+    // oldest first
+    std::deque<Frame *> queued_frames_;
+    unsigned long num_published_;
+    unsigned long num_dropped_;
+};
+
+#endif //ATAR_FRAMEPUBLISHER_H
@@ -0,0 +1,72 @@
+//
+// Decides when the render loop starts a new frame.
+//
+
+#include "FrameScheduler.h"
+#include <thread>
+
+//------------------------------------------------------------------------------
+FrameScheduler::FrameScheduler(const Mode mode, const double rate,
+                               const double frame_budget)
+        : mode_(mode),
+          idle_period_(std::chrono::milliseconds(100))
+{
+    double safe_rate = (rate > 0.0) ? rate : 30.0;
+    period_ = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / safe_rate));
+    frame_budget_ = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(frame_budget));
+
+    frame_start_ = Clock::now();
+    deadline_ = frame_start_ + period_;
+    next_slot_ = frame_start_;
+}
+
+//------------------------------------------------------------------------------
+void FrameScheduler::WaitForNextFrame(
+        const std::function<bool(Clock::duration)> &wait_for_event) {
+
+    if(mode_ == TARGET_RATE) {
+        Clock::time_point now = Clock::now();
+
+        // if we are late by one slot or more, jump to the next slot in the
+        // future instead of trying to catch up
+        if(now >= next_slot_ + period_) {
+            uint64_t late_slots = (uint64_t)((now - next_slot_) / period_);
+            statistics_.skipped_slots += late_slots;
+            next_slot_ += late_slots * period_;
+        }
+
+        if(next_slot_ > now)
+            std::this_thread::sleep_until(next_slot_);
+
+        frame_start_ = next_slot_;
+        next_slot_ += period_;
+        deadline_ = next_slot_;
+    }
+    else {
+        // wake up when the images arrive, or at least every idle_period_ so
+        // that the loop is not stuck if the cameras stop.
+        Clock::time_point wake_up = Clock::now() + idle_period_;
+        Clock::time_point now = Clock::now();
+        while(now < wake_up && !wait_for_event(wake_up - now))
+            now = Clock::now();
+
+        frame_start_ = Clock::now();
+        deadline_ = frame_start_ + frame_budget_;
+    }
+}
+
+//------------------------------------------------------------------------------
+void FrameScheduler::EndFrame(const bool rendered) {
+
+    Clock::time_point now = Clock::now();
+    statistics_.frames++;
+    statistics_.last_frame_time =
+            std::chrono::duration<double>(now - frame_start_).count();
+
+    if(now > deadline_)
+        statistics_.missed_deadlines++;
+    if(!rendered)
+        statistics_.skipped_frames++;
+}
@@ -0,0 +1,91 @@
+//
+// Decides when the render loop starts a new frame.
+//
+
+#ifndef ATAR_FRAMESCHEDULER_H
+#define ATAR_FRAMESCHEDULER_H
+
+#include <chrono>
+#include <functional>
+#include <cstdint>
+
+/**
+ * \class FrameScheduler
+ * \brief Paces the render loop and keeps track of the frame deadlines.
+ *
+ * In ON_NEW_IMAGES mode (AR) a frame starts as soon as a new stereo pair is
+ * available, so no time is spent sleeping on top of the camera latency. The
+ * deadline of the frame is its start plus the frame budget.
+ *
+ * In TARGET_RATE mode (VR, or AR with the old fixed rate) the frames start
+ * on a fixed grid of 1/rate. The deadline of a frame is the start of the
+ * next slot. If a frame overruns by more than a whole slot the missed slots
+ * are skipped instead of rendering several frames back to back to catch up.
+ *
+ * The render loop can ask DeadlinePassed() in the middle of a frame to skip
+ * the work that would only produce an outdated frame.
+ */
+class FrameScheduler {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    enum Mode { ON_NEW_IMAGES, TARGET_RATE };
+
+    struct Statistics {
+        uint64_t frames             = 0;
+        // frames that ended after their deadline
+        uint64_t missed_deadlines   = 0;
+        // slots of the TARGET_RATE grid that were skipped after an overrun
+        uint64_t skipped_slots      = 0;
+        // frames whose rendering was skipped by the render loop
+        uint64_t skipped_frames     = 0;
+        // duration of the last frame [s]
+        double last_frame_time      = 0.0;
+    };
+
+    // rate: frame rate of the TARGET_RATE mode [Hz]
+    // frame_budget: time allowed for a frame in ON_NEW_IMAGES mode [s]
+    FrameScheduler(const Mode mode, const double rate,
+                   const double frame_budget);
+
+    // Blocks until the next frame must start. In ON_NEW_IMAGES mode
+    // wait_for_event is called with the maximum time to wait and must return
+    // true when the new images are there (or the loop must stop). The wait
+    // is never longer than idle_period so that control events are still
+    // handled when no images arrive.
+    void WaitForNextFrame(
+            const std::function<bool(Clock::duration)> &wait_for_event);
+
+    // True if the current frame is already late.
+    bool DeadlinePassed() const { return Clock::now() > deadline_; }
+
+    // Must be called at the end of each frame. rendered is false if the
+    // frame skipped its rendering.
+    void EndFrame(const bool rendered);
+
+    Mode GetMode() const { return mode_; }
+
+    // Time allowed for a frame: the frame budget in ON_NEW_IMAGES mode, the
+    // period in TARGET_RATE mode [s]
+    double GetFrameBudget() const {
+        return std::chrono::duration<double>(
+                mode_ == TARGET_RATE ? period_ : frame_budget_).count();
+    }
+
+    const Statistics &GetStatistics() const { return statistics_; }
+
+private:
+    Mode mode_;
+    Clock::duration period_;
+    Clock::duration frame_budget_;
+    Clock::duration idle_period_;
+
+    Clock::time_point frame_start_;
+    Clock::time_point deadline_;
+    // start of the next slot in TARGET_RATE mode
+    Clock::time_point next_slot_;
+
+    Statistics statistics_;
+};
+
+#endif //ATAR_FRAMESCHEDULER_H
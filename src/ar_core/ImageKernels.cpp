@@ -0,0 +1,344 @@
+//
+// Pixel operations on the images going in and out of the renderer.
+//
+
+#include "ImageKernels.h"
+#include <algorithm>
+#include <stdexcept>
+#include "opencv2/imgproc/imgproc.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ATAR_IMAGEKERNELS_SSSE3
+#include <tmmintrin.h>
+#endif
+
+namespace {
+
+//------------------------------------------------------------------------------
+void SwapRedBlueRowScalar(const uchar *src, uchar *dst, const int num_pixels) {
+
+    for (int i = 0; i < num_pixels; ++i, src += 3, dst += 3) {
+        const uchar first = src[0];
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = first;
+    }
+}
+
+//------------------------------------------------------------------------------
+void GrayToBGRRowScalar(const uchar *src, uchar *dst, const int num_pixels) {
+
+    for (int i = 0; i < num_pixels; ++i, dst += 3)
+        dst[0] = dst[1] = dst[2] = src[i];
+}
+
+//------------------------------------------------------------------------------
+// x / 255 rounded, exact for x in [0, 255 * 255]
+inline int DivideBy255(const int x) {
+    return (x + 128 + ((x + 128) >> 8)) >> 8;
+}
+
+//------------------------------------------------------------------------------
+void AlphaBlendRowScalar(const uchar *layer, uchar *dst, const int num_pixels) {
+
+    for (int i = 0; i < num_pixels; ++i, layer += 4, dst += 3) {
+        const int transparency = 255 - layer[3];
+        if(transparency == 255)
+            continue;
+        for (int c = 0; c < 3; ++c)
+            dst[c] = (uchar)std::min(
+                    255, layer[c] + DivideBy255(dst[c] * transparency));
+    }
+}
+
+#ifdef ATAR_IMAGEKERNELS_SSSE3
+//------------------------------------------------------------------------------
+// Compiled for SSSE3 whatever the flags of the build, and only called if the
+// cpu supports it.
+__attribute__((target("ssse3")))
+void SwapRedBlueRowSSSE3(const uchar *src, uchar *dst, const int num_pixels) {
+
+    // 5 pixels per 16 byte register. The last byte is copied as it is and
+    // overwritten by the next iteration or by the scalar tail.
+    const __m128i swap = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6,
+                                       11, 10, 9, 14, 13, 12, 15);
+    const int num_bytes = num_pixels * 3;
+    int x = 0;
+    for (; x + 16 <= num_bytes; x += 15) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *)(src + x));
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_shuffle_epi8(pixels, swap));
+    }
+    SwapRedBlueRowScalar(src + x, dst + x, (num_bytes - x) / 3);
+}
+
+//------------------------------------------------------------------------------
+__attribute__((target("ssse3")))
+void GrayToBGRRowSSSE3(const uchar *src, uchar *dst, const int num_pixels) {
+
+    // 16 gray pixels make three registers of bgr pixels
+    const __m128i spread[3] = {
+            _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5),
+            _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10),
+            _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14,
+                          15, 15, 15)};
+    int x = 0;
+    for (; x + 16 <= num_pixels; x += 16) {
+        __m128i gray = _mm_loadu_si128((const __m128i *)(src + x));
+        for (int i = 0; i < 3; ++i)
+            _mm_storeu_si128((__m128i *)(dst + x * 3 + i * 16),
+                             _mm_shuffle_epi8(gray, spread[i]));
+    }
+    GrayToBGRRowScalar(src + x, dst + x * 3, num_pixels - x);
+}
+
+//------------------------------------------------------------------------------
+__attribute__((target("ssse3")))
+void AlphaBlendRowSSSE3(const uchar *layer, uchar *dst, const int num_pixels) {
+
+    // 4 pixels per iteration: 16 bytes of the layer and 12 of dst, loaded
+    // as 16 bytes whose last 4 are stored back unchanged
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi8((char)255);
+    const __m128i alpha_bytes = _mm_set1_epi32((int)0xFF000000);
+    const __m128i round = _mm_set1_epi16(128);
+    const __m128i to_bgrx = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1,
+                                          6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i spread_alpha = _mm_setr_epi8(3, 3, 3, -1, 7, 7, 7, -1,
+                                               11, 11, 11, -1, 15, 15, 15, -1);
+    const __m128i to_bgr = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10,
+                                         12, 13, 14, -1, -1, -1, -1);
+    const __m128i tail = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                       -1, -1, -1, -1);
+    int x = 0;
+    for (; x + 6 <= num_pixels; x += 4) {
+        const __m128i src = _mm_loadu_si128((const __m128i *)(layer + x * 4));
+        if(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(src, alpha_bytes),
+                                             zero)) == 0xFFFF)
+            continue;
+
+        __m128i *out = (__m128i *)(dst + x * 3);
+        const __m128i bgr = _mm_loadu_si128(out);
+        const __m128i pixels = _mm_shuffle_epi8(bgr, to_bgrx);
+        const __m128i transparency = _mm_sub_epi8(
+                opaque, _mm_shuffle_epi8(src, spread_alpha));
+
+        // dst * transparency / 255 in 16 bits
+        __m128i low = _mm_add_epi16(
+                _mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero),
+                                _mm_unpacklo_epi8(transparency, zero)), round);
+        __m128i high = _mm_add_epi16(
+                _mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero),
+                                _mm_unpackhi_epi8(transparency, zero)), round);
+        low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+        high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+        const __m128i blended = _mm_adds_epu8(_mm_packus_epi16(low, high), src);
+        _mm_storeu_si128(out, _mm_or_si128(_mm_shuffle_epi8(blended, to_bgr),
+                                           _mm_and_si128(bgr, tail)));
+    }
+    AlphaBlendRowScalar(layer + x * 4, dst + x * 3, num_pixels - x);
+}
+
+//------------------------------------------------------------------------------
+bool HasSSSE3() {
+    static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+    return has_ssse3;
+}
+#endif
+
+//------------------------------------------------------------------------------
+void GrayToBGRRow(const uchar *src, uchar *dst, const int num_pixels) {
+#ifdef ATAR_IMAGEKERNELS_SSSE3
+    if(HasSSSE3()) {
+        GrayToBGRRowSSSE3(src, dst, num_pixels);
+        return;
+    }
+#endif
+    GrayToBGRRowScalar(src, dst, num_pixels);
+}
+
+//------------------------------------------------------------------------------
+// BT.601 with video range, the coefficients OpenCV uses for its YUV to RGB
+// conversions (20 bit fixed point)
+const int kYuvShift = 20;
+const int kYuvRound = 1 << (kYuvShift - 1);
+const int kYuvCY = 1220542;
+const int kYuvCUB = 2116026;
+const int kYuvCUG = -409993;
+const int kYuvCVG = -852492;
+const int kYuvCVR = 1673527;
+
+inline void YuvToBGR(const int y, const int u, const int v, uchar *bgr) {
+    const int luma = std::max(0, y - 16) * kYuvCY;
+    bgr[0] = cv::saturate_cast<uchar>(
+            (luma + kYuvCUB * u + kYuvRound) >> kYuvShift);
+    bgr[1] = cv::saturate_cast<uchar>(
+            (luma + kYuvCUG * u + kYuvCVG * v + kYuvRound) >> kYuvShift);
+    bgr[2] = cv::saturate_cast<uchar>(
+            (luma + kYuvCVR * v + kYuvRound) >> kYuvShift);
+}
+
+//------------------------------------------------------------------------------
+// Two pixels per 4 bytes: u y0 v y1 (uyvy, the "yuv422" of ROS) or
+// y0 u y1 v (yuyv)
+template <bool UYVY>
+void YuvToBGRRow(const uchar *src, uchar *dst, const int num_pixels) {
+
+    const int y_offset = UYVY ? 1 : 0;
+    const int uv_offset = UYVY ? 0 : 1;
+    for (int x = 0; x + 1 < num_pixels; x += 2, src += 4, dst += 6) {
+        const int u = src[uv_offset] - 128;
+        const int v = src[uv_offset + 2] - 128;
+        YuvToBGR(src[y_offset], u, v, dst);
+        YuvToBGR(src[y_offset + 2], u, v, dst + 3);
+    }
+    if(num_pixels % 2)
+        YuvToBGR(src[y_offset], src[uv_offset] - 128, src[uv_offset + 2] - 128,
+                 dst);
+}
+
+//------------------------------------------------------------------------------
+// Runs the row kernel on each row of src, writing the same row of dst, or
+// the mirrored one if flip is true. The rows are split in stripes processed
+// in parallel.
+template <typename RowKernel>
+class RowsBody : public cv::ParallelLoopBody {
+public:
+    RowsBody(const cv::Mat &src, cv::Mat &dst, const bool flip,
+             RowKernel kernel)
+            : src_(src), dst_(dst), flip_(flip), kernel_(kernel) {}
+
+    void operator()(const cv::Range &rows) const {
+        const int last_row = src_.rows - 1;
+        for (int row = rows.start; row < rows.end; ++row)
+            kernel_(src_.ptr(flip_ ? last_row - row : row), dst_.ptr(row),
+                    src_.cols);
+    }
+
+private:
+    const cv::Mat &src_;
+    cv::Mat &dst_;
+    bool flip_;
+    RowKernel kernel_;
+};
+
+template <typename RowKernel>
+void ForEachRow(const cv::Mat &src, cv::Mat &dst, const bool flip,
+                RowKernel kernel) {
+    // a stripe per 32 rows keeps the threads busy without splitting the
+    // work in tiny pieces
+    cv::parallel_for_(cv::Range(0, src.rows),
+                      RowsBody<RowKernel>(src, dst, flip, kernel),
+                      std::max(1.0, src.rows / 32.0));
+}
+
+//------------------------------------------------------------------------------
+// The bayer patterns of ROS named after their first two pixels, and the
+// corresponding OpenCV codes, named after the second row.
+int BayerCode(const std::string &encoding) {
+    if(encoding == "bayer_rggb8") return cv::COLOR_BayerBG2BGR;
+    if(encoding == "bayer_bggr8") return cv::COLOR_BayerRG2BGR;
+    if(encoding == "bayer_gbrg8") return cv::COLOR_BayerGR2BGR;
+    if(encoding == "bayer_grbg8") return cv::COLOR_BayerGB2BGR;
+    return -1;
+}
+
+}
+
+//------------------------------------------------------------------------------
+void ImageKernels::SwapRedBlueRow(const uchar *src, uchar *dst,
+                                  const int num_pixels) {
+#ifdef ATAR_IMAGEKERNELS_SSSE3
+    if(HasSSSE3()) {
+        SwapRedBlueRowSSSE3(src, dst, num_pixels);
+        return;
+    }
+#endif
+    SwapRedBlueRowScalar(src, dst, num_pixels);
+}
+
+//------------------------------------------------------------------------------
+void ImageKernels::AlphaBlendRow(const uchar *layer, uchar *dst,
+                                 const int num_pixels) {
+#ifdef ATAR_IMAGEKERNELS_SSSE3
+    if(HasSSSE3()) {
+        AlphaBlendRowSSSE3(layer, dst, num_pixels);
+        return;
+    }
+#endif
+    AlphaBlendRowScalar(layer, dst, num_pixels);
+}
+
+//------------------------------------------------------------------------------
+void ImageKernels::AlphaBlendFlipped(const cv::Mat &layer, cv::Mat &dst) {
+
+    if(layer.type() != CV_8UC4 || dst.type() != CV_8UC3
+       || layer.size() != dst.size())
+        throw std::runtime_error("AlphaBlendFlipped expects an 8 bit, 4 "
+                                         "channel layer and an 8 bit, 3 "
+                                         "channel image of the same size.");
+
+    ForEachRow(layer, dst, true, ImageKernels::AlphaBlendRow);
+}
+
+//------------------------------------------------------------------------------
+void ImageKernels::FlipVerticalAndSwapRedBlue(const cv::Mat &src,
+                                              cv::Mat &dst) {
+
+    if(src.type() != CV_8UC3)
+        throw std::runtime_error("FlipVerticalAndSwapRedBlue expects 8 bit, "
+                                         "3 channel images.");
+
+    // rows are read and written in different orders, so the kernel cannot
+    // work in place
+    cv::Mat source = src.data == dst.data ? src.clone() : src;
+    dst.create(source.rows, source.cols, CV_8UC3);
+
+    ForEachRow(source, dst, true, ImageKernels::SwapRedBlueRow);
+}
+
+//------------------------------------------------------------------------------
+bool ImageKernels::CanDecodeToBGR(const std::string &encoding) {
+    return encoding == "bgr8" || encoding == "rgb8" || encoding == "mono8"
+           || encoding == "yuv422" || encoding == "yuv422_yuy2"
+           || BayerCode(encoding) >= 0;
+}
+
+//------------------------------------------------------------------------------
+bool ImageKernels::DecodeToBGR(const cv::Mat &raw, const std::string &encoding,
+                               cv::Mat &bgr) {
+
+    if(encoding == "bgr8") {
+        bgr = raw;
+        return true;
+    }
+
+    // the output must not alias the input
+    if(bgr.data == raw.data)
+        bgr.release();
+
+    if(encoding == "rgb8" && raw.type() == CV_8UC3) {
+        bgr.create(raw.rows, raw.cols, CV_8UC3);
+        ForEachRow(raw, bgr, false, ImageKernels::SwapRedBlueRow);
+    }
+    else if(encoding == "mono8" && raw.type() == CV_8UC1) {
+        bgr.create(raw.rows, raw.cols, CV_8UC3);
+        ForEachRow(raw, bgr, false, GrayToBGRRow);
+    }
+    else if(encoding == "yuv422" && raw.type() == CV_8UC2) {
+        bgr.create(raw.rows, raw.cols, CV_8UC3);
+        ForEachRow(raw, bgr, false, YuvToBGRRow<true>);
+    }
+    else if(encoding == "yuv422_yuy2" && raw.type() == CV_8UC2) {
+        bgr.create(raw.rows, raw.cols, CV_8UC3);
+        ForEachRow(raw, bgr, false, YuvToBGRRow<false>);
+    }
+    else if(BayerCode(encoding) >= 0 && raw.type() == CV_8UC1)
+        // demosaicing needs the neighbouring rows, OpenCV's implementation
+        // already runs in parallel with SIMD
+        cv::cvtColor(raw, bgr, BayerCode(encoding));
+    else
+        return false;
+
+    return true;
+}
@@ -0,0 +1,48 @@
+//
+// Pixel operations on the images going in and out of the renderer.
+//
+
+#ifndef ATAR_IMAGEKERNELS_H
+#define ATAR_IMAGEKERNELS_H
+
+#include <string>
+#include "opencv2/core/core.hpp"
+
+namespace ImageKernels{
+
+    // Turns the rgb image read back from OpenGL (bottom row first) into a
+    // bgr image for OpenCV (top row first) in a single pass: row i of dst is
+    // row rows-1-i of src with the first and third channels swapped. The
+    // rows are processed in parallel, with SSSE3 shuffles when the cpu has
+    // them. dst is reallocated only if its size or type differ from src.
+    void FlipVerticalAndSwapRedBlue(const cv::Mat &src, cv::Mat &dst);
+
+    // Swaps the first and third channel of num_pixels 3 channel pixels.
+    // src and dst must not overlap.
+    void SwapRedBlueRow(const uchar *src, uchar *dst, const int num_pixels);
+
+    // Draws a layer read back from OpenGL (bgra, bottom row first, colors
+    // premultiplied by alpha) over the bgr image dst of the same size, which
+    // may be a region of a larger image: dst = layer + (1 - alpha) dst, as
+    // the GPU blends it. The rows are processed in parallel, with SSSE3 when
+    // the cpu has it, and runs of 4 transparent pixels are skipped.
+    void AlphaBlendFlipped(const cv::Mat &layer, cv::Mat &dst);
+
+    // One row of AlphaBlendFlipped, without the flip
+    void AlphaBlendRow(const uchar *layer, uchar *dst, const int num_pixels);
+
+    // Decodes a camera image in the layout the background renderer takes:
+    // bgr8, top row first. raw wraps the data of the message with the type
+    // matching its encoding, as cv_bridge::toCvShare gives it. bgr8 is
+    // shared without copy, rgb8, mono8, yuv422 (uyvy) and yuv422_yuy2 are
+    // converted in one parallel pass and the bayer_*8 patterns are
+    // demosaiced by OpenCV. bgr is reallocated only if needed. Returns false
+    // if the encoding or the type of raw is not supported.
+    bool DecodeToBGR(const cv::Mat &raw, const std::string &encoding,
+                     cv::Mat &bgr);
+
+    bool CanDecodeToBGR(const std::string &encoding);
+
+}
+
+#endif //ATAR_IMAGEKERNELS_H
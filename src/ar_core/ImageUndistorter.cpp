@@ -0,0 +1,63 @@
+//
+// Removes the lens distortion from the camera images shown in the background.
+//
+
+#include "ImageUndistorter.h"
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include "opencv2/imgproc/imgproc.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+//------------------------------------------------------------------------------
+ImageUndistorter::ImageUndistorter(const cv::Mat &camera_matrix,
+                                   const cv::Mat &distortion,
+                                   const double scale)
+        : camera_matrix_(camera_matrix.clone()),
+          distortion_(distortion.clone()),
+          scale_(scale),
+          last_time_(0.0)
+{
+    if(camera_matrix_.empty())
+        throw std::runtime_error("ImageUndistorter needs a camera matrix.");
+    if(scale_ <= 0.0 || scale_ > 1.0)
+        throw std::runtime_error("The undistortion scale must be in (0, 1].");
+}
+
+//------------------------------------------------------------------------------
+const cv::Mat &ImageUndistorter::Undistort(const cv::Mat &image) {
+
+    Clock::time_point start = Clock::now();
+
+    if(image.size() != input_size_)
+        ComputeMaps(image.size());
+
+    cv::remap(image, undistorted_, map_coordinates_, map_interpolation_,
+              cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+
+    last_time_ = std::chrono::duration<double>(Clock::now() - start).count();
+    return undistorted_;
+}
+
+//------------------------------------------------------------------------------
+void ImageUndistorter::ComputeMaps(const cv::Size &input_size) {
+
+    input_size_ = input_size;
+    cv::Size output_size((int)std::lround(input_size.width * scale_),
+                         (int)std::lround(input_size.height * scale_));
+
+    // the same projection on a coarser grid of pixels
+    cv::Mat output_camera_matrix;
+    camera_matrix_.convertTo(output_camera_matrix, CV_64F);
+    output_camera_matrix.at<double>(0, 0) *= scale_;
+    output_camera_matrix.at<double>(1, 1) *= scale_;
+    output_camera_matrix.at<double>(0, 2) =
+            (output_camera_matrix.at<double>(0, 2) + 0.5) * scale_ - 0.5;
+    output_camera_matrix.at<double>(1, 2) =
+            (output_camera_matrix.at<double>(1, 2) + 0.5) * scale_ - 0.5;
+
+    cv::initUndistortRectifyMap(camera_matrix_, distortion_, cv::Mat(),
+                                output_camera_matrix, output_size, CV_16SC2,
+                                map_coordinates_, map_interpolation_);
+}
@@ -0,0 +1,56 @@
+//
+// Removes the lens distortion from the camera images shown in the background.
+//
+
+#ifndef ATAR_IMAGEUNDISTORTER_H
+#define ATAR_IMAGEUNDISTORTER_H
+
+#include "opencv2/core/core.hpp"
+
+/**
+ * \class ImageUndistorter
+ * \brief Undistorts the images of one camera with remap maps computed once
+ * per resolution.
+ *
+ * The virtual scene is a pinhole projection with the camera matrix, so the
+ * background must be undistorted for the overlay to stay registered at the
+ * edges of the image. The maps are built with initUndistortRectifyMap for
+ * the same camera matrix and converted to the fixed point format, the fast
+ * path of cv::remap, which splits the image across threads.
+ *
+ * With a scale below 1 the output is smaller than the input (and the
+ * camera matrix is scaled with it), which costs less both in the remap and
+ * in the upload to the texture. The background renderer stretches it to
+ * the window anyway.
+ */
+class ImageUndistorter {
+public:
+
+    // camera_matrix must correspond to the resolution of the images.
+    // scale: size of the output relative to the input, in (0, 1].
+    ImageUndistorter(const cv::Mat &camera_matrix, const cv::Mat &distortion,
+                     const double scale = 1.0);
+
+    // Returns the undistorted image, valid until the next call.
+    const cv::Mat &Undistort(const cv::Mat &image);
+
+    // Duration of the last Undistort() [s]
+    double GetLastTime() const { return last_time_; }
+
+private:
+    void ComputeMaps(const cv::Size &input_size);
+
+    cv::Mat camera_matrix_;
+    cv::Mat distortion_;
+    double scale_;
+
+    cv::Size input_size_;
+    // fixed point maps: integer coordinates and interpolation table indices
+    cv::Mat map_coordinates_;
+    cv::Mat map_interpolation_;
+
+    cv::Mat undistorted_;
+    double last_time_;
+};
+
+#endif //ATAR_IMAGEUNDISTORTER_H
@@ -0,0 +1,288 @@
+//
+// Follows the source time stamps of each frame through the AR pipeline.
+//
+
+#include "LatencyTracer.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+namespace {
+
+// rows of the chrome trace
+enum { ROW_RENDER_LOOP = 0, ROW_CAMERA, ROW_POSE, ROW_INGEST_LEFT,
+    ROW_INGEST_RIGHT, ROW_PUBLISHER };
+
+const char *kRowNames[] = {"render loop", "camera to overlay",
+                           "pose to overlay", "ingest left",
+                           "ingest right", "publisher"};
+}
+
+const int LatencyHistogram::kBinsPerMs;
+const int LatencyHistogram::kNumBins;
+
+//------------------------------------------------------------------------------
+LatencyHistogram::LatencyHistogram()
+        : bins_(kNumBins + 1, 0), count_(0), sum_(0.0), max_(0.0)
+{
+}
+
+//------------------------------------------------------------------------------
+void LatencyHistogram::Add(const double latency) {
+
+    double latency_ms = std::max(latency, 0.0) * 1000.0;
+    int bin = std::min((int)(latency_ms * kBinsPerMs), kNumBins);
+    bins_[bin]++;
+
+    count_++;
+    sum_ += latency;
+    max_ = std::max(max_, latency);
+}
+
+//------------------------------------------------------------------------------
+void LatencyHistogram::Reset() {
+    std::fill(bins_.begin(), bins_.end(), 0);
+    count_ = 0;
+    sum_ = 0.0;
+    max_ = 0.0;
+}
+
+//------------------------------------------------------------------------------
+double LatencyHistogram::GetMean() const {
+    return count_ ? sum_ / count_ : 0.0;
+}
+
+//------------------------------------------------------------------------------
+double LatencyHistogram::GetPercentile(const double p) const {
+
+    if(count_ == 0)
+        return 0.0;
+
+    uint64_t rank = (uint64_t)(p * (count_ - 1)) + 1;
+    uint64_t accumulated = 0;
+    for (int i = 0; i < kNumBins; ++i) {
+        accumulated += bins_[i];
+        if(accumulated >= rank)
+            return std::min((i + 1) / (1000.0 * kBinsPerMs), max_);
+    }
+    // in the overflow bin
+    return max_;
+}
+
+//------------------------------------------------------------------------------
+std::string LatencyHistogram::ToString(const int group_ms) const {
+
+    std::stringstream out;
+    const int bins_per_group = std::max(group_ms, 1) * kBinsPerMs;
+
+    for (int first = 0; first < kNumBins; first += bins_per_group) {
+        uint64_t sum = 0;
+        for (int i = first; i < std::min(first + bins_per_group, kNumBins);
+             ++i)
+            sum += bins_[i];
+        if(sum)
+            out << first / kBinsPerMs << "-"
+                << (first + bins_per_group) / kBinsPerMs << ":" << sum << " ";
+    }
+    if(bins_[kNumBins])
+        out << ">" << kNumBins / kBinsPerMs << ":" << bins_[kNumBins];
+
+    std::string result = out.str();
+    if(!result.empty() && result.back() == ' ')
+        result.pop_back();
+    return result;
+}
+
+//------------------------------------------------------------------------------
+LatencyTracer::LatencyTracer(const size_t max_trace_events)
+        : max_trace_events_(max_trace_events),
+          histograms_(NUM_STAGES),
+          session_histograms_(NUM_STAGES),
+          frame_number_(0)
+{
+}
+
+//------------------------------------------------------------------------------
+const char *LatencyTracer::GetStageName(const Stage stage) {
+    switch(stage) {
+        case INGEST:            return "ingest";
+        case STEP_WORLD:        return "step_world";
+        case RENDER:            return "render";
+        case READBACK:          return "get_rendered_image";
+        case PUBLISH:           return "publish";
+        case CAMERA_TO_OVERLAY: return "camera_to_overlay";
+        case POSE_TO_OVERLAY:   return "pose_to_overlay";
+        default:                return "unknown";
+    }
+}
+
+//------------------------------------------------------------------------------
+void LatencyTracer::RecordIngest(const int cam_id,
+                                 const ros::Time &image_stamp) {
+
+    ros::Time now = ros::Time::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    AddLatency(INGEST, (now - image_stamp).toSec());
+    AddSpan(INGEST, ROW_INGEST_LEFT + cam_id, image_stamp, now,
+            frame_number_);
+}
+
+//------------------------------------------------------------------------------
+void LatencyTracer::BeginFrame(const ros::Time &image_stamp,
+                               const ros::Time &pose_stamp) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    frame_number_++;
+    frame_image_stamp_ = image_stamp;
+    frame_pose_stamp_ = pose_stamp;
+}
+
+//------------------------------------------------------------------------------
+void LatencyTracer::BeginStage(const Stage stage) {
+    stage_start_[stage] = ros::Time::now();
+}
+
+//------------------------------------------------------------------------------
+void LatencyTracer::EndStage(const Stage stage) {
+
+    ros::Time now = ros::Time::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    AddLatency(stage, (now - stage_start_[stage]).toSec());
+    AddSpan(stage, ROW_RENDER_LOOP, stage_start_[stage], now, frame_number_);
+}
+
+//------------------------------------------------------------------------------
+void LatencyTracer::EndFrame(const bool displayed) {
+
+    if(!displayed)
+        return;
+
+    ros::Time now = ros::Time::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    FrameSources sources;
+    sources.frame = frame_number_;
+    sources.image_stamp = frame_image_stamp_;
+    sources.pose_stamp = frame_pose_stamp_;
+    AddEndToEnd(sources, now);
+}
+
+//------------------------------------------------------------------------------
+LatencyTracer::FrameSources LatencyTracer::GetFrameSources() {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    FrameSources sources;
+    sources.frame = frame_number_;
+    sources.image_stamp = frame_image_stamp_;
+    sources.pose_stamp = frame_pose_stamp_;
+    return sources;
+}
+
+//------------------------------------------------------------------------------
+void LatencyTracer::RecordPublish(const FrameSources &sources,
+                                  const ros::Time &push_time) {
+
+    ros::Time now = ros::Time::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    AddLatency(PUBLISH, (now - push_time).toSec());
+    AddSpan(PUBLISH, ROW_PUBLISHER, push_time, now, sources.frame);
+    AddEndToEnd(sources, now);
+}
+
+//------------------------------------------------------------------------------
+std::vector<LatencyHistogram> LatencyTracer::TakeHistograms() {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<LatencyHistogram> taken = histograms_;
+    for (LatencyHistogram &histogram : histograms_)
+        histogram.Reset();
+    return taken;
+}
+
+//------------------------------------------------------------------------------
+bool LatencyTracer::WriteChromeTrace(const std::string &file_path) {
+
+    // copy so that the render loop is not blocked by the file writing
+    std::deque<TraceEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        events = trace_events_;
+    }
+
+    std::ofstream file(file_path.c_str());
+    if(!file.is_open())
+        return false;
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    // name the rows
+    const int num_rows = sizeof(kRowNames) / sizeof(kRowNames[0]);
+    for (int row = 0; row < num_rows; ++row)
+        file << (row ? ",\n" : "")
+             << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+             << row << ",\"args\":{\"name\":\"" << kRowNames[row] << "\"}}";
+
+    file.precision(3);
+    file << std::fixed;
+    for (size_t i = 0; i < events.size(); ++i) {
+        const TraceEvent &event = events[i];
+        // chrome traces are in microseconds
+        double start_us = event.start.toNSec() / 1000.0;
+        double duration_us = (event.end - event.start).toNSec() / 1000.0;
+
+        file << ",\n{\"name\":\"" << GetStageName(event.stage)
+             << "\",\"cat\":\"latency\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+             << event.row << ",\"ts\":" << start_us
+             << ",\"dur\":" << duration_us
+             << ",\"args\":{\"frame\":" << event.frame << "}}";
+    }
+    file << "\n]}\n";
+
+    return file.good();
+}
+
+//------------------------------------------------------------------------------
+std::vector<LatencyHistogram> LatencyTracer::GetSessionHistograms() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return session_histograms_;
+}
+
+//------------------------------------------------------------------------------
+void LatencyTracer::AddLatency(const Stage stage, const double latency) {
+    histograms_[stage].Add(latency);
+    session_histograms_[stage].Add(latency);
+}
+
+//------------------------------------------------------------------------------
+void LatencyTracer::AddSpan(const Stage stage, const int row,
+                            const ros::Time &start, const ros::Time &end,
+                            const uint64_t frame) {
+
+    if(max_trace_events_ == 0)
+        return;
+
+    TraceEvent event;
+    event.stage = stage;
+    event.frame = frame;
+    event.row = row;
+    event.start = start;
+    event.end = end;
+    trace_events_.push_back(event);
+
+    if(trace_events_.size() > max_trace_events_)
+        trace_events_.pop_front();
+}
+
+//------------------------------------------------------------------------------
+void LatencyTracer::AddEndToEnd(const FrameSources &sources,
+                                const ros::Time &now) {
+
+    if(!sources.image_stamp.isZero()) {
+        AddLatency(CAMERA_TO_OVERLAY, (now - sources.image_stamp).toSec());
+        AddSpan(CAMERA_TO_OVERLAY, ROW_CAMERA, sources.image_stamp, now,
+                sources.frame);
+    }
+    if(!sources.pose_stamp.isZero()) {
+        AddLatency(POSE_TO_OVERLAY, (now - sources.pose_stamp).toSec());
+        AddSpan(POSE_TO_OVERLAY, ROW_POSE, sources.pose_stamp, now,
+                sources.frame);
+    }
+}
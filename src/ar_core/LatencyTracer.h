@@ -0,0 +1,172 @@
+//
+// Follows the source time stamps of each frame through the AR pipeline.
+//
+
+#ifndef ATAR_LATENCYTRACER_H
+#define ATAR_LATENCYTRACER_H
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <ros/time.h>
+
+/**
+ * \class LatencyHistogram
+ * \brief Histogram of latencies with 0.5 ms bins up to 250 ms. Anything
+ * above goes in an overflow bin.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    // latency in seconds
+    void Add(const double latency);
+
+    void Reset();
+
+    uint64_t GetCount() const { return count_; }
+
+    // in seconds
+    double GetMean() const;
+    double GetMax() const { return max_; }
+
+    // p in [0, 1]. Upper edge of the bin containing the p-th sample, at
+    // most the maximum [s].
+    double GetPercentile(const double p) const;
+
+    // Non empty bins grouped by group_ms, e.g. "0-5:112 5-10:31 >250:1"
+    std::string ToString(const int group_ms = 5) const;
+
+private:
+    static const int kBinsPerMs = 2;
+    static const int kNumBins = 250 * kBinsPerMs;
+
+    // the last one is the overflow bin
+    std::vector<uint64_t> bins_;
+    uint64_t count_;
+    double sum_;
+    double max_;
+};
+
+/**
+ * \class LatencyTracer
+ * \brief Measures how long it takes for a camera image or a tool pose to
+ * show up in the rendered overlay.
+ *
+ * Every rendered frame carries the header stamp of the camera images it
+ * uses and the stamp of the tool pose that StepWorld read. The render loop
+ * marks the begin and end of its stages (StepWorld, Render,
+ * GetRenderedImage). The end-to-end latencies from the two source stamps
+ * are computed when the frame is shown: at the end of the frame when the
+ * render window shows it, or by the publisher thread once it showed and
+ * published the images read back, which also records the publish stage.
+ * The image callbacks report the ingest latency, i.e. the time from the
+ * camera stamp to the arrival of the image in ar_core.
+ *
+ * All the times are ros::Time, so that they can be compared with the stamps
+ * of the messages. Each stage feeds a histogram that is taken (and reset)
+ * with TakeHistograms(). The last max_trace_events spans are kept in memory
+ * and can be written as a Chrome trace (chrome://tracing or Perfetto).
+ *
+ * RecordIngest may be called from the callback threads and RecordPublish
+ * from the publisher thread, the frame methods must be called from the
+ * render loop only.
+ */
+class LatencyTracer {
+public:
+
+    enum Stage {
+        INGEST = 0,
+        STEP_WORLD,
+        RENDER,
+        READBACK,
+        // from the hand over to the publisher to the end of the publication
+        PUBLISH,
+        // end to end, from the source stamps to the display of the frame
+        CAMERA_TO_OVERLAY,
+        POSE_TO_OVERLAY,
+        NUM_STAGES
+    };
+
+    // The sources of a frame, kept by the frames that are shown later
+    struct FrameSources {
+        uint64_t frame = 0;
+        ros::Time image_stamp;
+        ros::Time pose_stamp;
+    };
+
+    explicit LatencyTracer(const size_t max_trace_events = 100000);
+
+    static const char *GetStageName(const Stage stage);
+
+    // Called when an image of camera cam_id arrives
+    void RecordIngest(const int cam_id, const ros::Time &image_stamp);
+
+    // image_stamp: header stamp of the images used by this frame
+    // pose_stamp: stamp of the tool pose used by this frame. Zero if there
+    // is no pose.
+    void BeginFrame(const ros::Time &image_stamp, const ros::Time &pose_stamp);
+
+    void BeginStage(const Stage stage);
+
+    void EndStage(const Stage stage);
+
+    // displayed is false when the frame was not rendered, or is shown later
+    // by the publisher. Its end-to-end latency is then not recorded here.
+    void EndFrame(const bool displayed);
+
+    // Sources of the current frame, for RecordPublish
+    FrameSources GetFrameSources();
+
+    // Called when a frame handed over to the publisher at push_time has
+    // been shown and published. Records the publish stage and the
+    // end-to-end latencies of the frame.
+    void RecordPublish(const FrameSources &sources,
+                       const ros::Time &push_time);
+
+    // Returns the histograms of all stages since the last call and resets
+    // them.
+    std::vector<LatencyHistogram> TakeHistograms();
+
+    // Returns the histograms of all stages since the start, e.g. for the
+    // report at the end of a replay.
+    std::vector<LatencyHistogram> GetSessionHistograms();
+
+    // Writes the spans kept in memory as Chrome trace event JSON. Returns
+    // false if the file could not be written.
+    bool WriteChromeTrace(const std::string &file_path);
+
+private:
+
+    struct TraceEvent {
+        Stage stage;
+        uint64_t frame;
+        // thread row of the trace
+        int row;
+        ros::Time start;
+        ros::Time end;
+    };
+
+    void AddLatency(const Stage stage, const double latency);
+
+    void AddSpan(const Stage stage, const int row, const ros::Time &start,
+                 const ros::Time &end, const uint64_t frame);
+
+    // end-to-end latencies of a frame shown at time now
+    void AddEndToEnd(const FrameSources &sources, const ros::Time &now);
+
+    std::mutex mutex_;
+    size_t max_trace_events_;
+    std::deque<TraceEvent> trace_events_;
+    std::vector<LatencyHistogram> histograms_;
+    std::vector<LatencyHistogram> session_histograms_;
+
+    uint64_t frame_number_;
+    ros::Time frame_image_stamp_;
+    ros::Time frame_pose_stamp_;
+    ros::Time stage_start_[NUM_STAGES];
+};
+
+#endif //ATAR_LATENCYTRACER_H
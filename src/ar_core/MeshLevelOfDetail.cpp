@@ -0,0 +1,85 @@
+//
+// Coarser versions of the large meshes of the scene.
+//
+
+#include "MeshLevelOfDetail.h"
+#include <algorithm>
+#include <vtkAlgorithm.h>
+#include <vtkDataSet.h>
+#include <vtkTrivialProducer.h>
+
+//------------------------------------------------------------------------------
+MeshLevelOfDetail::MeshLevelOfDetail(const vtkIdType min_cells)
+        : min_cells_(min_cells), level_(0)
+{
+}
+
+//------------------------------------------------------------------------------
+void MeshLevelOfDetail::AddActor(vtkActor *actor) {
+
+    if(!actor || !actor->GetMapper())
+        return;
+    vtkMapper *mapper = actor->GetMapper();
+    if(mapper->GetNumberOfInputConnections(0) != 1)
+        return;
+    vtkAlgorithmOutput *input = mapper->GetInputConnection(0, 0);
+    // data set with SetInputData
+    if(!input || vtkTrivialProducer::SafeDownCast(input->GetProducer()))
+        return;
+    // the same actor in several renderers
+    for (size_t k = 0; k < meshes_.size(); ++k)
+        if(meshes_[k].mapper == mapper)
+            return;
+
+    SimplifiedMesh mesh;
+    mesh.mapper = mapper;
+    mesh.input = input;
+    meshes_.push_back(mesh);
+    if(level_ > 0)
+        Apply(meshes_.back());
+}
+
+//------------------------------------------------------------------------------
+void MeshLevelOfDetail::RemoveAllActors() {
+    const int level = level_;
+    SetLevel(0);
+    level_ = level;
+    meshes_.clear();
+}
+
+//------------------------------------------------------------------------------
+void MeshLevelOfDetail::SetLevel(const int level) {
+
+    const int new_level = std::min(2, std::max(0, level));
+    if(new_level == level_)
+        return;
+    level_ = new_level;
+    for (size_t k = 0; k < meshes_.size(); ++k)
+        Apply(meshes_[k]);
+}
+
+//------------------------------------------------------------------------------
+void MeshLevelOfDetail::Apply(SimplifiedMesh &mesh) const {
+
+    if(level_ == 0) {
+        mesh.mapper->SetInputConnection(mesh.input);
+        return;
+    }
+
+    if(!mesh.clustering) {
+        // the size of the mesh is only known once its pipeline ran
+        vtkAlgorithm *producer = mesh.input->GetProducer();
+        producer->Update(mesh.input->GetIndex());
+        vtkDataSet *data = vtkDataSet::SafeDownCast(
+                producer->GetOutputDataObject(mesh.input->GetIndex()));
+        if(!data || data->GetNumberOfCells() < min_cells_)
+            return;
+        mesh.clustering = vtkSmartPointer<vtkQuadricClustering>::New();
+        mesh.clustering->SetInputConnection(mesh.input);
+    }
+
+    // cells per axis over the bounds of the mesh
+    const int divisions = level_ == 1 ? 64 : 32;
+    mesh.clustering->SetNumberOfDivisions(divisions, divisions, divisions);
+    mesh.mapper->SetInputConnection(mesh.clustering->GetOutputPort());
+}
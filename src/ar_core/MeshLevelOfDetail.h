@@ -0,0 +1,59 @@
+//
+// Coarser versions of the large meshes of the scene.
+//
+
+#ifndef ATAR_MESHLEVELOFDETAIL_H
+#define ATAR_MESHLEVELOFDETAIL_H
+
+#include <vector>
+#include <vtkActor.h>
+#include <vtkAlgorithmOutput.h>
+#include <vtkMapper.h>
+#include <vtkQuadricClustering.h>
+#include <vtkSmartPointer.h>
+
+/**
+ * \class MeshLevelOfDetail
+ * \brief Switches the mappers of large static meshes between their input and
+ * a simplified version of it.
+ *
+ * The simplification is a vtkQuadricClustering of the input, which is fast
+ * enough to run when the level changes. Only the meshes produced by a
+ * pipeline (e.g. a reader) are simplified. The meshes set directly as data,
+ * like the deformable ones, change at every frame and would have to be
+ * simplified again each time. Meshes with fewer than min_cells cells are
+ * left as they are.
+ */
+class MeshLevelOfDetail {
+public:
+
+    MeshLevelOfDetail(const vtkIdType min_cells = 5000);
+
+    ~MeshLevelOfDetail() { RemoveAllActors(); }
+
+    // Ignores NULL and the actors whose mesh can not be simplified
+    void AddActor(vtkActor *actor);
+
+    // Gives their original input back to the mappers and forgets them
+    void RemoveAllActors();
+
+    // 0: original meshes, 1: fine clustering, 2: coarse clustering
+    void SetLevel(const int level);
+
+    int GetLevel() const { return level_; }
+
+private:
+    struct SimplifiedMesh {
+        vtkSmartPointer<vtkMapper> mapper;
+        vtkSmartPointer<vtkAlgorithmOutput> input;
+        vtkSmartPointer<vtkQuadricClustering> clustering;
+    };
+
+    void Apply(SimplifiedMesh &mesh) const;
+
+    vtkIdType min_cells_;
+    int level_;
+    std::vector<SimplifiedMesh> meshes_;
+};
+
+#endif //ATAR_MESHLEVELOFDETAIL_H
@@ -0,0 +1,66 @@
+//
+// Keeps a local copy of ROS parameters for the threads that cannot afford a
+// round trip to the parameter server.
+//
+
+#include "ParameterCache.h"
+
+//------------------------------------------------------------------------------
+ParameterCache::ParameterCache(const ros::NodeHandle &n,
+                               const double refresh_period)
+        : n_(n),
+          refresh_period_(refresh_period > 0.0 ? refresh_period : 1.0),
+          running_(false)
+{
+}
+
+//------------------------------------------------------------------------------
+ParameterCache::~ParameterCache() {
+    Stop();
+}
+
+//------------------------------------------------------------------------------
+void ParameterCache::Start() {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(running_)
+        return;
+
+    running_ = true;
+    watcher_ = std::thread(&ParameterCache::WatcherThread, this);
+}
+
+//------------------------------------------------------------------------------
+void ParameterCache::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    stop_condition_.notify_all();
+
+    if(watcher_.joinable())
+        watcher_.join();
+}
+
+//------------------------------------------------------------------------------
+void ParameterCache::WatcherThread() {
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(running_) {
+
+        // params_ does not change while running, no need to hold the lock
+        // during the refresh
+        lock.unlock();
+        for (size_t i = 0; i < params_.size(); ++i) {
+            if(params_[i]->Refresh(n_)) {
+                ROS_INFO("Parameter '%s' changed.",
+                         params_[i]->GetName().c_str());
+                params_[i]->NotifyChange();
+            }
+        }
+        lock.lock();
+
+        stop_condition_.wait_for(lock, refresh_period_,
+                                 [this] { return !running_; });
+    }
+}
@@ -0,0 +1,173 @@
+//
+// Keeps a local copy of ROS parameters for the threads that cannot afford a
+// round trip to the parameter server.
+//
+
+#ifndef ATAR_PARAMETERCACHE_H
+#define ATAR_PARAMETERCACHE_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+#include <ros/ros.h>
+
+/**
+ * \brief Base of the cached parameters, used by ParameterCache to refresh
+ * them without knowing their type.
+ */
+class CachedParamBase {
+public:
+    explicit CachedParamBase(const std::string &name)
+            : name_(name), version_(0), is_set_(false) {}
+
+    virtual ~CachedParamBase() {}
+
+    const std::string &GetName() const { return name_; }
+
+    // Incremented every time the value changes. A reader can compare it with
+    // the version it saw last to know if it needs to react to a change.
+    uint32_t GetVersion() const {
+        return version_.load(std::memory_order_acquire);
+    }
+
+    // False if the parameter was not found on the server and the default
+    // value is used.
+    bool IsSet() const { return is_set_.load(std::memory_order_acquire); }
+
+    // Reads the parameter from the node handle's cache. Returns true if the
+    // value changed. Called by the watcher thread only.
+    virtual bool Refresh(ros::NodeHandle &n) = 0;
+
+    // Called by the watcher thread after a change.
+    void SetChangeCallback(const std::function<void()> &callback) {
+        change_callback_ = callback;
+    }
+
+    void NotifyChange() const {
+        if(change_callback_)
+            change_callback_();
+    }
+
+protected:
+    std::string name_;
+    std::atomic<uint32_t> version_;
+    std::atomic<bool> is_set_;
+    std::function<void()> change_callback_;
+};
+
+/**
+ * \class CachedParam
+ * \brief The latest value of a parameter, readable from any thread without
+ * locks or system calls.
+ *
+ * Each value is an immutable object published through an atomic pointer.
+ * The old values are kept until the parameter is destroyed, so a reference
+ * returned by Get() stays valid. Parameters change rarely (a handful of
+ * times per session), so the memory this keeps is negligible.
+ */
+template <typename T>
+class CachedParam : public CachedParamBase {
+public:
+    CachedParam(ros::NodeHandle &n, const std::string &name,
+                const T &default_value)
+            : CachedParamBase(name)
+    {
+        T value;
+        bool found = n.getParam(name, value);
+        if(!found)
+            value = default_value;
+        is_set_.store(found, std::memory_order_release);
+        Publish(value);
+    }
+
+    const T &Get() const {
+        return *current_.load(std::memory_order_acquire);
+    }
+
+    bool Refresh(ros::NodeHandle &n) {
+        T value;
+        // getParamCached subscribes to the updates of the parameter on the
+        // first call and answers from the local cache afterwards.
+        if(!n.getParamCached(name_, value) || value == Get())
+            return false;
+
+        is_set_.store(true, std::memory_order_release);
+        Publish(value);
+        return true;
+    }
+
+private:
+    void Publish(const T &value) {
+        values_.push_back(std::unique_ptr<const T>(new T(value)));
+        current_.store(values_.back().get(), std::memory_order_release);
+        version_.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    std::atomic<const T *> current_;
+    // owned by the writer (constructor, then watcher thread)
+    std::vector<std::unique_ptr<const T> > values_;
+};
+
+/**
+ * \class ParameterCache
+ * \brief Reads the parameters once at startup and keeps them up to date
+ * from a background thread.
+ *
+ * Add() reads a parameter with a blocking call and returns a handle whose
+ * Get() is lock-free, so it can be used in the render loop and in the
+ * haptics threads. Parameters must be added before Start(). The watcher
+ * thread then refreshes all of them every refresh_period through
+ * getParamCached, which after the first call is served by the parameter
+ * updates the master pushes to the node. When a value changes its version
+ * is incremented and its change callback, if any, is called on the watcher
+ * thread.
+ */
+class ParameterCache {
+public:
+
+    explicit ParameterCache(const ros::NodeHandle &n,
+                            const double refresh_period = 1.0);
+
+    ~ParameterCache();
+
+    // The returned reference is valid as long as the cache.
+    template <typename T>
+    const CachedParam<T> &Add(const std::string &name, const T &default_value,
+                              const std::function<void()> &on_change =
+                              std::function<void()>()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(running_)
+            throw std::runtime_error("Parameters must be added to the cache "
+                                             "before it is started.");
+        CachedParam<T> *param = new CachedParam<T>(n_, name, default_value);
+        param->SetChangeCallback(on_change);
+        params_.push_back(std::unique_ptr<CachedParamBase>(param));
+        return *param;
+    }
+
+    // Starts the watcher thread
+    void Start();
+
+    // Stops and joins the watcher thread
+    void Stop();
+
+private:
+    void WatcherThread();
+
+    ros::NodeHandle n_;
+    std::chrono::duration<double> refresh_period_;
+
+    std::mutex mutex_;
+    std::condition_variable stop_condition_;
+    bool running_;
+    std::thread watcher_;
+
+    std::vector<std::unique_ptr<CachedParamBase> > params_;
+};
+
+#endif //ATAR_PARAMETERCACHE_H
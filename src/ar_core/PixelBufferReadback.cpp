@@ -0,0 +1,149 @@
+//
+// Asynchronous readback of a render window through pixel buffer objects.
+//
+
+#include "PixelBufferReadback.h"
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vtkgl.h>
+#include <vtkOpenGLExtensionManager.h>
+
+typedef std::chrono::steady_clock Clock;
+
+//------------------------------------------------------------------------------
+PixelBufferReadback::PixelBufferReadback(vtkRenderWindow *window,
+                                         const int num_buffers)
+        : window_(vtkOpenGLRenderWindow::SafeDownCast(window)),
+          buffers_((size_t)std::max(num_buffers, 2), 0),
+          width_(0),
+          height_(0),
+          next_(0),
+          pending_(0),
+          last_queue_time_(0.0),
+          last_retrieve_time_(0.0)
+{
+    if(!IsSupported(window))
+        throw std::runtime_error("Pixel buffer objects are not supported by "
+                                         "the OpenGL context.");
+
+    // the buffer functions are those of OpenGL 1.5, pixel buffers only add
+    // the PIXEL_PACK_BUFFER target
+    window_->GetExtensionManager()->LoadSupportedExtension("GL_VERSION_1_5");
+}
+
+//------------------------------------------------------------------------------
+PixelBufferReadback::~PixelBufferReadback() {
+    window_->MakeCurrent();
+    Release();
+}
+
+//------------------------------------------------------------------------------
+bool PixelBufferReadback::IsSupported(vtkRenderWindow *window) {
+
+    vtkOpenGLRenderWindow *gl_window =
+            vtkOpenGLRenderWindow::SafeDownCast(window);
+    if(!gl_window)
+        return false;
+
+    vtkOpenGLExtensionManager *extensions = gl_window->GetExtensionManager();
+    return extensions->ExtensionSupported("GL_VERSION_1_5")
+           && (extensions->ExtensionSupported("GL_VERSION_2_1")
+               || extensions->ExtensionSupported("GL_ARB_pixel_buffer_object"));
+}
+
+//------------------------------------------------------------------------------
+void PixelBufferReadback::Queue() {
+
+    Clock::time_point start = Clock::now();
+
+    int *size = window_->GetActualSize();
+    if(size[0] != width_ || size[1] != height_)
+        Allocate(size[0], size[1]);
+
+    // a buffer that was never retrieved is overwritten
+    if(pending_ == (int)buffers_.size())
+        pending_--;
+
+    GLint pack_alignment;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &pack_alignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadBuffer(static_cast<GLenum>(window_->GetBackLeftBuffer()));
+
+    // with a pack buffer bound the last argument is an offset in the buffer
+    // and the call returns without waiting for the pixels
+    vtkgl::BindBuffer(vtkgl::PIXEL_PACK_BUFFER, buffers_[next_]);
+    glReadPixels(0, 0, width_, height_, vtkgl::BGR, GL_UNSIGNED_BYTE, 0);
+    vtkgl::BindBuffer(vtkgl::PIXEL_PACK_BUFFER, 0);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, pack_alignment);
+
+    next_ = (next_ + 1) % (int)buffers_.size();
+    pending_++;
+
+    last_queue_time_ =
+            std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//------------------------------------------------------------------------------
+bool PixelBufferReadback::Retrieve(cv::Mat &image) {
+
+    last_retrieve_time_ = 0.0;
+    if(pending_ < (int)buffers_.size())
+        return false;
+
+    Clock::time_point start = Clock::now();
+
+    const int num_buffers = (int)buffers_.size();
+    const int oldest = (next_ - pending_ + num_buffers) % num_buffers;
+
+    vtkgl::BindBuffer(vtkgl::PIXEL_PACK_BUFFER, buffers_[oldest]);
+    const uchar *pixels = static_cast<const uchar *>(
+            vtkgl::MapBuffer(vtkgl::PIXEL_PACK_BUFFER, vtkgl::READ_ONLY));
+
+    bool retrieved = pixels != NULL;
+    if(retrieved) {
+        image.create(height_, width_, CV_8UC3);
+        // OpenGL starts from the bottom row
+        const size_t row_size = (size_t)width_ * 3;
+        for (int row = 0; row < height_; ++row)
+            std::memcpy(image.ptr(row),
+                        pixels + (size_t)(height_ - 1 - row) * row_size,
+                        row_size);
+        vtkgl::UnmapBuffer(vtkgl::PIXEL_PACK_BUFFER);
+    }
+    vtkgl::BindBuffer(vtkgl::PIXEL_PACK_BUFFER, 0);
+    pending_--;
+
+    last_retrieve_time_ =
+            std::chrono::duration<double>(Clock::now() - start).count();
+    return retrieved;
+}
+
+//------------------------------------------------------------------------------
+void PixelBufferReadback::Allocate(const int width, const int height) {
+
+    Release();
+    width_ = width;
+    height_ = height;
+
+    vtkgl::GenBuffers((GLsizei)buffers_.size(), &buffers_[0]);
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+        vtkgl::BindBuffer(vtkgl::PIXEL_PACK_BUFFER, buffers_[i]);
+        vtkgl::BufferData(vtkgl::PIXEL_PACK_BUFFER,
+                          (vtkgl::GLsizeiptr)width_ * height_ * 3, NULL,
+                          vtkgl::STREAM_READ);
+    }
+    vtkgl::BindBuffer(vtkgl::PIXEL_PACK_BUFFER, 0);
+}
+
+//------------------------------------------------------------------------------
+void PixelBufferReadback::Release() {
+
+    if(buffers_[0] != 0)
+        vtkgl::DeleteBuffers((GLsizei)buffers_.size(), &buffers_[0]);
+    std::fill(buffers_.begin(), buffers_.end(), 0);
+    next_ = 0;
+    pending_ = 0;
+}
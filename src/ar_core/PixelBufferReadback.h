@@ -0,0 +1,80 @@
+//
+// Asynchronous readback of a render window through pixel buffer objects.
+//
+
+#ifndef ATAR_PIXELBUFFERREADBACK_H
+#define ATAR_PIXELBUFFERREADBACK_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <vtkOpenGL.h>
+#include <vtkRenderWindow.h>
+#include <vtkOpenGLRenderWindow.h>
+
+/**
+ * \class PixelBufferReadback
+ * \brief Reads the back buffer of a window into a ring of pixel buffer
+ * objects so that the copy to memory does not wait for the GPU.
+ *
+ * Queue() starts a glReadPixels into the next buffer of the ring and returns
+ * immediately, the transfer is done by the driver while the next frame is
+ * prepared. Retrieve() maps the oldest buffer, so with n buffers the image
+ * returned is the one queued n-1 frames earlier: frame N-1 with two buffers,
+ * N-2 with three. The pixels are read as BGR and the rows are flipped while
+ * copying, so the result is ready for OpenCV.
+ *
+ * Requires OpenGL 1.5 and pixel buffer objects (OpenGL 2.1 or
+ * GL_ARB_pixel_buffer_object), which Mesa provides in its software
+ * renderers too. All the methods must be called with the context of the
+ * window current.
+ */
+class PixelBufferReadback {
+public:
+
+    // Throws std::runtime_error if the context of the window does not
+    // support pixel buffer objects.
+    PixelBufferReadback(vtkRenderWindow *window, const int num_buffers);
+
+    ~PixelBufferReadback();
+
+    // The window must have been rendered once so that it has a context.
+    static bool IsSupported(vtkRenderWindow *window);
+
+    // Starts reading the back buffer of the window. Must be called after
+    // the frame is rendered and before the buffers are swapped.
+    void Queue();
+
+    // Copies the oldest queued frame into image. Returns false while the
+    // ring is filling up, i.e. for the first GetDelay() frames.
+    bool Retrieve(cv::Mat &image);
+
+    // Forgets the queued frames, for example when frames are rendered
+    // without being read back.
+    void Discard() { pending_ = 0; }
+
+    // Number of frames between the one queued and the one retrieved
+    int GetDelay() const { return (int)buffers_.size() - 1; }
+
+    // Time spent in the last Queue() and Retrieve() [s]
+    double GetLastReadbackTime() const {
+        return last_queue_time_ + last_retrieve_time_;
+    }
+
+private:
+    void Allocate(const int width, const int height);
+
+    void Release();
+
+    vtkOpenGLRenderWindow * window_;
+    std::vector<GLuint> buffers_;
+    int width_;
+    int height_;
+    // next buffer to be written and number of frames queued and not
+    // retrieved yet
+    int next_;
+    int pending_;
+    double last_queue_time_;
+    double last_retrieve_time_;
+};
+
+#endif //ATAR_PIXELBUFFERREADBACK_H
@@ -0,0 +1,64 @@
+//
+// Lowers the rendering quality when the frames take longer than their budget.
+//
+
+#include "QualityGovernor.h"
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+QualityGovernor::QualityGovernor(const double frame_budget,
+                                 const int num_levels, const double headroom,
+                                 const int window_frames,
+                                 const int upgrade_window_frames)
+        : frame_budget_(frame_budget),
+          num_levels_(std::max(1, num_levels)),
+          headroom_(headroom),
+          window_frames_(std::max(1, window_frames)),
+          upgrade_window_frames_(std::max(window_frames_,
+                                          upgrade_window_frames)),
+          level_(0),
+          last_mean_frame_time_(0.0)
+{
+    Reset();
+}
+
+//------------------------------------------------------------------------------
+bool QualityGovernor::AddFrameTime(const double frame_time) {
+
+    num_frames_++;
+    sum_frame_times_ += frame_time;
+    num_upgrade_frames_++;
+    sum_upgrade_frame_times_ += frame_time;
+
+    if(num_frames_ == window_frames_) {
+        last_mean_frame_time_ = sum_frame_times_ / num_frames_;
+        num_frames_ = 0;
+        sum_frame_times_ = 0.0;
+        if(last_mean_frame_time_ > frame_budget_
+           && level_ < num_levels_ - 1) {
+            level_++;
+            Reset();
+            return true;
+        }
+    }
+
+    if(num_upgrade_frames_ == upgrade_window_frames_) {
+        double mean = sum_upgrade_frame_times_ / num_upgrade_frames_;
+        num_upgrade_frames_ = 0;
+        sum_upgrade_frame_times_ = 0.0;
+        if(mean < headroom_ * frame_budget_ && level_ > 0) {
+            level_--;
+            Reset();
+            return true;
+        }
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+void QualityGovernor::Reset() {
+    num_frames_ = 0;
+    sum_frame_times_ = 0.0;
+    num_upgrade_frames_ = 0;
+    sum_upgrade_frame_times_ = 0.0;
+}
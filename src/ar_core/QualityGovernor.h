@@ -0,0 +1,65 @@
+//
+// Lowers the rendering quality when the frames take longer than their budget.
+//
+
+#ifndef ATAR_QUALITYGOVERNOR_H
+#define ATAR_QUALITYGOVERNOR_H
+
+/**
+ * \class QualityGovernor
+ * \brief Chooses a quality level from the measured frame times.
+ *
+ * Level 0 is the full quality and each level above gives up one more step
+ * of quality. What each step does is up to the caller, the governor only
+ * decides when to move:
+ *  - one level down (worse quality) when the mean frame time over the last
+ *    window_frames frames exceeds the budget,
+ *  - one level up when the mean over the last upgrade_window_frames frames,
+ *    a longer window so that the quality does not oscillate around the
+ *    budget, is below headroom times the budget.
+ * After each change the frame times are collected again from scratch, so
+ * that the effect of the change is measured before the next one.
+ */
+class QualityGovernor {
+public:
+
+    // frame_budget [s]. num_levels: number of levels including level 0.
+    // headroom in (0, 1).
+    QualityGovernor(const double frame_budget, const int num_levels,
+                    const double headroom = 0.7,
+                    const int window_frames = 30,
+                    const int upgrade_window_frames = 120);
+
+    // Adds the duration of a rendered frame [s]. Returns true if the level
+    // changed.
+    bool AddFrameTime(const double frame_time);
+
+    int GetLevel() const { return level_; }
+
+    int GetNumberOfLevels() const { return num_levels_; }
+
+    double GetFrameBudget() const { return frame_budget_; }
+
+    // Mean frame time of the last complete window of window_frames [s]
+    double GetMeanFrameTime() const { return last_mean_frame_time_; }
+
+private:
+    // Starts collecting the frame times again
+    void Reset();
+
+    double frame_budget_;
+    int num_levels_;
+    double headroom_;
+    int window_frames_;
+    int upgrade_window_frames_;
+
+    int level_;
+    // frame times of the current windows
+    int num_frames_;
+    double sum_frame_times_;
+    int num_upgrade_frames_;
+    double sum_upgrade_frame_times_;
+    double last_mean_frame_time_;
+};
+
+#endif //ATAR_QUALITYGOVERNOR_H
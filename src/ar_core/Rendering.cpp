@@ -3,6 +3,13 @@
 //
 #include "Rendering.h"
 #include "VTKConversions.h"
+#include "ImageKernels.h"
+#include "StereoRenderPass.h"
+#include "ChangeTracking.h"
+#include <vtkCullerCollection.h>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
 
 
 // helper function for debugging light related issues
@@ -11,18 +18,40 @@ void AddLightActors(vtkRenderer *r);
 
 Rendering::Rendering(bool AR_mode, uint num_windows, bool with_shaodws,
                      bool offScreen_rendering,
-                     std::vector<int> window_position)
+                     std::vector<int> window_position,
+                     bool single_pass_stereo)
         : num_render_windows_(num_windows),
           with_shadows_(with_shaodws),
-          ar_mode_(AR_mode)
+          ar_mode_(AR_mode),
+          single_pass_stereo_(single_pass_stereo),
+          observer_view_scale_(1.0),
+          layer_readback_(false),
+          last_readback_time_(0.0),
+          last_upload_time_(0.0),
+          rendered_mtime_(0),
+          renders_since_change_(0),
+          num_renders_(0),
+          num_skipped_renders_(0),
+          num_view_updates_(0),
+          num_skipped_view_updates_(0),
+          scene_render_scale_(1.0)
 {
+    for (int j = 0; j < 3; ++j)
+        rendered_window_size_[j][0] = rendered_window_size_[j][1] = 0;
+    pixel_buffer_readback_[0] = pixel_buffer_readback_[1] = NULL;
+    image_size_[0] = 640;
+    image_size_[1] = 480;
+
     // make sure the number of windows are alright
     if(num_render_windows_ <1) num_render_windows_ =1;
     else if(num_render_windows_ >2) num_render_windows_ = 2;
 
-    double view_port[3][4] = {{0.333, 0.0, 0.666, 1.0}
-            , {0.666, 0.0, 1.0, 1.0}
-            ,{0.0, 0.0, 0.333, 1.0}};
+    // both eyes must be in the same context
+    if(num_render_windows_==2) single_pass_stereo_ = false;
+
+    // left and right halves of the window in one window mode
+    double view_port[2][4] = {{0.0, 0.0, 0.5, 1.0}
+            , {0.5, 0.0, 1.0, 1.0}};
 
     render_window_[0] = vtkSmartPointer<vtkRenderWindow>::New();
     render_window_[0]->BordersOff();
@@ -66,9 +95,7 @@ Rendering::Rendering(bool AR_mode, uint num_windows, bool with_shaodws,
 
     for (int i = 0; i < 2; ++i) {
 
-        image_importer_[i] = vtkSmartPointer<vtkImageImport>::New();
-        image_actor_[i] = vtkSmartPointer<vtkImageActor>::New();
-        camera_image_[i] = vtkSmartPointer<vtkImageData>::New();
+        background_actor_[i] = vtkSmartPointer<BackgroundTextureActor>::New();
 
         scene_camera_[i] = new CalibratedCamera;
         scene_renderer_[i] = vtkSmartPointer<vtkOpenGLRenderer>::New();
@@ -98,18 +125,24 @@ Rendering::Rendering(bool AR_mode, uint num_windows, bool with_shaodws,
         //scene_renderer_[i]->ResetCamera();
         scene_camera_[i]->camera = scene_renderer_[i]->GetActiveCamera();
 
-        if(with_shadows_)
-            AddShadowPass(scene_renderer_[i]);
-
-
         int j=0;
         if(num_render_windows_==2)
             j=i;
 
+        // one bake per window, by its first scene renderer
+        if(with_shadows_ && !shadow_bake_pass_[j])
+            shadow_bake_pass_[j] = vtkSmartPointer<ShadowBakePass>::New();
+        if(!single_pass_stereo_) {
+            AddScenePass(scene_renderer_[i], shadow_bake_pass_[j], i==j);
+            eye_layer_pass_[i] = scaled_render_passes_.back();
+        }
+
         render_window_[j]->SetNumberOfLayers(2);
         render_window_[j]->AddRenderer(background_renderer_[i]);
 
-        render_window_[j]->AddRenderer(scene_renderer_[i]);
+        // in single pass stereo the first scene renderer draws both eyes
+        if(!single_pass_stereo_ || i==0)
+            render_window_[j]->AddRenderer(scene_renderer_[i]);
 
         window_to_image_filter_[j] =
                 vtkSmartPointer<vtkWindowToImageFilter>::New();
@@ -125,16 +158,20 @@ Rendering::Rendering(bool AR_mode, uint num_windows, bool with_shaodws,
         //AddLightActors(scene_renderer_[j]);
     }
 
+    if(single_pass_stereo_)
+        AddStereoPass(scene_renderer_[0], view_port);
+
     //-------------------------------------------------
-    // I added the third renderer to have a way of showing what is happening
-    // to the other people who are not behind the console. this should be
-    // integrated in the loop above later...
+    // The third renderer shows what is happening to the people who are not
+    // behind the console. It is only attached to a window, its own, by
+    // EnableObserverView.
     scene_renderer_[2] = vtkSmartPointer<vtkOpenGLRenderer>::New();
 
     background_renderer_[2] = vtkSmartPointer<vtkOpenGLRenderer>::New();
     background_renderer_[2]->InteractiveOff();
     background_renderer_[2]->SetLayer(0);
-    background_renderer_[2]->SetActiveCamera(background_camera_[0]->camera);
+    background_camera_[2] = new CalibratedCamera;
+    background_renderer_[2]->SetActiveCamera(background_camera_[2]->camera);
 
 //    if(ar_mode_)
     scene_renderer_[2]->InteractiveOff();
@@ -144,20 +181,13 @@ Rendering::Rendering(bool AR_mode, uint num_windows, bool with_shaodws,
     scene_camera_[2] = new CalibratedCamera;
     scene_camera_[2]->camera = scene_renderer_[2]->GetActiveCamera();
 
-    if(num_render_windows_==1){
-        background_renderer_[2]->SetViewport(view_port[2]);
-        scene_renderer_[2]->SetViewport(view_port[2]);
-    }
-
-
     scene_renderer_[2]->AddLight(lights[0]);
     scene_renderer_[2]->AddLight(lights[1]);
 
+    // the observer window has its own context, hence its own maps
     if(with_shadows_)
-        AddShadowPass(scene_renderer_[2]);
-
-    render_window_[0]->AddRenderer(background_renderer_[2]);
-    render_window_[0]->AddRenderer(scene_renderer_[2]);
+        shadow_bake_pass_[2] = vtkSmartPointer<ShadowBakePass>::New();
+    AddScenePass(scene_renderer_[2], shadow_bake_pass_[2], true);
 
     //------------------------------------------------
 
@@ -176,12 +206,8 @@ Rendering::Rendering(bool AR_mode, uint num_windows, bool with_shaodws,
         }
     }
 
-    // Set render window size if one window the width is double
-    for (int j = 0; j < num_render_windows_; ++j) {
-        render_window_[j]->SetSize((4-num_render_windows_) * 640, 480);
-    }
-
-
+    // until the size of the camera images is known
+    ResizeWindows();
 
 }
 
@@ -189,11 +215,17 @@ Rendering::Rendering(bool AR_mode, uint num_windows, bool with_shaodws,
 //------------------------------------------------------------------------------
 Rendering::~Rendering()
 {
+    // the buffers are released while the windows are still alive
+    SetAsynchronousReadback(0);
 
     for (int j = 0; j < num_render_windows_; ++j) {
         render_window_[j]->RemoveRenderer(background_renderer_[j]);
         render_window_[j]->RemoveRenderer(scene_renderer_[j]);
     }
+    if(render_window_[2]) {
+        render_window_[2]->RemoveRenderer(background_renderer_[2]);
+        render_window_[2]->RemoveRenderer(scene_renderer_[2]);
+    }
 
 
 }
@@ -256,24 +288,24 @@ void Rendering::SetEnableBackgroundImage(bool isEnabled)
     for (int i = 0; i < 2; ++i) {
         if (isEnabled)
         {
-            if(background_renderer_[i]->GetActors()->GetNumberOfItems() == 0)
-                background_renderer_[i]->AddActor(image_actor_[i]);
+            if(!background_renderer_[i]->HasViewProp(background_actor_[i]))
+                background_renderer_[i]->AddViewProp(background_actor_[i]);
         }
         else
         {
-            if(background_renderer_[i]->GetActors()->GetNumberOfItems() > 0)
-                background_renderer_[i]->RemoveActor(image_actor_[i]);
+            if(background_renderer_[i]->HasViewProp(background_actor_[i]))
+                background_renderer_[i]->RemoveViewProp(background_actor_[i]);
         }
     }
     if (isEnabled)
     {
-        if(background_renderer_[2]->GetActors()->GetNumberOfItems() == 0)
-            background_renderer_[2]->AddActor(image_actor_[1]);
+        if(!background_renderer_[2]->HasViewProp(background_actor_[1]))
+            background_renderer_[2]->AddViewProp(background_actor_[1]);
     }
     else
     {
-        if(background_renderer_[2]->GetActors()->GetNumberOfItems() > 0)
-            background_renderer_[2]->RemoveActor(image_actor_[1]);
+        if(background_renderer_[2]->HasViewProp(background_actor_[1]))
+            background_renderer_[2]->RemoveViewProp(background_actor_[1]);
     }
 }
 
@@ -300,40 +332,37 @@ void Rendering::SetCameraIntrinsics(const cv::Mat intrinsics[])
 
 
 //------------------------------------------------------------------------------
-void
+bool
 Rendering::SetImageCameraToFaceImage(const int id, const int *window_size) {
 
-    int imageSize[3];
-    image_importer_[id]->GetOutput()->GetDimensions(imageSize);
-
-    double spacing[3];
-    image_importer_[id]->GetOutput()->GetSpacing(spacing);
-
-    double origin[3];
-    image_importer_[id]->GetOutput()->GetOrigin(origin);
+    // the observer (id 2) shows the right image
+    const int image_id = id == 2 ? 1 : id;
+    int imageSize[3] = {background_actor_[image_id]->GetImageWidth(),
+                        background_actor_[image_id]->GetImageHeight(), 1};
+    double spacing[3] = {1.0, 1.0, 1.0};
+    double origin[3] = {0.0, 0.0, 0.0};
 
-    background_camera_[id]->SetCemraToFaceImage(window_size, imageSize,
-                                                spacing, origin);
+    return background_camera_[id]->SetCemraToFaceImage(window_size,
+                                                       imageSize, spacing,
+                                                       origin);
 
 }
 
 
 //------------------------------------------------------------------------------
-void Rendering::UpdateBackgroundImage(cv::Mat  img[]) {
+void Rendering::UpdateBackgroundImage(const cv::Mat img[]) {
 
-    for (int i = 0; i < 2; ++i) {
-//    cv::flip(src, _src, 0);
-        cv::cvtColor(img[i], img[i], cv::COLOR_BGR2RGB);
-        image_importer_[i]->SetImportVoidPointer( img[i].data );
-        image_importer_[i]->Modified();
-        image_importer_[i]->Update();
-    }
+    // the images are uploaded to the textures during the next Render()
+    for (int i = 0; i < 2; ++i)
+        background_actor_[i]->SetImage(img[i]);
 }
 
 
 //------------------------------------------------------------------------------
 void Rendering::UpdateCameraViewForActualWindowSize() {
 
+    // the cameras skip the updates for unchanged sizes
+    bool updated = false;
     for (int i = 0; i <2; ++i) {
 
         int k = 0;
@@ -342,50 +371,74 @@ void Rendering::UpdateCameraViewForActualWindowSize() {
         int *window_size = render_window_[k]->GetActualSize();
 
         int single_win_size[2]
-                = {window_size[0] / (4-num_render_windows_), window_size[1]};
+                = {window_size[0] / (3-num_render_windows_), window_size[1]};
 
         // update each windows view
-        scene_camera_[i]->UpdateView(single_win_size[0],
-                                     single_win_size[1]);
-        if(i==1)
-            scene_camera_[2]->UpdateView(single_win_size[0],
-                                         single_win_size[1]);
+        updated |= scene_camera_[i]->UpdateView(single_win_size[0],
+                                                single_win_size[1]);
 
         // update the background image for each camera
-        SetImageCameraToFaceImage(i, single_win_size);
+        updated |= SetImageCameraToFaceImage(i, single_win_size);
     }
+
+    // the observer shows the right camera in its own window
+    if(render_window_[2]) {
+        int *window_size = render_window_[2]->GetActualSize();
+        updated |= scene_camera_[2]->UpdateView(window_size[0],
+                                                window_size[1]);
+        updated |= SetImageCameraToFaceImage(2, window_size);
+    }
+
+    if(updated)
+        num_view_updates_++;
+    else
+        num_skipped_view_updates_++;
 }
 
 
 //------------------------------------------------------------------------------
-void Rendering::ConfigureBackgroundImage(cv::Mat *img) {
+void Rendering::ConfigureBackgroundImage(const cv::Mat *img) {
 
-    int image_width = img[0].size().width;
-    int image_height = img[0].size().height;
+    SetCameraImageSize(img[0].size().width, img[0].size().height);
 
     for (int i = 0; i < 2; ++i) {
         assert( img[i].data != NULL );
 
-        scene_camera_[i]->SetCameraImageSize(image_width, image_height);
-        background_camera_[i]->SetCameraImageSize(image_width, image_height);
+        // these images may be gone before the first render
+        background_actor_[i]->SetImage(img[i].clone());
+    }
+
+}
 
-        if (camera_image_[i]) {
-            image_importer_[i]->SetOutput(camera_image_[i]);
-        }
-        image_importer_[i]->SetDataSpacing(1, 1, 1);
-        image_importer_[i]->SetDataOrigin(0, 0, 0);
-        image_importer_[i]->SetWholeExtent(0, image_width - 1, 0,
-                                           image_height - 1, 0, 0);
-        image_importer_[i]->SetDataExtentToWholeExtent();
-        image_importer_[i]->SetDataScalarTypeToUnsignedChar();
-        image_importer_[i]->SetNumberOfScalarComponents(img[i].channels());
-        image_importer_[i]->SetImportVoidPointer(img[i].data);
-        image_importer_[i]->Update();
 
-        image_actor_[i]->SetInputData(camera_image_[i]);
+//------------------------------------------------------------------------------
+void Rendering::SetCameraImageSize(const int width, const int height) {
+
+    for (int i = 0; i < 3; ++i) {
+        scene_camera_[i]->SetCameraImageSize(width, height);
+        background_camera_[i]->SetCameraImageSize(width, height);
     }
-    scene_camera_[2]->SetCameraImageSize(image_width, image_height);
+    if(width == image_size_[0] && height == image_size_[1])
+        return;
+    image_size_[0] = width;
+    image_size_[1] = height;
+    ResizeWindows();
+}
 
+
+//------------------------------------------------------------------------------
+void Rendering::ResizeWindows() {
+
+    // if one window the width is double
+    for (int j = 0; j < num_render_windows_; ++j) {
+        if(!render_window_[j]->GetFullScreen())
+            render_window_[j]->SetSize((3-num_render_windows_) * image_size_[0],
+                                       image_size_[1]);
+    }
+    if(render_window_[2] && !render_window_[2]->GetFullScreen())
+        render_window_[2]->SetSize(
+                std::max(1, (int)(observer_view_scale_ * image_size_[0])),
+                std::max(1, (int)(observer_view_scale_ * image_size_[1])));
 }
 
 
@@ -413,6 +466,8 @@ Rendering::AddActorsToScene(std::vector<vtkSmartPointer<vtkProp> > actors) {
         if(with_shadows_)
             actors[i]->SetPropertyKeys(key_properties);
 
+        mesh_level_of_detail_.AddActor(vtkActor::SafeDownCast(actors[i]));
+
         scene_renderer_[0]->AddViewProp(actors[i]);
         scene_renderer_[1]->AddViewProp(actors[i]);
         scene_renderer_[2]->AddViewProp(actors[i]);
@@ -426,24 +481,148 @@ Rendering::AddActorsToScene(std::vector<vtkSmartPointer<vtkProp> > actors) {
 
 
 //------------------------------------------------------------------------------
-void Rendering::Render() {
+void Rendering::Render(bool read_back) {
+
+    if(HasChangedSinceLastRender())
+        renders_since_change_ = 0;
+    else
+        renders_since_change_++;
+
+    for (int i = 0; i < 2; ++i)
+        if(eye_layer_pass_[i])
+            eye_layer_pass_[i]->SetCaptureLayer(layer_readback_ && read_back);
 
-//    scene_renderer_->Modified();
-//    background_renderer_->Modified();
-//    render_window_->Modified();
     for (int i = 0; i < num_render_windows_; ++i) {
-//    for (int i = 0; i < 1; ++i) {
+
+        if(!pixel_buffer_readback_[i]) {
+            render_window_[i]->Render();
+            continue;
+        }
+        if(!read_back) {
+            pixel_buffer_readback_[i]->Discard();
+            render_window_[i]->Render();
+            continue;
+        }
+
+        // keep the frame in the back buffer until its reading is queued,
+        // then swap
+        render_window_[i]->SwapBuffersOff();
         render_window_[i]->Render();
+        render_window_[i]->MakeCurrent();
+        pixel_buffer_readback_[i]->Queue();
+        render_window_[i]->SwapBuffersOn();
+        render_window_[i]->Frame();
+    }
+
+    last_upload_time_ = background_actor_[0]->TakeUploadTime()
+                        + background_actor_[1]->TakeUploadTime();
+
+    // after the render, which updates the pipelines of the actors
+    num_renders_++;
+    rendered_mtime_ = GetMTime();
+    for (int j = 0; j < 3; ++j) {
+        if(!render_window_[j])
+            continue;
+        int *window_size = render_window_[j]->GetActualSize();
+        rendered_window_size_[j][0] = window_size[0];
+        rendered_window_size_[j][1] = window_size[1];
+    }
+}
+
+
+//------------------------------------------------------------------------------
+bool Rendering::RenderIfChanged(bool read_back) {
+
+    // with the asynchronous readback the last changed frame is only read
+    // back GetReadbackDelay() renders later
+    if(!HasChangedSinceLastRender()
+       && (!read_back || renders_since_change_ >= GetReadbackDelay())) {
+        num_skipped_renders_++;
+        return false;
+    }
+    Render(read_back);
+    return true;
+}
+
+
+//------------------------------------------------------------------------------
+void Rendering::GetRenderCounts(unsigned long &rendered,
+                                unsigned long &skipped) const {
+    rendered = num_renders_;
+    skipped = num_skipped_renders_;
+}
+
+
+//------------------------------------------------------------------------------
+void Rendering::GetCameraViewUpdateCounts(unsigned long &updated,
+                                          unsigned long &skipped) const {
+    updated = num_view_updates_;
+    skipped = num_skipped_view_updates_;
+}
+
+
+//------------------------------------------------------------------------------
+unsigned long Rendering::GetMTime() const {
+
+    // the scene renderers share the props and the lights
+    unsigned long mtime = ChangeTracking::GetSceneMTime(scene_renderer_[0]);
+    for (int i = 0; i < 3; ++i) {
+        mtime = std::max<unsigned long>(
+                mtime, scene_camera_[i]->camera->GetMTime());
+        mtime = std::max<unsigned long>(
+                mtime, background_camera_[i]->camera->GetMTime());
+        // background shown or hidden
+        mtime = std::max<unsigned long>(
+                mtime, background_renderer_[i]->GetViewProps()->GetMTime());
     }
+    // new camera images
+    for (int i = 0; i < 2; ++i)
+        mtime = std::max<unsigned long>(
+                mtime, background_actor_[i]->GetMTime());
+    return mtime;
+}
+
 
+//------------------------------------------------------------------------------
+bool Rendering::HasChangedSinceLastRender() const {
+
+    if(num_renders_ == 0 || GetMTime() > rendered_mtime_)
+        return true;
+    for (int j = 0; j < 3; ++j) {
+        if(!render_window_[j])
+            continue;
+        int *window_size = render_window_[j]->GetActualSize();
+        if(window_size[0] != rendered_window_size_[j][0]
+           || window_size[1] != rendered_window_size_[j][1])
+            return true;
+    }
+    return false;
 }
 
 
 //------------------------------------------------------------------------------
-void Rendering::GetRenderedImage(cv::Mat *images) {
+bool Rendering::GetRenderedImage(cv::Mat *images) {
 
     // TODO: REWRITE FOR 2-WINDOW CASE (writes on the same image for now)
 
+    if(layer_readback_)
+        return ComposeVirtualLayer(images);
+
+    if(pixel_buffer_readback_[0]) {
+        bool retrieved = true;
+        last_readback_time_ = 0.0;
+        for (int i = 0; i < num_render_windows_; ++i) {
+            render_window_[i]->MakeCurrent();
+            retrieved &= pixel_buffer_readback_[i]->Retrieve(images[i]);
+            last_readback_time_ +=
+                    pixel_buffer_readback_[i]->GetLastReadbackTime();
+        }
+        return retrieved;
+    }
+
+    std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+    bool retrieved = true;
     for (int i = 0; i < num_render_windows_; ++i) {
 
         window_to_image_filter_[i]->Modified();
@@ -459,24 +638,155 @@ void Rendering::GetRenderedImage(cv::Mat *images) {
         if (dims[0] > 0) {
             cv::Mat openCVImage(dims[1], dims[0], CV_8UC3,
                                 image->GetScalarPointer()); // Unsigned int, 4 channels
-            // convert to bgr
-            cv::cvtColor(openCVImage, images[i], cv::COLOR_RGB2BGR);
+            // convert to bgr and flip because of different origins between
+            // vtk and OpenCV, in one pass
+            ImageKernels::FlipVerticalAndSwapRedBlue(openCVImage, images[i]);
+        }
+        else
+            retrieved = false;
+    }
+    last_readback_time_ = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    return retrieved;
+}
+
+
+//------------------------------------------------------------------------------
+bool Rendering::ComposeVirtualLayer(cv::Mat *images) {
+
+    std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+    last_readback_time_ = 0.0;
+    for (int i = 0; i < 2; ++i)
+        if(!eye_layer_pass_[i]->HasLayer())
+            return false;
+
+    // the eyes side by side in one window mode, as the window shows them
+    const cv::Size size(image_size_[0], image_size_[1]);
+    if(num_render_windows_ == 1)
+        images[0].create(size.height, 2 * size.width, CV_8UC3);
+
+    for (int i = 0; i < 2; ++i) {
+        ScaledRenderPass *pass = eye_layer_pass_[i];
+        last_readback_time_ += pass->GetLastReadbackTime();
+
+        cv::Mat eye_image;
+        if(num_render_windows_ == 1)
+            eye_image = images[0](cv::Rect(i * size.width, 0, size.width,
+                                           size.height));
+        else {
+            images[i].create(size, CV_8UC3);
+            eye_image = images[i];
+        }
+        // the image the frame was rendered on, nothing in VR. It is
+        // stretched over the eye as the background actor is, e.g. when it
+        // was undistorted at a reduced scale.
+        const cv::Mat &background = background_actor_[i]->GetImage();
+        if(background.empty() || background.type() != CV_8UC3)
+            eye_image.setTo(cv::Scalar::all(0));
+        else if(background.size() == size)
+            background.copyTo(eye_image);
+        else
+            cv::resize(background, eye_image, size, 0, 0, cv::INTER_LINEAR);
+
+        const cv::Rect &region = pass->GetLayerRegion();
+        if(region.area() == 0)
+            continue;
+        if(pass->GetLayerSize() == size) {
+            cv::Mat target = eye_image(region);
+            ImageKernels::AlphaBlendFlipped(pass->GetLayer(), target);
+            continue;
+        }
+
+        // the layer was rendered at a lower scale
+        const double fx = (double)size.width / pass->GetLayerSize().width;
+        const double fy = (double)size.height / pass->GetLayerSize().height;
+        const int x0 = (int)std::floor(region.x * fx);
+        const int y0 = (int)std::floor(region.y * fy);
+        const int x1 = (int)std::ceil((region.x + region.width) * fx);
+        const int y1 = (int)std::ceil((region.y + region.height) * fy);
+        const cv::Rect scaled_region = cv::Rect(x0, y0, x1 - x0, y1 - y0)
+                                       & cv::Rect(cv::Point(), size);
+        if(scaled_region.area() == 0)
+            continue;
+        cv::Mat scaled_layer;
+        cv::resize(pass->GetLayer(), scaled_layer, scaled_region.size(), 0, 0,
+                   cv::INTER_LINEAR);
+        cv::Mat target = eye_image(scaled_region);
+        ImageKernels::AlphaBlendFlipped(scaled_layer, target);
+    }
+
+    last_readback_time_ += std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+
+//------------------------------------------------------------------------------
+bool Rendering::SetVirtualLayerReadback(const bool on) {
+
+    if(on) {
+        if(!eye_layer_pass_[0])
+            return false;
+        for (int j = 0; j < num_render_windows_; ++j)
+            if(!ScaledRenderPass::IsSupported(render_window_[j]))
+                return false;
+        SetAsynchronousReadback(0);
+    }
+    layer_readback_ = on;
+
+    // nobody sees the off screen windows, the camera images are only needed
+    // in the composited images
+    for (int i = 0; i < 2; ++i) {
+        const int j = num_render_windows_ == 2 ? i : 0;
+        if(render_window_[j]->GetOffScreenRendering())
+            background_renderer_[i]->SetDraw(on ? 0 : 1);
+    }
+    return true;
+}
 
-            // Flip because of different origins between vtk and OpenCV
-            cv::flip(images[i], images[i], 0);
+
+//------------------------------------------------------------------------------
+bool Rendering::SetAsynchronousReadback(const int num_buffers) {
+
+    for (int i = 0; i < 2; ++i) {
+        delete pixel_buffer_readback_[i];
+        pixel_buffer_readback_[i] = NULL;
+    }
+    if(num_buffers < 2)
+        return true;
+    SetVirtualLayerReadback(false);
+
+    for (int i = 0; i < num_render_windows_; ++i) {
+        render_window_[i]->MakeCurrent();
+        if(!PixelBufferReadback::IsSupported(render_window_[i])) {
+            SetAsynchronousReadback(0);
+            return false;
         }
+        pixel_buffer_readback_[i] =
+                new PixelBufferReadback(render_window_[i], num_buffers);
     }
+    return true;
+}
+
+
+//------------------------------------------------------------------------------
+int Rendering::GetReadbackDelay() const {
+    return pixel_buffer_readback_[0] ? pixel_buffer_readback_[0]->GetDelay()
+                                     : 0;
 }
 
 void Rendering::RemoveAllActorsFromScene() {
 
+    mesh_level_of_detail_.RemoveAllActors();
     scene_renderer_[0]->RemoveAllViewProps();
     scene_renderer_[1]->RemoveAllViewProps();
     scene_renderer_[2]->RemoveAllViewProps();
 }
 
-void Rendering::AddShadowPass(vtkSmartPointer<vtkOpenGLRenderer> renderer) {
-
+//------------------------------------------------------------------------------
+vtkSmartPointer<vtkRenderPass>
+Rendering::CreateEyePass(ShadowBakePass *bake_pass) {
 
     vtkSmartPointer<vtkCameraPass> cameraP =
             vtkSmartPointer<vtkCameraPass>::New();
@@ -492,48 +802,195 @@ void Rendering::AddShadowPass(vtkSmartPointer<vtkOpenGLRenderer> renderer) {
     vtkSmartPointer<vtkLightsPass> lights_pass =
             vtkSmartPointer<vtkLightsPass>::New();
 
-    vtkSmartPointer<vtkSequencePass> opaqueSequence =
+    vtkSmartPointer<vtkRenderPassCollection> passes =
+            vtkSmartPointer<vtkRenderPassCollection>::New();
+
+    if(bake_pass) {
+        vtkSmartPointer<vtkSequencePass> opaqueSequence =
+                vtkSmartPointer<vtkSequencePass>::New();
+
+        vtkSmartPointer<vtkRenderPassCollection> passes2 =
+                vtkSmartPointer<vtkRenderPassCollection>::New();
+        passes2->AddItem(lights_pass);
+        passes2->AddItem(opaque);
+        opaqueSequence->SetPasses(passes2);
+
+        vtkSmartPointer<vtkShadowMapPass> shadows =
+                vtkSmartPointer<vtkShadowMapPass>::New();
+        shadows->SetShadowMapBakerPass(bake_pass->GetBakerPass());
+        shadows->SetOpaquePass(opaqueSequence);
+
+        passes->AddItem(shadows);
+        passes->AddItem(lights_pass);
+    }
+    else {
+        // what vtkRenderer does without passes
+        passes->AddItem(lights_pass);
+        passes->AddItem(opaque);
+        passes->AddItem(vtkSmartPointer<vtkTranslucentPass>::New());
+    }
+    passes->AddItem(volume);
+    passes->AddItem(overlay);
+
+    vtkSmartPointer<vtkSequencePass> seq =
             vtkSmartPointer<vtkSequencePass>::New();
+    seq->SetPasses(passes);
+    cameraP->SetDelegatePass(seq);
 
-    vtkSmartPointer<vtkRenderPassCollection> passes2 =
-            vtkSmartPointer<vtkRenderPassCollection>::New();
-    passes2->AddItem(lights_pass);
-    passes2->AddItem(opaque);
-    opaqueSequence->SetPasses(passes2);
+    // lets the quality governor lower the resolution of the scene
+    vtkSmartPointer<ScaledRenderPass> scaled_pass =
+            vtkSmartPointer<ScaledRenderPass>::New();
+    scaled_pass->SetDelegatePass(cameraP);
+    scaled_pass->SetScale(scene_render_scale_);
+    scaled_render_passes_.push_back(scaled_pass);
 
-    vtkSmartPointer<vtkCameraPass> opaqueCameraPass =
-            vtkSmartPointer<vtkCameraPass>::New();
-    opaqueCameraPass->SetDelegatePass(opaqueSequence);
+    return scaled_pass;
+}
 
-    vtkSmartPointer<vtkShadowMapBakerPass> shadowsBaker =
-            vtkSmartPointer<vtkShadowMapBakerPass>::New();
-    shadowsBaker->SetOpaquePass(opaqueCameraPass);
-    shadowsBaker->SetResolution(2048);
-    // To cancel self-shadowing.
-    shadowsBaker->SetPolygonOffsetFactor(2.4f);
-    shadowsBaker->SetPolygonOffsetUnits(5.0f);
 
-    vtkSmartPointer<vtkShadowMapPass> shadows =
-            vtkSmartPointer<vtkShadowMapPass>::New();
-    shadows->SetShadowMapBakerPass(shadowsBaker);
-    shadows->SetOpaquePass(opaqueSequence);
+//------------------------------------------------------------------------------
+void Rendering::AddScenePass(vtkSmartPointer<vtkOpenGLRenderer> renderer,
+                             ShadowBakePass *bake_pass, const bool bakes) {
+
+    vtkSmartPointer<vtkRenderPass> eye_pass = CreateEyePass(bake_pass);
+    if(!bake_pass || !bakes) {
+        renderer->SetPass(eye_pass);
+        return;
+    }
 
+    // the other renderers of the window use the maps baked by this one
     vtkSmartPointer<vtkSequencePass> seq =
             vtkSmartPointer<vtkSequencePass>::New();
     vtkSmartPointer<vtkRenderPassCollection> passes =
             vtkSmartPointer<vtkRenderPassCollection>::New();
-    passes->AddItem(shadowsBaker);
-    passes->AddItem(shadows);
-    passes->AddItem(lights_pass);
-    passes->AddItem(volume);
-    passes->AddItem(overlay);
+    passes->AddItem(bake_pass);
+    passes->AddItem(eye_pass);
     seq->SetPasses(passes);
-    cameraP->SetDelegatePass(seq);
+    renderer->SetPass(seq);
+}
+
+
+//------------------------------------------------------------------------------
+void Rendering::AddStereoPass(vtkSmartPointer<vtkOpenGLRenderer> renderer,
+                              double view_port[2][4]) {
+
+    // The renderer covers the window and the pass sets the viewport and the
+    // camera of each eye. The cullers of the renderer would only see the
+    // frustum of its own camera.
+    renderer->SetViewport(0.0, 0.0, 1.0, 1.0);
+    renderer->GetCullers()->RemoveAllItems();
+
+    vtkSmartPointer<StereoRenderPass> stereo_pass =
+            vtkSmartPointer<StereoRenderPass>::New();
+    for (int i = 0; i < 2; ++i)
+        stereo_pass->SetEye(i, scene_camera_[i]->camera, view_port[i]);
+
+    // the maps are baked by the stereo pass, once for both eyes
+    stereo_pass->SetShadowBakePass(shadow_bake_pass_[0]);
+    stereo_pass->SetEyePass(CreateEyePass(shadow_bake_pass_[0]));
+
+    renderer->SetPass(stereo_pass);
+}
+
+
+//------------------------------------------------------------------------------
+void Rendering::SetSceneRenderScale(const double scale) {
+    scene_render_scale_ = scale;
+    for (size_t k = 0; k < scaled_render_passes_.size(); ++k)
+        scaled_render_passes_[k]->SetScale(scale);
+}
+
+
+//------------------------------------------------------------------------------
+void Rendering::SetMeshLevelOfDetail(const int level) {
+    mesh_level_of_detail_.SetLevel(level);
+}
+
+
+//------------------------------------------------------------------------------
+void Rendering::SetShadowMapResolution(const unsigned int resolution) {
+    for (int j = 0; j < 3; ++j)
+        if(shadow_bake_pass_[j])
+            shadow_bake_pass_[j]->SetResolution(resolution);
+}
+
+
+//------------------------------------------------------------------------------
+void Rendering::SetShadowBakeOnlyOnChange(const bool on) {
+    for (int j = 0; j < 3; ++j)
+        if(shadow_bake_pass_[j])
+            shadow_bake_pass_[j]->SetBakeOnlyOnChange(on);
+}
+
+
+//------------------------------------------------------------------------------
+void Rendering::GetShadowBakeCounts(unsigned long &bakes,
+                                    unsigned long &skipped) const {
+    bakes = skipped = 0;
+    for (int j = 0; j < 3; ++j) {
+        if(!shadow_bake_pass_[j])
+            continue;
+        bakes += shadow_bake_pass_[j]->GetNumberOfBakes();
+        skipped += shadow_bake_pass_[j]->GetNumberOfSkippedBakes();
+    }
+}
 
-    renderer->SetPass(cameraP);
 
+//------------------------------------------------------------------------------
+void Rendering::EnableObserverView(const double scale, const bool off_screen,
+                                   const std::vector<int> &position) {
+
+    if(render_window_[2])
+        return;
+
+    render_window_[2] = vtkSmartPointer<vtkRenderWindow>::New();
+    render_window_[2]->BordersOff();
+    render_window_[2]->SetWindowName("Observer");
+    render_window_[2]->SetNumberOfLayers(2);
+    render_window_[2]->AddRenderer(background_renderer_[2]);
+    render_window_[2]->AddRenderer(scene_renderer_[2]);
+    if(position.size() > 1)
+        render_window_[2]->SetPosition(position[0], position[1]);
+    if(off_screen)
+        render_window_[2]->SetOffScreenRendering(1);
+    observer_view_scale_ = scale;
+    ResizeWindows();
+
+    window_to_image_filter_[2] = vtkSmartPointer<vtkWindowToImageFilter>::New();
+    window_to_image_filter_[2]->SetInput(render_window_[2]);
+    window_to_image_filter_[2]->ReadFrontBufferOff();
+
+    render_window_[2]->Render();
 }
 
+
+//------------------------------------------------------------------------------
+bool Rendering::RenderObserverView(cv::Mat *image) {
+
+    if(!render_window_[2])
+        return false;
+
+    if(!image) {
+        render_window_[2]->Render();
+        return true;
+    }
+
+    // reading the back buffer renders the window
+    window_to_image_filter_[2]->Modified();
+    window_to_image_filter_[2]->Update();
+    vtkImageData *observer_image = window_to_image_filter_[2]->GetOutput();
+    int dims[3];
+    observer_image->GetDimensions(dims);
+    if (dims[0] <= 0)
+        return false;
+    ImageKernels::FlipVerticalAndSwapRedBlue(
+            cv::Mat(dims[1], dims[0], CV_8UC3,
+                    observer_image->GetScalarPointer()), *image);
+    return true;
+}
+
+
+//------------------------------------------------------------------------------
 void Rendering::ToggleFullScreen() {
 
     for (int k = 0; k < num_render_windows_; ++k) {
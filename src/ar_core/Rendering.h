@@ -7,6 +7,11 @@
 
 #include <opencv2/opencv.hpp>
 #include "CalibratedCamera.h"
+#include "PixelBufferReadback.h"
+#include "BackgroundTextureActor.h"
+#include "ShadowBakePass.h"
+#include "MeshLevelOfDetail.h"
+#include "ScaledRenderPass.h"
 #include <kdl/frames.hpp>
 
 #include <vtkImageImport.h>
@@ -57,9 +62,12 @@ public:
     //    vtkTypeMacro(Rendering, vtkRenderWindow);
     //    static Rendering *New();
 
+    // With single_pass_stereo and one window, one scene renderer draws both
+    // eyes (see StereoRenderPass). Ignored with two windows.
     Rendering(bool AR_mode, uint num_windows, bool with_shaodws,
                   bool offScreen_rendering,
-                  std::vector<int> window_position);
+                  std::vector<int> window_position,
+                  bool single_pass_stereo = false);
 
     ~Rendering();
 
@@ -67,9 +75,18 @@ public:
 
     void SetEnableBackgroundImage(bool isEnabled);
 
-    void ConfigureBackgroundImage(cv::Mat *);
+    void ConfigureBackgroundImage(const cv::Mat *);
 
-    void UpdateBackgroundImage(cv::Mat []);
+    // Size of the camera images, 640x480 until set. The cameras are set up
+    // for it and the windows are resized to show the images at their native
+    // resolution: width x height per eye, and scale times that for the
+    // observer view. Called by ConfigureBackgroundImage.
+    void SetCameraImageSize(const int width, const int height);
+
+    // Sets the bgr camera images shown in the background. They are uploaded
+    // without conversion during the next Render() and must stay valid until
+    // then.
+    void UpdateBackgroundImage(const cv::Mat []);
 
     void UpdateCameraViewForActualWindowSize();
 
@@ -81,42 +98,167 @@ public:
 
     void RemoveAllActorsFromScene();
 
-    void Render();
+    // When read_back is true and the asynchronous readback is enabled, the
+    // reading of the frame is queued before the buffers are swapped.
+    void Render(bool read_back = false);
+
+    // Renders only if the scene, the cameras, the camera images or the size
+    // of a window changed since the last Render(). With read_back and the
+    // asynchronous readback, the frames after a change are rendered until
+    // the changed one is read back. Returns whether it rendered.
+    bool RenderIfChanged(bool read_back = false);
+
+    // Number of Render() and of renders skipped by RenderIfChanged()
+    void GetRenderCounts(unsigned long &rendered,
+                         unsigned long &skipped) const;
+
+    // Number of UpdateCameraViewForActualWindowSize() calls that updated a
+    // camera and of those that found nothing to update
+    void GetCameraViewUpdateCounts(unsigned long &updated,
+                                   unsigned long &skipped) const;
+
+    // Copies the rendered images in images. With the asynchronous readback
+    // these are the images of GetReadbackDelay() frames earlier and false
+    // is returned until the first of them is available. images are
+    // reallocated only if the window size changed.
+    bool GetRenderedImage(cv::Mat *images);
+
+    // Reads the windows through num_buffers pixel buffer objects (2 or 3)
+    // instead of a synchronous glReadPixels. Less than 2 goes back to the
+    // synchronous readback. Replaces the virtual layer readback. Returns
+    // false if the OpenGL context does not support it.
+    bool SetAsynchronousReadback(const int num_buffers);
+
+    // Instead of reading back the windows, GetRenderedImage reads the
+    // virtual layer of each eye, only where the props are, and draws it
+    // over the camera images on the cpu. With off screen windows the camera
+    // images are then not drawn on the GPU at all. Replaces the
+    // asynchronous readback. Returns false if frame buffer objects are not
+    // supported or with single pass stereo. Assumes the viewports have the
+    // aspect ratio of the camera images, as SetCameraImageSize sizes them.
+    bool SetVirtualLayerReadback(const bool on);
+
+    // Number of frames by which the images of GetRenderedImage lag behind
+    // the last rendered frame. 0 with the synchronous readback.
+    int GetReadbackDelay() const;
+
+    // Time spent reading back the last frame, all windows included [s]
+    double GetLastReadbackTime() const { return last_readback_time_; }
+
+    // Time spent uploading the camera images in the last Render() [s]
+    double GetLastUploadTime() const { return last_upload_time_; }
+
+    // Size of the shadow maps in pixels, 2048 by default
+    void SetShadowMapResolution(const unsigned int resolution);
+
+    // Keep the shadow maps until a prop, a light or a geometry changed
+    // instead of baking them at each frame
+    void SetShadowBakeOnlyOnChange(const bool on);
 
-    void GetRenderedImage(cv::Mat *images);
+    // Number of shadow map bakes done and skipped, all windows included
+    void GetShadowBakeCounts(unsigned long &bakes,
+                             unsigned long &skipped) const;
+
+    // Resolution of the virtual scene relative to the windows, in (0, 1].
+    // The camera images keep the full resolution.
+    void SetSceneRenderScale(const double scale);
+
+    // 0: the meshes as loaded. 1 and 2: large static meshes are replaced
+    // by coarser versions (see MeshLevelOfDetail).
+    void SetMeshLevelOfDetail(const int level);
 
     void ToggleFullScreen();
 
+    // Creates the window of the observer view, which shows the right camera
+    // to the people who are not behind the console. Its size is scale times
+    // the camera image size. With off_screen the window is not shown and the
+    // view is only available through RenderObserverView(image).
+    void EnableObserverView(const double scale, const bool off_screen,
+                            const std::vector<int> &position);
+
+    bool HasObserverView() const { return render_window_[2] != NULL; }
+
+    // Renders the observer view, independently of the stereo windows. If
+    // image is not NULL the view is also read back in it (bgr). Returns false
+    // if there is no observer view or it could not be read back.
+    bool RenderObserverView(cv::Mat *image = NULL);
+
 private:
 
-    void AddShadowPass(vtkSmartPointer<vtkOpenGLRenderer>);
+    // The passes drawing the scene for one eye, with shadows if bake_pass is
+    // not NULL, at the scene render scale
+    vtkSmartPointer<vtkRenderPass> CreateEyePass(ShadowBakePass *bake_pass);
+
+    // bakes: whether renderer bakes the maps of bake_pass or only uses them
+    void AddScenePass(vtkSmartPointer<vtkOpenGLRenderer> renderer,
+                      ShadowBakePass *bake_pass, const bool bakes);
+
+    // Makes renderer draw the scene for both eyes in their viewports
+    void AddStereoPass(vtkSmartPointer<vtkOpenGLRenderer> renderer,
+                       double view_port[2][4]);
+
+    // Set up the background scene_camera to fill the renderer with the image.
+    // Returns false if the camera was already set up for these sizes.
+    bool SetImageCameraToFaceImage(const int id, const int *window_size);
+
+    // Sizes the windows from the camera image size, except those in full
+    // screen
+    void ResizeWindows();
+
+    // GetRenderedImage with the virtual layer readback
+    bool ComposeVirtualLayer(cv::Mat *images);
+
+    // Latest modification time of what the windows show
+    unsigned long GetMTime() const;
 
-    // Set up the background scene_camera to fill the renderer with the image
-    void SetImageCameraToFaceImage(const int id, const int *window_size);
+    bool HasChangedSinceLastRender() const;
 
 private:
     int num_render_windows_;
     bool with_shadows_;
     bool ar_mode_;
+    bool single_pass_stereo_;
+    // of one eye
+    int image_size_[2];
+    double observer_view_scale_;
     //cameras
-    CalibratedCamera  *                     background_camera_[2];
+    CalibratedCamera  *                     background_camera_[3];
     CalibratedCamera  *                     scene_camera_[3];
 
     vtkSmartPointer<vtkLight>               lights[2];
+    // one per window, NULL without shadows
+    vtkSmartPointer<ShadowBakePass>         shadow_bake_pass_[3];
     // renderer
     vtkSmartPointer<vtkOpenGLRenderer>      background_renderer_[3];
     vtkSmartPointer<vtkOpenGLRenderer>      scene_renderer_[3];
-    // image importing
-    vtkSmartPointer<vtkImageImport>         image_importer_[2];
-    vtkSmartPointer<vtkImageActor>          image_actor_[2];
-    vtkSmartPointer<vtkImageData>           camera_image_[2];
+    // camera images
+    vtkSmartPointer<BackgroundTextureActor> background_actor_[2];
     // transforms
 
     // windows
     vtkSmartPointer<vtkRenderWindow>        render_window_[3];
     //    vtkSmartPointer<vtkRenderWindowInteractor> renderWindowInteractor;
     // reading images back
-    vtkSmartPointer<vtkWindowToImageFilter> window_to_image_filter_[2] ;
+    vtkSmartPointer<vtkWindowToImageFilter> window_to_image_filter_[3] ;
+    // NULL unless the asynchronous readback is enabled
+    PixelBufferReadback *                   pixel_buffer_readback_[2];
+    // the scene pass of each eye, NULL in single pass stereo
+    vtkSmartPointer<ScaledRenderPass>       eye_layer_pass_[2];
+    bool                                    layer_readback_;
+    double                                  last_readback_time_;
+    double                                  last_upload_time_;
+    // state of the last Render(), for RenderIfChanged()
+    unsigned long                           rendered_mtime_;
+    int                                     rendered_window_size_[3][2];
+    int                                     renders_since_change_;
+    unsigned long                           num_renders_;
+    unsigned long                           num_skipped_renders_;
+    unsigned long                           num_view_updates_;
+    unsigned long                           num_skipped_view_updates_;
+    // quality knobs
+    double                                  scene_render_scale_;
+    std::vector<vtkSmartPointer<ScaledRenderPass> > scaled_render_passes_;
+    MeshLevelOfDetail                       mesh_level_of_detail_;
 
 };
 
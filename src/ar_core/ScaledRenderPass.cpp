@@ -0,0 +1,259 @@
+//
+// Renders the virtual scene at a fraction of the window resolution.
+//
+
+#include "ScaledRenderPass.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vtkgl.h>
+#include <vtkCamera.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkOpenGLRenderWindow.h>
+#include <vtkProp.h>
+#include <vtkRenderState.h>
+#include <vtkRenderer.h>
+
+vtkStandardNewMacro(ScaledRenderPass);
+
+//------------------------------------------------------------------------------
+ScaledRenderPass::ScaledRenderPass()
+        : scale_(1.0), supported_(-1), capture_layer_(false),
+          has_layer_(false), last_readback_time_(0.0)
+{
+}
+
+//------------------------------------------------------------------------------
+void ScaledRenderPass::SetScale(const double scale) {
+    scale_ = std::min(1.0, std::max(0.1, scale));
+}
+
+//------------------------------------------------------------------------------
+bool ScaledRenderPass::IsSupported(vtkRenderWindow *window) {
+    vtkOpenGLRenderWindow *gl_window =
+            vtkOpenGLRenderWindow::SafeDownCast(window);
+    if(!gl_window)
+        return false;
+    gl_window->MakeCurrent();
+    return vtkFrameBufferObject::IsSupported(gl_window)
+           && vtkTextureObject::IsSupported(gl_window);
+}
+
+//------------------------------------------------------------------------------
+void ScaledRenderPass::Render(const vtkRenderState *s) {
+
+    NumberOfRenderedProps = 0;
+    has_layer_ = false;
+    last_readback_time_ = 0.0;
+    if(!delegate_pass_)
+        return;
+
+    vtkRenderer *renderer = s->GetRenderer();
+    vtkOpenGLRenderWindow *window =
+            vtkOpenGLRenderWindow::SafeDownCast(renderer->GetRenderWindow());
+    if(supported_ < 0)
+        supported_ = window && vtkFrameBufferObject::IsSupported(window)
+                     && vtkTextureObject::IsSupported(window);
+
+    // an outer pass may already render in a frame buffer
+    if((scale_ >= 1.0 && !capture_layer_) || !supported_
+       || s->GetFrameBuffer() != NULL) {
+        delegate_pass_->Render(s);
+        NumberOfRenderedProps = delegate_pass_->GetNumberOfRenderedProps();
+        return;
+    }
+
+    int width, height, x, y;
+    renderer->GetTiledSizeAndOrigin(&width, &height, &x, &y);
+    const int scaled_width = std::max(1, (int)std::lround(width * scale_));
+    const int scaled_height = std::max(1, (int)std::lround(height * scale_));
+    layer_size_ = cv::Size(scaled_width, scaled_height);
+
+    if(!frame_buffer_) {
+        frame_buffer_ = vtkSmartPointer<vtkFrameBufferObject>::New();
+        frame_buffer_->SetContext(window);
+        texture_ = vtkSmartPointer<vtkTextureObject>::New();
+        texture_->SetContext(window);
+    }
+    if((int)texture_->GetWidth() != scaled_width
+       || (int)texture_->GetHeight() != scaled_height) {
+        texture_->Create2D(scaled_width, scaled_height, 4, VTK_UNSIGNED_CHAR,
+                           false);
+        texture_->SetMinificationFilter(vtkTextureObject::Linear);
+        texture_->SetLinearMagnification(true);
+        texture_->SetWrapS(vtkTextureObject::ClampToEdge);
+        texture_->SetWrapT(vtkTextureObject::ClampToEdge);
+    }
+
+    // the window may itself be rendered in a frame buffer (off screen)
+    GLint window_frame_buffer = 0;
+    glGetIntegerv(vtkgl::FRAMEBUFFER_BINDING_EXT, &window_frame_buffer);
+
+    frame_buffer_->SetNumberOfRenderTargets(1);
+    frame_buffer_->SetColorBuffer(0, texture_);
+    frame_buffer_->SetActiveBuffer(0);
+    frame_buffer_->SetDepthBufferNeeded(true);
+    if(!frame_buffer_->StartNonOrtho(scaled_width, scaled_height, false)) {
+        vtkgl::BindFramebufferEXT(vtkgl::FRAMEBUFFER_EXT,
+                                  (GLuint)window_frame_buffer);
+        delegate_pass_->Render(s);
+        NumberOfRenderedProps = delegate_pass_->GetNumberOfRenderedProps();
+        return;
+    }
+
+    glPushAttrib(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_SCISSOR_BIT);
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClearDepth(1.0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glPopAttrib();
+
+    // the camera pass takes the viewport from the frame buffer
+    vtkRenderState scaled_state(renderer);
+    scaled_state.SetPropArrayAndCount(s->GetPropArray(),
+                                      s->GetPropArrayCount());
+    scaled_state.SetRequiredKeys(s->GetRequiredKeys());
+    scaled_state.SetFrameBuffer(frame_buffer_);
+    delegate_pass_->Render(&scaled_state);
+    NumberOfRenderedProps = delegate_pass_->GetNumberOfRenderedProps();
+
+    if(capture_layer_)
+        ReadLayer(s);
+
+    frame_buffer_->UnBind();
+    vtkgl::BindFramebufferEXT(vtkgl::FRAMEBUFFER_EXT,
+                              (GLuint)window_frame_buffer);
+
+    glViewport(x, y, width, height);
+    glScissor(x, y, width, height);
+    DrawTexture();
+}
+
+//------------------------------------------------------------------------------
+void ScaledRenderPass::DrawTexture() const {
+
+    glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT
+                 | GL_CURRENT_BIT);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_TEXTURE_2D);
+    texture_->Bind();
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+    glColor4f(1.f, 1.f, 1.f, 1.f);
+
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.f, 0.f);
+    glVertex2f(-1.f, -1.f);
+    glTexCoord2f(1.f, 0.f);
+    glVertex2f(1.f, -1.f);
+    glTexCoord2f(1.f, 1.f);
+    glVertex2f(1.f, 1.f);
+    glTexCoord2f(0.f, 1.f);
+    glVertex2f(-1.f, 1.f);
+    glEnd();
+
+    texture_->UnBind();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glPopAttrib();
+}
+
+//------------------------------------------------------------------------------
+cv::Rect ScaledRenderPass::GetDirtyRegion(const vtkRenderState *s) const {
+
+    const cv::Rect whole(0, 0, layer_size_.width, layer_size_.height);
+    vtkMatrix4x4 *projection =
+            s->GetRenderer()->GetActiveCamera()
+                    ->GetCompositeProjectionTransformMatrix(
+                            (double)layer_size_.width / layer_size_.height,
+                            -1.0, 1.0);
+
+    // bounds of the corners of the props in normalized device coordinates
+    double min[2] = {1.0, 1.0};
+    double max[2] = {-1.0, -1.0};
+    for (int i = 0; i < s->GetPropArrayCount(); ++i) {
+        vtkProp *prop = s->GetPropArray()[i];
+        if(!prop->GetVisibility())
+            continue;
+        double *bounds = prop->GetBounds();
+        // props without geometry, e.g. 2D overlays, may draw anywhere
+        if(!bounds)
+            return whole;
+        if(bounds[0] > bounds[1])
+            continue;
+        for (int corner = 0; corner < 8; ++corner) {
+            double point[4] = {bounds[corner & 1],
+                               bounds[2 + ((corner >> 1) & 1)],
+                               bounds[4 + ((corner >> 2) & 1)], 1.0};
+            projection->MultiplyPoint(point, point);
+            // behind the camera the projection folds over
+            if(point[3] <= 1e-9)
+                return whole;
+            for (int k = 0; k < 2; ++k) {
+                min[k] = std::min(min[k], point[k] / point[3]);
+                max[k] = std::max(max[k], point[k] / point[3]);
+            }
+        }
+    }
+    if(min[0] > max[0] || min[1] > max[1])
+        return cv::Rect();
+
+    // a margin for the antialiased edges
+    const int margin = 2;
+    const int x0 = (int)std::floor(0.5 * (min[0] + 1.0) * layer_size_.width);
+    const int y0 = (int)std::floor(0.5 * (min[1] + 1.0) * layer_size_.height);
+    const int x1 = (int)std::ceil(0.5 * (max[0] + 1.0) * layer_size_.width);
+    const int y1 = (int)std::ceil(0.5 * (max[1] + 1.0) * layer_size_.height);
+    return cv::Rect(x0 - margin, y0 - margin, x1 - x0 + 2 * margin,
+                    y1 - y0 + 2 * margin) & whole;
+}
+
+//------------------------------------------------------------------------------
+void ScaledRenderPass::ReadLayer(const vtkRenderState *s) {
+
+    std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+
+    const cv::Rect region = GetDirtyRegion(s);
+    layer_region_ = cv::Rect(region.x,
+                             layer_size_.height - region.y - region.height,
+                             region.width, region.height);
+    layer_.create(region.height, region.width, CV_8UC4);
+    if(region.area() > 0) {
+        glPushAttrib(GL_PIXEL_MODE_BIT);
+        glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+        glReadBuffer(vtkgl::COLOR_ATTACHMENT0_EXT);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+        glReadPixels(region.x, region.y, region.width, region.height,
+                     vtkgl::BGRA, GL_UNSIGNED_BYTE, layer_.data);
+        glPopClientAttrib();
+        glPopAttrib();
+    }
+    has_layer_ = true;
+
+    last_readback_time_ = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+//------------------------------------------------------------------------------
+void ScaledRenderPass::ReleaseGraphicsResources(vtkWindow *w) {
+    if(delegate_pass_)
+        delegate_pass_->ReleaseGraphicsResources(w);
+    // freed in the context they were created in
+    frame_buffer_ = NULL;
+    texture_ = NULL;
+    supported_ = -1;
+}
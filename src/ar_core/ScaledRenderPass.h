@@ -0,0 +1,109 @@
+//
+// Renders the virtual scene at a fraction of the window resolution.
+//
+
+#ifndef ATAR_SCALEDRENDERPASS_H
+#define ATAR_SCALEDRENDERPASS_H
+
+#include <opencv2/core/core.hpp>
+#include <vtkRenderPass.h>
+#include <vtkRenderWindow.h>
+#include <vtkSmartPointer.h>
+#include <vtkFrameBufferObject.h>
+#include <vtkTextureObject.h>
+
+/**
+ * \class ScaledRenderPass
+ * \brief Renders its delegate into a texture smaller than the viewport of
+ * the renderer, then stretches the texture over the viewport.
+ *
+ * The texture is cleared to transparent before the delegate renders, so
+ * the background renderer, in the layer below, shows where there is no
+ * virtual object. The colors written by vtk are premultiplied by their
+ * alpha, and the texture is blended as such.
+ *
+ * The size of the viewport is read from the renderer at each Render(), so
+ * the pass also works as the eye pass of a StereoRenderPass. With a scale of
+ * 1, or when frame buffer objects are not supported, the delegate renders
+ * directly in the window.
+ *
+ * With SetCaptureLayer the texture is used at any scale and the part of it
+ * covered by the visible props (their bounds projected on the viewport) is
+ * read back after each Render(). This is the virtual layer alone, without
+ * the camera image, for compositing on the cpu.
+ */
+class ScaledRenderPass : public vtkRenderPass {
+public:
+
+    static ScaledRenderPass *New();
+
+    vtkTypeMacro(ScaledRenderPass, vtkRenderPass);
+
+    void SetDelegatePass(vtkRenderPass *pass) { delegate_pass_ = pass; }
+
+    // Size of the texture relative to the viewport, in (0, 1]
+    void SetScale(const double scale);
+
+    double GetScale() const { return scale_; }
+
+    // Whether the texture can be used in the context of window, which must
+    // have been rendered once
+    static bool IsSupported(vtkRenderWindow *window);
+
+    // Reads the virtual layer back at each Render()
+    void SetCaptureLayer(const bool capture) { capture_layer_ = capture; }
+
+    // Whether the last Render() read the layer back
+    bool HasLayer() const { return has_layer_; }
+
+    // The pixels of the layer in GetLayerRegion(): bgra, bottom row first,
+    // colors premultiplied by alpha
+    const cv::Mat &GetLayer() const { return layer_; }
+
+    // Part of the layer read back, top row first. Empty if no prop was
+    // visible.
+    const cv::Rect &GetLayerRegion() const { return layer_region_; }
+
+    // Size of the whole layer, the viewport times the scale
+    const cv::Size &GetLayerSize() const { return layer_size_; }
+
+    // Time spent reading the layer back in the last Render() [s]
+    double GetLastReadbackTime() const { return last_readback_time_; }
+
+    void Render(const vtkRenderState *s);
+
+    void ReleaseGraphicsResources(vtkWindow *w);
+
+protected:
+    ScaledRenderPass();
+
+    ~ScaledRenderPass() {}
+
+private:
+    ScaledRenderPass(const ScaledRenderPass &);  // Not implemented
+    void operator=(const ScaledRenderPass &);  // Not implemented
+
+    // Draws the texture over the current viewport
+    void DrawTexture() const;
+
+    // Region of the texture covered by the props of s, bottom row first
+    cv::Rect GetDirtyRegion(const vtkRenderState *s) const;
+
+    // Reads the dirty region of the frame buffer, which must be bound
+    void ReadLayer(const vtkRenderState *s);
+
+    vtkSmartPointer<vtkRenderPass> delegate_pass_;
+    double scale_;
+    // -1 until checked in the context
+    int supported_;
+    vtkSmartPointer<vtkFrameBufferObject> frame_buffer_;
+    vtkSmartPointer<vtkTextureObject> texture_;
+    bool capture_layer_;
+    bool has_layer_;
+    cv::Mat layer_;
+    cv::Rect layer_region_;
+    cv::Size layer_size_;
+    double last_readback_time_;
+};
+
+#endif //ATAR_SCALEDRENDERPASS_H
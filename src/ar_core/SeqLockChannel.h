@@ -0,0 +1,117 @@
+//
+// Lock-free exchange of small values (tool poses, gripper positions)
+// between the ROS callbacks, the haptics thread and the render thread.
+//
+
+#ifndef ATAR_SEQLOCKCHANNEL_H
+#define ATAR_SEQLOCKCHANNEL_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <ros/time.h>
+#include <kdl/frames.hpp>
+
+/**
+ * \class SeqLockChannel
+ * \brief Single-writer, multi-reader sequence lock holding the latest sample
+ * of a value and its time stamp.
+ *
+ * The writer never blocks: it makes the sequence odd, stores the words of
+ * the value and makes the sequence even again. Readers copy the words and
+ * retry if the sequence was odd or changed in the meantime, so a reader can
+ * never see half of an old pose and half of a new one. The copies go through
+ * atomic words so there is no data race in the C++ sense.
+ *
+ * T must be made only of plain data (e.g. KDL::Frame, double) and its size
+ * a multiple of 8 bytes.
+ */
+template <typename T>
+class SeqLockChannel {
+public:
+
+    // Until the first write the readers get a default constructed value
+    // (identity for KDL::Frame).
+    SeqLockChannel() : sequence_(0), stamp_(0) {
+        const T initial = T();
+        uint64_t buffer[kNumWords];
+        std::memcpy(buffer, static_cast<const void *>(&initial), sizeof(T));
+        for (size_t i = 0; i < kNumWords; ++i)
+            words_[i].store(buffer[i], std::memory_order_relaxed);
+    }
+
+    // Only one thread may write a channel.
+    void Write(const T &value, const ros::Time &stamp) {
+
+        uint64_t buffer[kNumWords];
+        std::memcpy(buffer, static_cast<const void *>(&value), sizeof(T));
+
+        const uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < kNumWords; ++i)
+            words_[i].store(buffer[i], std::memory_order_relaxed);
+        stamp_.store(stamp.toNSec(), std::memory_order_relaxed);
+
+        sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Copies the latest sample. Returns false if nothing was written yet
+    // (value is then the default constructed value).
+    bool Read(T &value, ros::Time *stamp = NULL) const {
+
+        uint64_t buffer[kNumWords];
+        uint64_t stamp_nsec;
+        uint64_t before, after;
+
+        do {
+            before = sequence_.load(std::memory_order_acquire);
+            if (before & 1) {
+                // the writer is in the middle of an update
+                std::this_thread::yield();
+                continue;
+            }
+            for (size_t i = 0; i < kNumWords; ++i)
+                buffer[i] = words_[i].load(std::memory_order_relaxed);
+            stamp_nsec = stamp_.load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence_.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        std::memcpy(static_cast<void *>(&value), buffer, sizeof(T));
+        if (stamp)
+            stamp->fromNSec(stamp_nsec);
+
+        return after != 0;
+    }
+
+    // Convenience for the readers that do not need the stamp.
+    T Get() const {
+        T value;
+        Read(value);
+        return value;
+    }
+
+    // Incremented by 2 at each write. A reader can compare it with the value
+    // it saw last time to know if there is a new sample.
+    uint64_t GetSequence() const {
+        return sequence_.load(std::memory_order_acquire);
+    }
+
+private:
+    static_assert(sizeof(T) % sizeof(uint64_t) == 0,
+                  "SeqLockChannel needs a value made of 8 byte words");
+    static const size_t kNumWords = sizeof(T) / sizeof(uint64_t);
+
+    alignas(64) std::atomic<uint64_t> sequence_;
+    std::atomic<uint64_t> words_[kNumWords];
+    std::atomic<uint64_t> stamp_;
+};
+
+typedef SeqLockChannel<KDL::Frame> PoseChannel;
+typedef SeqLockChannel<double> GripperChannel;
+
+#endif //ATAR_SEQLOCKCHANNEL_H
@@ -0,0 +1,188 @@
+//
+// Binary log of the inputs of ar_core, to replay a session without the
+// robot and the cameras.
+//
+
+#include "SessionLog.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdexcept>
+
+namespace {
+const size_t kFileHeaderSize = 2 * sizeof(uint32_t);
+}
+
+const uint32_t SessionRecorder::kMagic;
+const uint32_t SessionRecorder::kVersion;
+
+//------------------------------------------------------------------------------
+SessionRecorder::SessionRecorder(const std::string &file_path,
+                                 const size_t chunk_size)
+        : file_path_(file_path),
+          data_(NULL),
+          capacity_(0),
+          used_(0),
+          chunk_size_(chunk_size)
+{
+    for (int i = 0; i < SR_NUM_TYPES; ++i)
+        records_[i] = 0;
+
+    file_ = open(file_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(file_ < 0)
+        throw std::runtime_error("Could not create the session log file.");
+
+    if(!Map(chunk_size_)) {
+        close(file_);
+        throw std::runtime_error("Could not map the session log file.");
+    }
+
+    uint32_t file_header[2] = {kMagic, kVersion};
+    std::memcpy(data_, file_header, kFileHeaderSize);
+    used_ = kFileHeaderSize;
+
+    ROS_INFO("Recording the session in '%s'", file_path.c_str());
+}
+
+//------------------------------------------------------------------------------
+SessionRecorder::~SessionRecorder() {
+    Close();
+}
+
+//------------------------------------------------------------------------------
+void SessionRecorder::Close() {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(file_ < 0)
+        return;
+
+    if(data_)
+        munmap(data_, capacity_);
+    data_ = NULL;
+
+    if(ftruncate(file_, (off_t)used_) != 0)
+        ROS_ERROR("Could not truncate the session log '%s'",
+                  file_path_.c_str());
+    close(file_);
+    file_ = -1;
+
+    uint64_t images = records_[SR_IMAGE_LEFT] + records_[SR_IMAGE_RIGHT]
+                      + records_[SR_IMAGE_STEREO];
+    uint64_t poses = records_[SR_TOOL_POSE_1] + records_[SR_TOOL_POSE_2];
+    ROS_INFO("Session log '%s' closed: %.1f MB, %lu images, %lu tool poses, "
+                     "%lu control events", file_path_.c_str(), used_ / 1e6,
+             (unsigned long)images, (unsigned long)poses,
+             (unsigned long)records_[SR_CONTROL_EVENT]);
+}
+
+//------------------------------------------------------------------------------
+uint8_t *SessionRecorder::Reserve(const size_t size) {
+
+    if(file_ < 0)
+        return NULL;
+
+    if(used_ + size > capacity_) {
+        size_t chunks = (used_ + size - capacity_) / chunk_size_ + 1;
+        munmap(data_, capacity_);
+        data_ = NULL;
+        if(!Map(capacity_ + chunks * chunk_size_)) {
+            ROS_ERROR("Could not grow the session log, recording stopped.");
+            return NULL;
+        }
+    }
+
+    uint8_t *destination = data_ + used_;
+    used_ += size;
+    return destination;
+}
+
+//------------------------------------------------------------------------------
+bool SessionRecorder::Map(const size_t capacity) {
+
+    if(ftruncate(file_, (off_t)capacity) != 0)
+        return false;
+
+    void *data = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      file_, 0);
+    if(data == MAP_FAILED)
+        return false;
+
+    data_ = static_cast<uint8_t *>(data);
+    capacity_ = capacity;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+SessionReader::SessionReader(const std::string &file_path)
+        : data_(NULL), size_(0), position_(kFileHeaderSize)
+{
+    file_ = open(file_path.c_str(), O_RDONLY);
+    if(file_ < 0)
+        throw std::runtime_error("Could not open the session log file.");
+
+    struct stat file_stat;
+    if(fstat(file_, &file_stat) != 0
+       || (size_t)file_stat.st_size < kFileHeaderSize) {
+        close(file_);
+        throw std::runtime_error("The session log file is empty.");
+    }
+    size_ = (size_t)file_stat.st_size;
+
+    void *data = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, file_, 0);
+    if(data == MAP_FAILED) {
+        close(file_);
+        throw std::runtime_error("Could not map the session log file.");
+    }
+    data_ = static_cast<const uint8_t *>(data);
+    // the records are read in order
+    madvise(const_cast<uint8_t *>(data_), size_, MADV_SEQUENTIAL);
+
+    uint32_t file_header[2];
+    std::memcpy(file_header, data_, kFileHeaderSize);
+    if(file_header[0] != SessionRecorder::kMagic
+       || file_header[1] != SessionRecorder::kVersion) {
+        munmap(const_cast<uint8_t *>(data_), size_);
+        close(file_);
+        throw std::runtime_error("Not a session log or unsupported version.");
+    }
+}
+
+//------------------------------------------------------------------------------
+SessionReader::~SessionReader() {
+    munmap(const_cast<uint8_t *>(data_), size_);
+    close(file_);
+}
+
+//------------------------------------------------------------------------------
+bool SessionReader::Next(Record &record) {
+
+    if(position_ + sizeof(SessionRecordHeader) > size_)
+        return false;
+
+    std::memcpy(&record.header, data_ + position_, sizeof(record.header));
+    // a log that was not closed keeps the zero filled tail of its last
+    // chunk. No record is empty or received at time zero.
+    if(record.header.size == 0 || record.header.receive_time == 0) {
+        ROS_WARN("Session log not closed, it ends at byte %lu",
+                 (unsigned long)position_);
+        position_ = size_;
+        return false;
+    }
+    if(record.header.type >= SR_NUM_TYPES
+       || position_ + sizeof(record.header) + record.header.size > size_) {
+        ROS_WARN("Session log truncated or corrupted at byte %lu",
+                 (unsigned long)position_);
+        position_ = size_;
+        return false;
+    }
+
+    record.payload = data_ + position_ + sizeof(record.header);
+    position_ += sizeof(record.header) + record.header.size;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void SessionReader::Rewind() {
+    position_ = kFileHeaderSize;
+}
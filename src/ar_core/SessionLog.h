@@ -0,0 +1,149 @@
+//
+// Binary log of the inputs of ar_core, to replay a session without the
+// robot and the cameras.
+//
+
+#ifndef ATAR_SESSIONLOG_H
+#define ATAR_SESSIONLOG_H
+
+#include <mutex>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <ros/ros.h>
+#include <ros/serialization.h>
+#include <boost/make_shared.hpp>
+
+// What a record contains. The payload is the ROS serialization of the
+// message received by the corresponding ARCore callback.
+enum SessionRecordType {
+    SR_IMAGE_LEFT       = 0,    // sensor_msgs::Image
+    SR_IMAGE_RIGHT      = 1,    // sensor_msgs::Image
+    SR_CAM_POSE_LEFT    = 2,    // geometry_msgs::PoseStamped
+    SR_CAM_POSE_RIGHT   = 3,    // geometry_msgs::PoseStamped
+    SR_TOOL_POSE_1      = 4,    // geometry_msgs::PoseStamped
+    SR_TOOL_POSE_2      = 5,    // geometry_msgs::PoseStamped
+    SR_GRIPPER_1        = 6,    // std_msgs::Float32
+    SR_GRIPPER_2        = 7,    // std_msgs::Float32
+    SR_CONTROL_EVENT    = 8,    // std_msgs::Int8
+    SR_IMAGE_STEREO     = 9,    // sensor_msgs::Image, both eyes
+    SR_NUM_TYPES
+};
+
+struct SessionRecordHeader {
+    uint32_t type;
+    // bytes of payload following the header
+    uint32_t size;
+    // when the message was received by ar_core [ns]
+    int64_t receive_time;
+};
+
+/**
+ * \class SessionRecorder
+ * \brief Appends the messages received by ar_core to a memory mapped file.
+ *
+ * The file starts with a magic number and a version and then holds the
+ * records one after the other: a SessionRecordHeader followed by the
+ * serialized message. The file is grown in chunks and mapped in memory, so
+ * recording a message is a memcpy (no write system call in the callbacks
+ * except when a new chunk is needed). Close() truncates the file to its
+ * actual size.
+ *
+ * Record() may be called from several threads.
+ */
+class SessionRecorder {
+public:
+
+    static const uint32_t kMagic = 0x52415441; // "ATAR"
+    static const uint32_t kVersion = 1;
+
+    // Throws std::runtime_error if the file can not be created
+    SessionRecorder(const std::string &file_path,
+                    const size_t chunk_size = 256 << 20);
+
+    ~SessionRecorder();
+
+    template <typename M>
+    void Record(const SessionRecordType type, const M &msg) {
+
+        SessionRecordHeader header;
+        header.type = type;
+        header.size = ros::serialization::serializationLength(msg);
+        header.receive_time = (int64_t)ros::Time::now().toNSec();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint8_t *destination = Reserve(sizeof(header) + header.size);
+        if(!destination)
+            return;
+
+        std::memcpy(destination, &header, sizeof(header));
+        ros::serialization::OStream stream(destination + sizeof(header),
+                                           header.size);
+        ros::serialization::serialize(stream, msg);
+        records_[type]++;
+    }
+
+    // Unmaps and truncates the file. Called by the destructor too.
+    void Close();
+
+    size_t GetSize() const { return used_; }
+
+private:
+    // returns a pointer to size free bytes at the end of the log, growing
+    // the file if needed. NULL if the file could not be grown.
+    uint8_t *Reserve(const size_t size);
+
+    bool Map(const size_t capacity);
+
+    std::mutex mutex_;
+    std::string file_path_;
+    int file_;
+    uint8_t *data_;
+    size_t capacity_;
+    size_t used_;
+    size_t chunk_size_;
+    uint64_t records_[SR_NUM_TYPES];
+};
+
+/**
+ * \class SessionReader
+ * \brief Reads the records of a session log in order.
+ */
+class SessionReader {
+public:
+
+    struct Record {
+        SessionRecordHeader header;
+        const uint8_t *payload;
+    };
+
+    // Throws std::runtime_error if the file is not a session log
+    explicit SessionReader(const std::string &file_path);
+
+    ~SessionReader();
+
+    // Sets record to the next record. Returns false at the end of the log,
+    // including the unwritten tail of a log that was not closed.
+    bool Next(Record &record);
+
+    // Goes back to the first record
+    void Rewind();
+
+    // Throws ros::Exception if the payload is not a valid M
+    template <typename M>
+    static boost::shared_ptr<M> Deserialize(const Record &record) {
+        boost::shared_ptr<M> msg = boost::make_shared<M>();
+        ros::serialization::IStream stream(
+                const_cast<uint8_t *>(record.payload), record.header.size);
+        ros::serialization::deserialize(stream, *msg);
+        return msg;
+    }
+
+private:
+    int file_;
+    const uint8_t *data_;
+    size_t size_;
+    size_t position_;
+};
+
+#endif //ATAR_SESSIONLOG_H
@@ -0,0 +1,87 @@
+//
+// Bakes the shadow maps shared by the scene renderers of one window.
+//
+
+#include "ShadowBakePass.h"
+#include "ChangeTracking.h"
+#include <vtkCameraPass.h>
+#include <vtkLightsPass.h>
+#include <vtkObjectFactory.h>
+#include <vtkOpaquePass.h>
+#include <vtkRenderPassCollection.h>
+#include <vtkRenderState.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderer.h>
+#include <vtkSequencePass.h>
+
+vtkStandardNewMacro(ShadowBakePass);
+
+//------------------------------------------------------------------------------
+ShadowBakePass::ShadowBakePass()
+        : bake_only_on_change_(false),
+          resolution_changed_(false),
+          baked_scene_mtime_(0),
+          num_bakes_(0),
+          num_skipped_(0)
+{
+    // the occluders are drawn from the lights with the opaque geometry only
+    vtkSmartPointer<vtkSequencePass> opaqueSequence =
+            vtkSmartPointer<vtkSequencePass>::New();
+    vtkSmartPointer<vtkRenderPassCollection> passes =
+            vtkSmartPointer<vtkRenderPassCollection>::New();
+    passes->AddItem(vtkSmartPointer<vtkLightsPass>::New());
+    passes->AddItem(vtkSmartPointer<vtkOpaquePass>::New());
+    opaqueSequence->SetPasses(passes);
+
+    vtkSmartPointer<vtkCameraPass> opaqueCameraPass =
+            vtkSmartPointer<vtkCameraPass>::New();
+    opaqueCameraPass->SetDelegatePass(opaqueSequence);
+
+    baker_ = vtkSmartPointer<vtkShadowMapBakerPass>::New();
+    baker_->SetOpaquePass(opaqueCameraPass);
+    baker_->SetResolution(2048);
+    // To cancel self-shadowing.
+    baker_->SetPolygonOffsetFactor(2.4f);
+    baker_->SetPolygonOffsetUnits(5.0f);
+}
+
+//------------------------------------------------------------------------------
+void ShadowBakePass::SetResolution(const unsigned int resolution) {
+    if(resolution == baker_->GetResolution())
+        return;
+    baker_->SetResolution(resolution);
+    // the maps are released in Render(), where the context is current
+    resolution_changed_ = true;
+}
+
+//------------------------------------------------------------------------------
+void ShadowBakePass::Render(const vtkRenderState *s) {
+
+    NumberOfRenderedProps = 0;
+    vtkRenderer *renderer = s->GetRenderer();
+
+    if(resolution_changed_) {
+        baker_->ReleaseGraphicsResources(renderer->GetRenderWindow());
+        resolution_changed_ = false;
+        baked_scene_mtime_ = 0;
+    }
+
+    if(bake_only_on_change_ && baked_scene_mtime_ != 0
+       && ChangeTracking::GetSceneMTime(renderer) <= baked_scene_mtime_) {
+        // the maps and the light cameras of the last bake are still valid
+        ++num_skipped_;
+        return;
+    }
+
+    baker_->Render(s);
+    NumberOfRenderedProps = baker_->GetNumberOfRenderedProps();
+    ++num_bakes_;
+    // after the bake, which updates the inputs of the mappers
+    baked_scene_mtime_ = ChangeTracking::GetSceneMTime(renderer);
+}
+
+//------------------------------------------------------------------------------
+void ShadowBakePass::ReleaseGraphicsResources(vtkWindow *w) {
+    baker_->ReleaseGraphicsResources(w);
+    baked_scene_mtime_ = 0;
+}
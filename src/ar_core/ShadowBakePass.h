@@ -0,0 +1,68 @@
+//
+// Bakes the shadow maps shared by the scene renderers of one window.
+//
+
+#ifndef ATAR_SHADOWBAKEPASS_H
+#define ATAR_SHADOWBAKEPASS_H
+
+#include <vtkRenderPass.h>
+#include <vtkSmartPointer.h>
+#include <vtkShadowMapBakerPass.h>
+
+/**
+ * \class ShadowBakePass
+ * \brief Runs a vtkShadowMapBakerPass, optionally only when the shadows can
+ * have changed.
+ *
+ * The maps only depend on the lights and on the geometry, so in a window
+ * this pass is put in the pipeline of the first scene renderer only and the
+ * vtkShadowMapPass of every renderer of the window uses GetBakerPass(). The
+ * maps are textures of the window's context and can not be shared with
+ * another window.
+ *
+ * With BakeOnlyOnChange the maps are kept as long as no prop, light or
+ * input of a mapper of the renderer was modified since the last bake, which
+ * vtk tracks with the modification times.
+ */
+class ShadowBakePass : public vtkRenderPass {
+public:
+
+    static ShadowBakePass *New();
+
+    vtkTypeMacro(ShadowBakePass, vtkRenderPass);
+
+    vtkShadowMapBakerPass *GetBakerPass() { return baker_; }
+
+    // Size of the maps in pixels. Releases the current maps, the next
+    // Render() bakes new ones.
+    void SetResolution(const unsigned int resolution);
+
+    void SetBakeOnlyOnChange(const bool on) { bake_only_on_change_ = on; }
+
+    void Render(const vtkRenderState *s);
+
+    void ReleaseGraphicsResources(vtkWindow *w);
+
+    unsigned long GetNumberOfBakes() const { return num_bakes_; }
+
+    unsigned long GetNumberOfSkippedBakes() const { return num_skipped_; }
+
+protected:
+    ShadowBakePass();
+
+    ~ShadowBakePass() {}
+
+private:
+    ShadowBakePass(const ShadowBakePass &);  // Not implemented
+    void operator=(const ShadowBakePass &);  // Not implemented
+
+    vtkSmartPointer<vtkShadowMapBakerPass> baker_;
+    bool bake_only_on_change_;
+    bool resolution_changed_;
+    // 0 when the maps must be baked whatever the scene
+    unsigned long baked_scene_mtime_;
+    unsigned long num_bakes_;
+    unsigned long num_skipped_;
+};
+
+#endif //ATAR_SHADOWBAKEPASS_H
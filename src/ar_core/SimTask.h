@@ -15,6 +15,7 @@
 #include <custom_msgs/ActiveConstraintParameters.h>
 #include <kdl/frames.hpp>
 #include <btBulletDynamicsCommon.h>
+#include "SeqLockChannel.h"
 
 
 //note about vtkSmartPointer:
@@ -45,19 +46,23 @@ public:
     // steps the physics simulation
     virtual void StepPhysics() {};
 
-    // This is the function that is handled by the haptics thread.
+    // This is the function that is handled by the haptics thread. The ROS
+    // callbacks of ARCore run on their own spinners, so this thread must not
+    // call ros::spinOnce().
     virtual void HapticsThread() = 0;
 
     // returns all the task graphics_actors to be sent to the rendering part
     virtual std::vector< vtkSmartPointer <vtkProp> >GetActors() {return graphics_actors;};
 
-    // sets the pose of the tools
-    virtual void SetCurrentToolPosePointer(KDL::Frame &tool_pose, const int
-    tool_id) {};
+    // sets the channel through which the pose of the tools is received.
+    // The channel is written by the ROS callbacks and can be read from any
+    // thread.
+    virtual void SetCurrentToolPoseChannel(const PoseChannel *tool_pose,
+                                           const int tool_id) {};
 
-    // sets the position of the gripper
-    virtual void SetCurrentGripperpositionPointer(double &gripper_position, const int
-    tool_id) {};
+    // sets the channel through which the position of the gripper is received
+    virtual void SetCurrentGripperPositionChannel(
+            const GripperChannel *gripper_position, const int tool_id) {};
 
     // returns the status of the task
     virtual custom_msgs::TaskState GetTaskStateMsg() = 0;
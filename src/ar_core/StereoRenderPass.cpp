@@ -0,0 +1,66 @@
+//
+// Renders both eyes with one renderer.
+//
+
+#include "StereoRenderPass.h"
+#include <vtkRenderer.h>
+#include <vtkRenderState.h>
+#include <vtkObjectFactory.h>
+
+vtkStandardNewMacro(StereoRenderPass);
+
+//------------------------------------------------------------------------------
+StereoRenderPass::StereoRenderPass() {
+    // left and right halves of the window by default
+    const double viewports[2][4] = {{0.0, 0.0, 0.5, 1.0},
+                                    {0.5, 0.0, 1.0, 1.0}};
+    for (int eye = 0; eye < 2; ++eye)
+        for (int k = 0; k < 4; ++k)
+            viewports_[eye][k] = viewports[eye][k];
+}
+
+//------------------------------------------------------------------------------
+void StereoRenderPass::SetEye(const int eye, vtkCamera *camera,
+                              const double viewport[4]) {
+    if(eye < 0 || eye > 1)
+        return;
+    cameras_[eye] = camera;
+    for (int k = 0; k < 4; ++k)
+        viewports_[eye][k] = viewport[k];
+}
+
+//------------------------------------------------------------------------------
+void StereoRenderPass::Render(const vtkRenderState *s) {
+
+    NumberOfRenderedProps = 0;
+    if(!eye_pass_ || !cameras_[0] || !cameras_[1])
+        return;
+
+    vtkRenderer *renderer = s->GetRenderer();
+    vtkSmartPointer<vtkCamera> renderer_camera = renderer->GetActiveCamera();
+    double renderer_viewport[4];
+    renderer->GetViewport(renderer_viewport);
+
+    if(shadow_bake_pass_) {
+        shadow_bake_pass_->Render(s);
+        NumberOfRenderedProps += shadow_bake_pass_->GetNumberOfRenderedProps();
+    }
+
+    for (int eye = 0; eye < 2; ++eye) {
+        renderer->SetViewport(viewports_[eye]);
+        renderer->SetActiveCamera(cameras_[eye]);
+        eye_pass_->Render(s);
+        NumberOfRenderedProps += eye_pass_->GetNumberOfRenderedProps();
+    }
+
+    renderer->SetViewport(renderer_viewport);
+    renderer->SetActiveCamera(renderer_camera);
+}
+
+//------------------------------------------------------------------------------
+void StereoRenderPass::ReleaseGraphicsResources(vtkWindow *w) {
+    if(shadow_bake_pass_)
+        shadow_bake_pass_->ReleaseGraphicsResources(w);
+    if(eye_pass_)
+        eye_pass_->ReleaseGraphicsResources(w);
+}
@@ -0,0 +1,61 @@
+//
+// Renders both eyes with one renderer.
+//
+
+#ifndef ATAR_STEREORENDERPASS_H
+#define ATAR_STEREORENDERPASS_H
+
+#include <vtkRenderPass.h>
+#include <vtkSmartPointer.h>
+#include <vtkCamera.h>
+
+/**
+ * \class StereoRenderPass
+ * \brief Draws the props of one renderer for the left and the right eye,
+ * each in its own viewport of the window.
+ *
+ * Compared to one renderer per eye, the props are gathered once, the
+ * renderer's state is set up once and the shadow maps, which depend on the
+ * lights and the geometry but not on the eye, are baked once per frame.
+ * For each eye the pass sets the viewport and the camera of the eye on the
+ * renderer and runs the eye pass, normally a vtkCameraPass over the usual
+ * sequence of passes. The viewport and the camera of the renderer are
+ * restored afterwards.
+ */
+class StereoRenderPass : public vtkRenderPass {
+public:
+
+    static StereoRenderPass *New();
+
+    vtkTypeMacro(StereoRenderPass, vtkRenderPass);
+
+    // eye: 0 left, 1 right. viewport: xmin, ymin, xmax, ymax in the window
+    void SetEye(const int eye, vtkCamera *camera, const double viewport[4]);
+
+    // The pass rendering the scene for one eye
+    void SetEyePass(vtkRenderPass *pass) { eye_pass_ = pass; }
+
+    // Rendered once before the eyes, the bake of the shadow maps used by
+    // the eye pass. NULL without shadows.
+    void SetShadowBakePass(vtkRenderPass *pass) { shadow_bake_pass_ = pass; }
+
+    void Render(const vtkRenderState *s);
+
+    void ReleaseGraphicsResources(vtkWindow *w);
+
+protected:
+    StereoRenderPass();
+
+    ~StereoRenderPass() {}
+
+private:
+    StereoRenderPass(const StereoRenderPass &);  // Not implemented
+    void operator=(const StereoRenderPass &);  // Not implemented
+
+    vtkSmartPointer<vtkRenderPass> eye_pass_;
+    vtkSmartPointer<vtkRenderPass> shadow_bake_pass_;
+    vtkSmartPointer<vtkCamera> cameras_[2];
+    double viewports_[2][4];
+};
+
+#endif //ATAR_STEREORENDERPASS_H
@@ -0,0 +1,113 @@
+//
+// Pairs left and right camera images by their header stamps.
+//
+
+#include "StereoSynchronizer.h"
+#include <cmath>
+
+//------------------------------------------------------------------------------
+StereoSynchronizer::StereoSynchronizer(const double tolerance,
+                                       const size_t queue_size)
+        : tolerance_(tolerance),
+          queue_size_(queue_size < 1 ? 1 : queue_size)
+{
+}
+
+//------------------------------------------------------------------------------
+bool StereoSynchronizer::Push(const cv_bridge::CvImageConstPtr &image,
+                              const int cam_id) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::deque<cv_bridge::CvImageConstPtr> &queue = queues_[cam_id];
+    queue.push_back(image);
+    if(queue.size() > queue_size_) {
+        queue.pop_front();
+        statistics_.dropped[cam_id]++;
+    }
+
+    // look for the newest pair. The queues are ordered by arrival, which
+    // is assumed to be the order of the stamps.
+    int match[2] = {-1, -1};
+    double match_skew = 0.0;
+    for (int l = (int)queues_[0].size() - 1; l >= 0 && match[0] < 0; --l) {
+        const ros::Time &stamp_left = queues_[0][l]->header.stamp;
+
+        for (int r = (int)queues_[1].size() - 1; r >= 0; --r) {
+            double skew =
+                    (queues_[1][r]->header.stamp - stamp_left).toSec();
+            if (std::fabs(skew) <= tolerance_) {
+                match[0] = l;
+                match[1] = r;
+                match_skew = skew;
+                break;
+            }
+            // the right images are getting older than the left one
+            if (skew < -tolerance_)
+                break;
+        }
+    }
+
+    // keep the queues depth up to date even if nothing matched
+    if(match[0] < 0) {
+        statistics_.queue_depth[0] = queues_[0].size();
+        statistics_.queue_depth[1] = queues_[1].size();
+        return false;
+    }
+
+    StereoFrame pair;
+    pair.image[0] = queues_[0][match[0]];
+    pair.image[1] = queues_[1][match[1]];
+    pair.skew = match_skew;
+
+    // whatever is older than the matched images will never be shown
+    for (int k = 0; k < 2; ++k) {
+        statistics_.dropped[k] += (uint64_t)match[k];
+        queues_[k].erase(queues_[k].begin(),
+                         queues_[k].begin() + match[k] + 1);
+        statistics_.queue_depth[k] = queues_[k].size();
+    }
+
+    if(pairs_.HasNewData())
+        statistics_.overwritten_pairs++;
+    pairs_.Write(pair);
+
+    statistics_.matched_pairs++;
+    statistics_.last_skew = match_skew;
+    if(std::fabs(match_skew) > statistics_.max_skew)
+        statistics_.max_skew = std::fabs(match_skew);
+
+    pair_ready_.notify_one();
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool StereoSynchronizer::GetNewPair(StereoFrame &pair) {
+
+    if(!pairs_.Update())
+        return false;
+
+    pair = pairs_.Read();
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool StereoSynchronizer::WaitForNewPair(
+        const std::chrono::steady_clock::duration timeout) {
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    return pair_ready_.wait_for(lock, timeout,
+                                [this] { return pairs_.HasNewData(); });
+}
+
+//------------------------------------------------------------------------------
+void StereoSynchronizer::SetTolerance(const double tolerance) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tolerance_ = tolerance;
+}
+
+//------------------------------------------------------------------------------
+StereoSynchronizer::Statistics StereoSynchronizer::GetStatistics() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return statistics_;
+}
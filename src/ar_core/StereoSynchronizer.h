@@ -0,0 +1,93 @@
+//
+// Pairs left and right camera images by their header stamps.
+//
+
+#ifndef ATAR_STEREOSYNCHRONIZER_H
+#define ATAR_STEREOSYNCHRONIZER_H
+
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <cv_bridge/cv_bridge.h>
+#include "TripleBuffer.h"
+
+/**
+ * \brief A left and right image that were taken at the same time (within
+ * the tolerance of the synchronizer).
+ */
+struct StereoFrame {
+    cv_bridge::CvImageConstPtr image[2];
+    // right stamp minus left stamp in seconds
+    double skew = 0.0;
+};
+
+/**
+ * \class StereoSynchronizer
+ * \brief Matches the images of the two cameras by header.stamp.
+ *
+ * The image callbacks push the images in a short queue per camera. Every
+ * time an image arrives the newest left/right couple whose stamps differ
+ * less than the tolerance is searched. When found, it is handed to the
+ * render loop through a triple buffer and all the older images of both
+ * queues are dropped, since showing them would only add latency. Images
+ * that never find their pair are dropped the same way, or when the queue is
+ * full. If the render loop does not take a pair before the next one is
+ * matched the older pair is overwritten and counted too.
+ *
+ * Push() may be called from the callback threads. GetNewPair() is lock-free
+ * and must be called from one thread only. The render loop takes the mutex
+ * only when it has nothing to do and blocks in WaitForNewPair().
+ */
+class StereoSynchronizer {
+public:
+
+    struct Statistics {
+        // skew of the last matched pair and the largest one seen [s]
+        double last_skew        = 0.0;
+        double max_skew         = 0.0;
+        uint64_t matched_pairs  = 0;
+        // images discarded without being paired, per camera
+        uint64_t dropped[2]     = {0, 0};
+        // matched pairs overwritten before the render loop took them
+        uint64_t overwritten_pairs = 0;
+        // images currently waiting for their pair, per camera
+        size_t queue_depth[2]   = {0, 0};
+    };
+
+    StereoSynchronizer(const double tolerance = 0.015,
+                       const size_t queue_size = 4);
+
+    // Adds an image of camera cam_id (0 left, 1 right) and publishes the
+    // newest matching pair, if any. Returns true if a pair was published.
+    bool Push(const cv_bridge::CvImageConstPtr &image, const int cam_id);
+
+    // Returns true and sets pair if a pair arrived since the last call. The
+    // images of the pair are shared, not copied.
+    bool GetNewPair(StereoFrame &pair);
+
+    // True if a pair is ready to be taken by GetNewPair.
+    bool HasNewPair() const { return pairs_.HasNewData(); }
+
+    // Blocks until a new pair is ready or the timeout expires. Returns
+    // HasNewPair().
+    bool WaitForNewPair(const std::chrono::steady_clock::duration timeout);
+
+    void SetTolerance(const double tolerance);
+
+    Statistics GetStatistics();
+
+private:
+
+    double tolerance_;
+    size_t queue_size_;
+
+    std::mutex mutex_;
+    std::condition_variable pair_ready_;
+    std::deque<cv_bridge::CvImageConstPtr> queues_[2];
+    Statistics statistics_;
+
+    TripleBuffer<StereoFrame> pairs_;
+};
+
+#endif //ATAR_STEREOSYNCHRONIZER_H
@@ -0,0 +1,80 @@
+//
+// Lock-free single-producer/single-consumer triple buffer.
+//
+
+#ifndef ATAR_TRIPLEBUFFER_H
+#define ATAR_TRIPLEBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * \class TripleBuffer
+ * \brief Hands the latest value from one writer thread to one reader thread
+ * without locks and without copying the payload.
+ *
+ * There are three slots: the writer owns one (back), the reader owns one
+ * (front) and the third one (middle) is swapped atomically between them.
+ * The writer never waits for the reader and the reader always gets the most
+ * recent value that was published. Intermediate values are overwritten on
+ * purpose. T is meant to be a cheap handle (e.g. a shared pointer to a ROS
+ * message) so that writing a slot does not copy image data.
+ */
+template <typename T>
+class TripleBuffer {
+public:
+
+    TripleBuffer()
+            : middle_(kInitialMiddle), front_(0), back_(1) {};
+
+    // Writer side: store the value in the back slot and publish it.
+    void Write(const T &value) {
+        slots_[back_] = value;
+        Publish();
+    }
+
+    // Writer side: direct access to the back slot, for writers that fill
+    // the slot in place. Call Publish() when done.
+    T &WriteSlot() { return slots_[back_]; }
+
+    void Publish() {
+        const uint8_t previous = middle_.exchange(
+                (uint8_t)(back_ | kDirtyBit), std::memory_order_acq_rel);
+        back_ = (uint8_t)(previous & kIndexMask);
+    }
+
+    // Reader side: swap in the latest published value if there is one.
+    // Returns true if the front slot changed.
+    bool Update() {
+        if ((middle_.load(std::memory_order_acquire) & kDirtyBit) == 0)
+            return false;
+        const uint8_t previous = middle_.exchange(
+                front_, std::memory_order_acq_rel);
+        front_ = (uint8_t)(previous & kIndexMask);
+        return true;
+    }
+
+    // Reader side: the value swapped in by the last Update(). It stays
+    // valid until the next call to Update().
+    const T &Read() const { return slots_[front_]; }
+
+    // True if the writer published something the reader has not consumed.
+    bool HasNewData() const {
+        return (middle_.load(std::memory_order_acquire) & kDirtyBit) != 0;
+    }
+
+private:
+    static const uint8_t kIndexMask     = 0x03;
+    static const uint8_t kDirtyBit      = 0x04;
+    static const uint8_t kInitialMiddle = 2;
+
+    T slots_[3];
+    // index of the middle slot and the dirty flag, shared by both threads
+    alignas(64) std::atomic<uint8_t> middle_;
+    // owned by the reader
+    alignas(64) uint8_t front_;
+    // owned by the writer
+    alignas(64) uint8_t back_;
+};
+
+#endif //ATAR_TRIPLEBUFFER_H
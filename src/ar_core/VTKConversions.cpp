@@ -43,6 +43,24 @@ void ::VTKConversions::KDLFrameToVTKMatrix(const KDL::Frame in,
 }
 
 
+//------------------------------------------------------------------------------
+bool VTKConversions::KDLFrameToVTKMatrixIfChanged(const KDL::Frame &in,
+                                                  vtkMatrix4x4 *out) {
+
+    bool changed = false;
+    for (int i = 0; i < 3 && !changed; i++) {
+        for (int j = 0; j < 3; j++)
+            changed |= out->GetElement(i, j) != in.M(i, j);
+        changed |= out->GetElement(i, 3) != in.p[i];
+    }
+    if(!changed)
+        return false;
+
+    KDLFrameToVTKMatrix(in, out);
+    return true;
+}
+
+
 //------------------------------------------------------------------------------
 void VTKConversions::VTKMatrixToKDLFrame(const vtkSmartPointer<vtkMatrix4x4> in,
                                          KDL::Frame & out) {
@@ -18,6 +18,13 @@ namespace VTKConversions{
     void KDLFrameToVTKMatrix (const KDL::Frame in,
                                vtkSmartPointer<vtkMatrix4x4> out);
 
+    // Same as KDLFrameToVTKMatrix, but out is left untouched, and not
+    // marked modified, if it already holds in. The actors using out as user
+    // matrix then only look changed when the pose changed. Returns true if
+    // out was modified.
+    bool KDLFrameToVTKMatrixIfChanged(const KDL::Frame &in,
+                                      vtkMatrix4x4 *out);
+
     void VTKMatrixToKDLFrame(const vtkSmartPointer<vtkMatrix4x4> in,
                                                KDL::Frame  & out);
 
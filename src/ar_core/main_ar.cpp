@@ -11,13 +11,12 @@ int main(int argc, char **argv)
     ros::init(argc, argv, "ar_core");
     ARCore acore (ros::this_node::getName());
 
-    ros::Rate loop_rate(30);
-
     while (ros::ok())
     {
+        // the frame scheduler decides when the next frame is due
+        acore.WaitForNextFrame();
         if(!acore.UpdateWorld())
             break;
-        loop_rate.sleep();
     }
 
     ros::shutdown();
@@ -0,0 +1,235 @@
+//
+// Replays a session recorded by ar_core (record_session_file parameter)
+// through ARCore and reports the timings of the frame stages.
+//
+// usage: rosrun atar ar_replay <session_log> [--realtime]
+//
+// The node takes the name and the parameters of ar_core, so the same launch
+// file can be used with the cameras and the arms nodes removed. Without
+// --realtime the messages are fed as fast as the render loop consumes the
+// stereo pairs, so two builds can be compared on exactly the same frames.
+// The record_session_file parameter is ignored: a replay is never recorded.
+//
+
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <cstdio>
+#include "ros/ros.h"
+#include "ARCore.h"
+#include "ControlEvents.h"
+
+typedef std::chrono::steady_clock Clock;
+
+//------------------------------------------------------------------------------
+// Moves the stamp of the message to the replay time. The same offset is
+// applied to all the messages, so the intervals between the stamps and the
+// delays of the messages are the ones of the recording.
+template <typename M>
+boost::shared_ptr<M> Restamp(const boost::shared_ptr<M> &msg,
+                             const ros::Duration &offset) {
+    msg->header.stamp += offset;
+    return msg;
+}
+
+//------------------------------------------------------------------------------
+// Returns false after the exit event: the render thread then cleans ARCore
+// up and no other message may be passed to it.
+bool Dispatch(ARCore &acore, const SessionReader::Record &record,
+              const ros::Duration &offset) {
+
+    switch (record.header.type) {
+        case SR_IMAGE_LEFT:
+            acore.ImageLeftCallback(Restamp(
+                    SessionReader::Deserialize<sensor_msgs::Image>(record),
+                    offset));
+            break;
+        case SR_IMAGE_RIGHT:
+            acore.ImageRightCallback(Restamp(
+                    SessionReader::Deserialize<sensor_msgs::Image>(record),
+                    offset));
+            break;
+        case SR_IMAGE_STEREO:
+            acore.ImageStereoCallback(Restamp(
+                    SessionReader::Deserialize<sensor_msgs::Image>(record),
+                    offset));
+            break;
+        case SR_CAM_POSE_LEFT:
+            acore.LeftCamPoseCallback(Restamp(
+                    SessionReader::Deserialize<geometry_msgs::PoseStamped>(
+                            record), offset));
+            break;
+        case SR_CAM_POSE_RIGHT:
+            acore.RightCamPoseCallback(Restamp(
+                    SessionReader::Deserialize<geometry_msgs::PoseStamped>(
+                            record), offset));
+            break;
+        case SR_TOOL_POSE_1:
+            acore.Tool1PoseCurrentCallback(Restamp(
+                    SessionReader::Deserialize<geometry_msgs::PoseStamped>(
+                            record), offset));
+            break;
+        case SR_TOOL_POSE_2:
+            acore.Tool2PoseCurrentCallback(Restamp(
+                    SessionReader::Deserialize<geometry_msgs::PoseStamped>(
+                            record), offset));
+            break;
+        case SR_GRIPPER_1:
+            acore.Tool1GripperCurrentCallback(
+                    SessionReader::Deserialize<std_msgs::Float32>(record));
+            break;
+        case SR_GRIPPER_2:
+            acore.Tool2GripperCurrentCallback(
+                    SessionReader::Deserialize<std_msgs::Float32>(record));
+            break;
+        case SR_CONTROL_EVENT: {
+            std_msgs::Int8::Ptr event =
+                    SessionReader::Deserialize<std_msgs::Int8>(record);
+            acore.ControlEventsCallback(event);
+            if (event->data == CE_EXIT)
+                return false;
+            break;
+        }
+        default:
+            break;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Waits until the render loop took the last stereo pair
+void WaitForImagesConsumed(ARCore &acore,
+                           const std::atomic<bool> &render_loop_running) {
+    while (acore.HasNewImages() && render_loop_running && ros::ok())
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+
+//------------------------------------------------------------------------------
+void FeedSession(SessionReader &reader, ARCore &acore, const bool real_time,
+                 const std::atomic<bool> &render_loop_running,
+                 uint64_t &num_records) {
+
+    SessionReader::Record record;
+    Clock::time_point start = Clock::now();
+    bool exit_dispatched = false;
+    int64_t first_receive_time = -1;
+    // from the recording time to the replay time
+    ros::Duration offset;
+    num_records = 0;
+
+    while (render_loop_running && ros::ok() && reader.Next(record)) {
+
+        if (first_receive_time < 0) {
+            first_receive_time = record.header.receive_time;
+            ros::Time first_received;
+            first_received.fromNSec((uint64_t)first_receive_time);
+            offset = ros::Time::now() - first_received;
+        }
+
+        if (real_time)
+            std::this_thread::sleep_until(
+                    start + std::chrono::nanoseconds(
+                            record.header.receive_time - first_receive_time));
+        else if (record.header.type == SR_IMAGE_LEFT
+                 || record.header.type == SR_IMAGE_RIGHT
+                 || record.header.type == SR_IMAGE_STEREO)
+            // one pair per frame, none is overwritten
+            WaitForImagesConsumed(acore, render_loop_running);
+
+        try {
+            exit_dispatched = !Dispatch(acore, record, offset);
+        }
+        catch (ros::Exception &e) {
+            ROS_ERROR("Record %lu of the session log can not be read, the "
+                              "replay stops here: %s",
+                      (unsigned long)num_records, e.what());
+            break;
+        }
+        num_records++;
+        if (exit_dispatched) {
+            ROS_INFO("Exit event recorded, the replay stops here.");
+            return;
+        }
+    }
+
+    // let the last frame be rendered and stop the render loop
+    WaitForImagesConsumed(acore, render_loop_running);
+    std_msgs::Int8::Ptr exit_event(new std_msgs::Int8);
+    exit_event->data = CE_EXIT;
+    acore.ControlEventsCallback(exit_event);
+}
+
+//------------------------------------------------------------------------------
+void PrintReport(const std::vector<LatencyHistogram> &histograms,
+                 const double elapsed, const uint64_t num_records) {
+
+    const LatencyHistogram &render = histograms[LatencyTracer::RENDER];
+    printf("\nReplayed %lu messages in %.2f s, %lu frames rendered "
+                   "(%.1f fps)\n\n", (unsigned long)num_records, elapsed,
+           (unsigned long)render.GetCount(),
+           elapsed > 0 ? render.GetCount() / elapsed : 0.0);
+
+    printf("%-20s %8s %9s %9s %9s %9s %9s\n", "stage [ms]", "count", "mean",
+           "p50", "p95", "p99", "max");
+    for (int i = 0; i < LatencyTracer::NUM_STAGES; ++i) {
+        const LatencyHistogram &h = histograms[i];
+        printf("%-20s %8lu %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+               LatencyTracer::GetStageName((LatencyTracer::Stage) i),
+               (unsigned long)h.GetCount(), h.GetMean() * 1000.0,
+               h.GetPercentile(0.5) * 1000.0, h.GetPercentile(0.95) * 1000.0,
+               h.GetPercentile(0.99) * 1000.0, h.GetMax() * 1000.0);
+    }
+}
+
+//------------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "ar_core");
+
+    if (argc < 2) {
+        printf("usage: %s <session_log> [--realtime]\n", argv[0]);
+        return 1;
+    }
+    bool real_time = argc > 2 && std::string(argv[2]) == "--realtime";
+
+    SessionReader reader(argv[1]);
+    ROS_INFO("Replaying '%s' %s", argv[1],
+             real_time ? "in real time" : "as fast as possible");
+
+    // recording would truncate the log being read if it is the same file,
+    // or overwrite the previous recording otherwise
+    ros::NodeHandle node_handle(ros::this_node::getName());
+    std::string record_session_file;
+    if (node_handle.getParam("record_session_file", record_session_file)
+        && !record_session_file.empty()) {
+        ROS_WARN("record_session_file '%s' is ignored during a replay.",
+                 record_session_file.c_str());
+        node_handle.setParam("record_session_file", std::string());
+    }
+
+    ARCore acore(node_handle);
+
+    uint64_t num_records = 0;
+    std::atomic<bool> render_loop_running(true);
+    Clock::time_point start = Clock::now();
+    std::thread feeder(FeedSession, std::ref(reader), std::ref(acore),
+                       real_time, std::cref(render_loop_running),
+                       std::ref(num_records));
+
+    while (ros::ok())
+    {
+        acore.WaitForNextFrame();
+        if(!acore.UpdateWorld())
+            break;
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start)
+            .count();
+
+    render_loop_running = false;
+    feeder.join();
+
+    PrintReport(acore.GetSessionLatencies(), elapsed, num_records);
+
+    ros::shutdown();
+    return 0;
+}
@@ -144,16 +144,16 @@ Task3D::Task3D(const std::string mesh_files_dir,
 }
 
 //------------------------------------------------------------------------------
-void Task3D::SetCurrentToolPosePointer(KDL::Frame &tool_pose,
-                                       const int tool_id) {
+void Task3D::SetCurrentToolPoseChannel(
+        const PoseChannel *tool_pose, const int tool_id) {
 
-    tool_current_pose_kdl[tool_id] = &tool_pose;
+    tool_current_pose_kdl[tool_id] = tool_pose;
 
 }
 
-void Task3D::SetCurrentGripperpositionPointer(double &grip_position, const int
-tool_id) {
-    gripper_position[tool_id] = &grip_position;
+void Task3D::SetCurrentGripperPositionChannel(
+        const GripperChannel *grip_position, const int tool_id) {
+    gripper_position[tool_id] = grip_position;
 };
 
 //------------------------------------------------------------------------------
@@ -161,7 +161,7 @@ void Task3D::StepWorld() {
 
     //-----------------POINTER: update position on the upper plane
 
-    KDL::Frame tool_pose = (*tool_current_pose_kdl[0]);
+    KDL::Frame tool_pose = tool_current_pose_kdl[0]->Get();
 
     pointer_posit = tool_pose * KDL::Vector( -0.0, -0.0, -0.03+0.01);
     KDL::Rotation _rot;
@@ -384,7 +384,6 @@ void Task3D::HapticsThread() {
 //            pub_desired[n_arm].publish(pose_msg);
 //        }
 
-        ros::spinOnce();
         loop_rate.sleep();
         boost::this_thread::interruption_point();
     }
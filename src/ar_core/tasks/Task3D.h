@@ -56,11 +56,12 @@ public:
         return graphics_actors;
     }
     // sets the pose of the tools
-    void SetCurrentToolPosePointer(KDL::Frame &tool_pose, const int tool_id);
+    void SetCurrentToolPoseChannel(const PoseChannel *tool_pose,
+                                   const int tool_id);
 
     // sets the position of the gripper
-    void SetCurrentGripperpositionPointer(double &gripper_position, const int
-    tool_id);
+    void SetCurrentGripperPositionChannel(
+            const GripperChannel *gripper_position, const int tool_id);
 
     // updates the task logic and the graphics_actors
     void StepWorld();
@@ -158,8 +159,8 @@ private:
     custom_msgs::ActiveConstraintParameters ac_parameters;
 
     KDL::Frame tool_desired_pose_kdl[2];
-    KDL::Frame *tool_current_pose_kdl[2];
-    double *gripper_position[2];
+    const PoseChannel *tool_current_pose_kdl[2];
+    const GripperChannel *gripper_position[2];
 };
 
 #endif //ATAR_TASKBULLETt_H
@@ -125,17 +125,17 @@ TaskBulletTest::TaskBulletTest(const std::string mesh_files_dir,
 
 
 //------------------------------------------------------------------------------
-void TaskBulletTest::SetCurrentToolPosePointer(KDL::Frame &tool_pose,
-                                               const int tool_id) {
+void TaskBulletTest::SetCurrentToolPoseChannel(
+        const PoseChannel *tool_pose, const int tool_id) {
 
-    tool_current_pose_kdl[tool_id] = &tool_pose;
+    tool_current_pose_kdl[tool_id] = tool_pose;
 
 }
 
 
-void TaskBulletTest::SetCurrentGripperpositionPointer(double &grip_position, const int
-tool_id) {
-    gripper_position[tool_id] = &grip_position;
+void TaskBulletTest::SetCurrentGripperPositionChannel(
+        const GripperChannel *grip_position, const int tool_id) {
+    gripper_position[tool_id] = grip_position;
 };
 
 //------------------------------------------------------------------------------
@@ -154,7 +154,7 @@ void TaskBulletTest::StepWorld() {
     //kine_box->SetKinematicPose(box_pose);
 
 
-    KDL::Frame tool_pose = (*tool_current_pose_kdl[0]);
+    KDL::Frame tool_pose = tool_current_pose_kdl[0]->Get();
     double x, y, z, w;
     tool_pose.M.GetQuaternion(x, y, z, w);
     double pointer_pose[7] = {
@@ -431,7 +431,6 @@ void TaskBulletTest::HapticsThread() {
 //            pub_desired[n_arm].publish(pose_msg);
 //        }
 
-        ros::spinOnce();
         loop_rate.sleep();
         boost::this_thread::interruption_point();
     }
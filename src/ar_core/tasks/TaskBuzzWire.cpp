@@ -70,6 +70,14 @@ TaskBuzzWire::TaskBuzzWire(
         tool_current_pose[1] = vtkSmartPointer<vtkMatrix4x4>::New();
     }
 
+    for (int k = 0; k < 1 + (int)bimanual; ++k) {
+        tool_filtered_pose_vtk[k] = vtkSmartPointer<vtkMatrix4x4>::New();
+        tool_desired_pose_vtk[k] = vtkSmartPointer<vtkMatrix4x4>::New();
+        tool_current_frame_axes[k]->SetUserMatrix(tool_filtered_pose_vtk[k]);
+        ring_actor[k]->SetUserMatrix(tool_filtered_pose_vtk[k]);
+        tool_desired_frame_axes[k]->SetUserMatrix(tool_desired_pose_vtk[k]);
+    }
+
     tube_mesh_actor = vtkSmartPointer<vtkActor>::New();
 
     destination_ring_actor= vtkSmartPointer<vtkActor>::New();
@@ -420,10 +428,10 @@ TaskBuzzWire::TaskBuzzWire(
 //}
 
 //------------------------------------------------------------------------------
-void TaskBuzzWire::SetCurrentToolPosePointer(KDL::Frame &tool_pose,
-                                             const int tool_id) {
+void TaskBuzzWire::SetCurrentToolPoseChannel(
+        const PoseChannel *tool_pose, const int tool_id) {
 
-    tool_current_pose_kdl[tool_id] = &tool_pose;
+    tool_current_pose_kdl[tool_id] = tool_pose;
 
 }
 
@@ -439,33 +447,26 @@ void TaskBuzzWire::StepWorld() {
         // shadows behave unexpectedly, to fix it we do a 1 step moving
         // averqge of the position of the tool before applying it to the ring
 
-        vtkSmartPointer<vtkMatrix4x4>   tool_pose_filt = vtkSmartPointer<vtkMatrix4x4>::New();
-        KDL::Frame tool_current_kdl = *tool_current_pose_kdl[k];
+        KDL::Frame tool_current_kdl = tool_current_pose_kdl[k]->Get();
 
         KDL::Frame tool_current_filt_kdl = tool_current_kdl;
         tool_current_filt_kdl.p = 0.5*(tool_last_pose[k].p + tool_current_kdl.p);
 
-        VTKConversions::KDLFrameToVTKMatrix(tool_current_filt_kdl, tool_pose_filt);
-        tool_last_pose[k] = *tool_current_pose_kdl[k];
+        tool_last_pose[k] = tool_current_kdl;
         // -------------
 
-        // setting the transformations
-        tool_current_frame_axes[k]->SetUserMatrix(tool_pose_filt);
-        ring_actor[k]->SetUserMatrix(tool_pose_filt);
+        // setting the transformations of the ring and the axes, which are
+        // only modified when the tool moved
+        VTKConversions::KDLFrameToVTKMatrixIfChanged(
+                tool_current_filt_kdl, tool_filtered_pose_vtk[k]);
     }
 
 //    ring_guides_mesh_actor->SetUserMatrix(tool_current_pose[0]);
 
 
-    vtkSmartPointer<vtkMatrix4x4> tool_desired_pose[2];
-
-    for (int k = 0; k < 1 + (int)bimanual; ++k) {
-        tool_desired_pose[k] =
-            vtkSmartPointer<vtkMatrix4x4>::New();
-        VTKConversions::KDLFrameToVTKMatrix(tool_desired_pose_kdl[k],
-                                            tool_desired_pose[k]);
-        tool_desired_frame_axes[k]->SetUserMatrix(tool_desired_pose[k]);
-    }
+    for (int k = 0; k < 1 + (int)bimanual; ++k)
+        VTKConversions::KDLFrameToVTKMatrixIfChanged(
+                tool_desired_pose_kdl[k], tool_desired_pose_vtk[k]);
 
     // -------------------------------------------------------------------------
     // Task logic
@@ -661,7 +662,7 @@ void TaskBuzzWire::CalculatedDesiredToolPose() {
     for (int k = 0; k < 1 + (int)bimanual; ++k) {
 
         // make a copy of the current pose
-        KDL::Frame tool_current_pose= *tool_current_pose_kdl[k];
+        KDL::Frame tool_current_pose= tool_current_pose_kdl[k]->Get();
 
         //Find the closest cell to the grip point
         double grip_point[3] = {(tool_current_pose).p[0],
@@ -952,16 +953,22 @@ void TaskBuzzWire::HapticsThread() {
 
     while (ros::ok())
     {
-        VTKConversions::KDLFrameToVTKMatrix(*tool_current_pose_kdl[0],
+        // one consistent sample of each tool per iteration
+        KDL::Frame tool_pose[2] = {tool_current_pose_kdl[0]->Get(),
+                                   KDL::Frame()};
+        if(bimanual)
+            tool_pose[1] = tool_current_pose_kdl[1]->Get();
+
+        VTKConversions::KDLFrameToVTKMatrix(tool_pose[0],
                                             tool_current_pose[0]);
         // find the center of the ring
-        ring_center[0] = *tool_current_pose_kdl[0] *
+        ring_center[0] = tool_pose[0] *
             KDL::Vector(0.0, 0.0,ring_radius);
 
         if(bimanual){
-            VTKConversions::KDLFrameToVTKMatrix(*tool_current_pose_kdl[1],
+            VTKConversions::KDLFrameToVTKMatrix(tool_pose[1],
                                                 tool_current_pose[1]);
-            ring_center[1] = *tool_current_pose_kdl[1] *
+            ring_center[1] = tool_pose[1] *
                 KDL::Vector(0.0, ring_radius, 0.0);
         }
 
@@ -986,7 +993,6 @@ void TaskBuzzWire::HapticsThread() {
             pub_desired[n_arm].publish(pose_msg);
         }
 
-        ros::spinOnce();
         loop_rate.sleep();
         boost::this_thread::interruption_point();
     }
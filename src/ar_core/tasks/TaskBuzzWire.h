@@ -84,7 +84,8 @@ public:
         return graphics_actors;
     }
     // sets the pose of the tools
-    void SetCurrentToolPosePointer(KDL::Frame &tool_pose, const int tool_id);
+    void SetCurrentToolPoseChannel(const PoseChannel *tool_pose,
+                                   const int tool_id);
 
     // updates the task logic and the graphics_actors
     void StepWorld();
@@ -181,11 +182,15 @@ private:
     custom_msgs::ActiveConstraintParameters ac_parameters;
 
     KDL::Frame tool_desired_pose_kdl[2];
-    KDL::Frame *tool_current_pose_kdl[2];
+    const PoseChannel *tool_current_pose_kdl[2];
     KDL::Frame tool_last_pose[2];
 
     uint destination_ring_counter;
     vtkSmartPointer<vtkMatrix4x4> tool_current_pose[2];
+    // user matrices of the rings and of the axes, only modified when the
+    // poses change
+    vtkSmartPointer<vtkMatrix4x4> tool_filtered_pose_vtk[2];
+    vtkSmartPointer<vtkMatrix4x4> tool_desired_pose_vtk[2];
 
 //    std::vector<vtkSmartPointer<vtkProp>>           graphics_actors;
 
@@ -149,20 +149,16 @@ TaskClutch::TaskClutch(const std::string mesh_files_dir,
 
 
 //------------------------------------------------------------------------------
-void TaskClutch::SetCurrentToolPosePointer(
-    KDL::Frame &tool_pose,
-    const int tool_id
-) {
+void TaskClutch::SetCurrentToolPoseChannel(
+        const PoseChannel *tool_pose, const int tool_id) {
 
-    tool_current_pose_kdl[tool_id] = &tool_pose;
+    tool_current_pose_kdl[tool_id] = tool_pose;
 
 }
 
-void TaskClutch::SetCurrentGripperpositionPointer(
-    double &grip_position, const int
-tool_id
-) {
-    gripper_position[tool_id] = &grip_position;
+void TaskClutch::SetCurrentGripperPositionChannel(
+        const GripperChannel *grip_position, const int tool_id) {
+    gripper_position[tool_id] = grip_position;
 };
 
 //------------------------------------------------------------------------------
@@ -184,7 +180,7 @@ void TaskClutch::StepWorld() {
 
     //-----------------POINTER: update position on the upper plane
 
-    KDL::Frame tool_pose = (*tool_current_pose_kdl[0]);
+    KDL::Frame tool_pose = tool_current_pose_kdl[0]->Get();
 
     pointer_posit = tool_pose * KDL::Vector(-0.0, -0.0, -0.03 + 0.01);
 
@@ -454,7 +450,6 @@ void TaskClutch::HapticsThread() {
 //            pub_desired[n_arm].publish(pose_msg);
 //        }
 
-        ros::spinOnce();
         loop_rate.sleep();
         boost::this_thread::interruption_point();
     }
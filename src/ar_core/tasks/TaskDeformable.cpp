@@ -275,17 +275,17 @@ TaskDeformable::TaskDeformable(const std::string mesh_files_dir,
 
 
 //------------------------------------------------------------------------------
-void TaskDeformable::SetCurrentToolPosePointer(KDL::Frame &tool_pose,
-                                           const int tool_id) {
+void TaskDeformable::SetCurrentToolPoseChannel(
+        const PoseChannel *tool_pose, const int tool_id) {
 
-    tool_current_pose_kdl[tool_id] = &tool_pose;
+    tool_current_pose_kdl[tool_id] = tool_pose;
 
 }
 
 
-void TaskDeformable::SetCurrentGripperpositionPointer(double &grip_position, const int
-tool_id) {
-    gripper_position[tool_id] = &grip_position;
+void TaskDeformable::SetCurrentGripperPositionChannel(
+        const GripperChannel *grip_position, const int tool_id) {
+    gripper_position[tool_id] = grip_position;
 };
 
 //------------------------------------------------------------------------------
@@ -296,7 +296,7 @@ void TaskDeformable::StepWorld() {
     soft_o2->RenderSoftbody();
     //--------------------------------
     //box
-    KDL::Frame tool_pose = (*tool_current_pose_kdl[0]);
+    KDL::Frame tool_pose = tool_current_pose_kdl[0]->Get();
 
     //double x, y, z, w;
     //tool_pose.M.GetQuaternion(x,y,z,w);
@@ -306,7 +306,7 @@ void TaskDeformable::StepWorld() {
 
     //--------------------------------
     //sphere 0
-    double grip_posit = (*gripper_position[0]);
+    double grip_posit = gripper_position[0]->Get();
 
     KDL::Vector gripper_pos = KDL::Vector( 0.0, (1+grip_posit)* 0.002, 0.001);
     gripper_pos = tool_pose * gripper_pos;
@@ -402,7 +402,6 @@ void TaskDeformable::HapticsThread() {
 //            pub_desired[n_arm].publish(pose_msg);
 //        }
 
-        ros::spinOnce();
         loop_rate.sleep();
         boost::this_thread::interruption_point();
     }
@@ -147,15 +147,15 @@ TaskDemo::TaskDemo(ros::NodeHandle n, const std::string mesh_files_dir,
 
 
 //------------------------------------------------------------------------------
-void TaskDemo::SetCurrentToolPosePointer(KDL::Frame &tool_pose,
-                                         const int tool_id) {
-    tool_current_pose_kdl[tool_id] = &tool_pose;
+void TaskDemo::SetCurrentToolPoseChannel(
+        const PoseChannel *tool_pose, const int tool_id) {
+    tool_current_pose_kdl[tool_id] = tool_pose;
 }
 
 //------------------------------------------------------------------------------
-void TaskDemo::SetCurrentGripperpositionPointer(double &grip_position, const int
-tool_id) {
-    gripper_position[tool_id] = &grip_position;
+void TaskDemo::SetCurrentGripperPositionChannel(
+        const GripperChannel *grip_position, const int tool_id) {
+    gripper_position[tool_id] = grip_position;
 };
 
 //------------------------------------------------------------------------------
@@ -247,7 +247,6 @@ void TaskDemo::HapticsThread() {
 //            pub_desired[n_arm].publish(pose_msg);
 //        }
 
-        ros::spinOnce();
         loop_rate.sleep();
         boost::this_thread::interruption_point();
     }
@@ -37,11 +37,12 @@ public:
     }
 
     // sets the pose of the tools
-    void SetCurrentToolPosePointer(KDL::Frame &tool_pose, const int tool_id);
+    void SetCurrentToolPoseChannel(const PoseChannel *tool_pose,
+                                   const int tool_id);
 
     // sets the position of the gripper
-    void SetCurrentGripperpositionPointer(double &gripper_position, const int
-    tool_id);
+    void SetCurrentGripperPositionChannel(
+            const GripperChannel *gripper_position, const int tool_id);
 
     custom_msgs::TaskState GetTaskStateMsg();
 
@@ -79,8 +80,8 @@ private:
     ManipulatorMaster *master;
 
     KDL::Frame tool_desired_pose_kdl[2];
-    KDL::Frame * tool_current_pose_kdl[2];
-    double * gripper_position[2];
+    const PoseChannel *tool_current_pose_kdl[2];
+    const GripperChannel *gripper_position[2];
 };
 
 #endif //ATAR_TASKBULLETt_H
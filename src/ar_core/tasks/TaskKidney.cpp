@@ -74,6 +74,13 @@ TaskKidney::TaskKidney(const std::string stl_file_dir,
 
     }
 
+    for (int k = 0; k < 1 + (int)bimanual; ++k) {
+        tool_desired_pose_vtk[k] = vtkSmartPointer<vtkMatrix4x4>::New();
+        tool_current_frame_axes[k]->SetUserMatrix(tool_current_pose[k]);
+        ring_actor[k]->SetUserMatrix(tool_current_pose[k]);
+        tool_desired_frame_axes[k]->SetUserMatrix(tool_desired_pose_vtk[k]);
+    }
+
     cellLocator = vtkSmartPointer<vtkCellLocator>::New();
 
     mesh_actor = vtkSmartPointer<vtkActor>::New();
@@ -280,10 +287,10 @@ TaskKidney::TaskKidney(const std::string stl_file_dir,
 //}
 
 //------------------------------------------------------------------------------
-void TaskKidney::SetCurrentToolPosePointer(KDL::Frame &tool_pose,
-                                           const int tool_id) {
+void TaskKidney::SetCurrentToolPoseChannel(
+        const PoseChannel *tool_pose, const int tool_id) {
 
-    tool_current_pose_kdl[tool_id] = &tool_pose;
+    tool_current_pose_kdl[tool_id] = tool_pose;
 
 }
 
@@ -292,24 +299,14 @@ void TaskKidney::StepWorld() {
 
 
     // -------------------------------------------------------------------------
-    // Find closest points and update frames
-    for (int k = 0; k < 1 + (int)bimanual; ++k) {
-        tool_current_frame_axes[k]->SetUserMatrix(tool_current_pose[k]);
-        ring_actor[k]->SetUserMatrix(tool_current_pose[k]);
-    }
-
+    // Update frames. The rings and the current axes use the matrices set by
+    // the haptic thread; the desired axes are only modified when the
+    // desired poses changed.
 //    ring_guides_mesh_actor->SetUserMatrix(tool_current_pose[0]);
 
-
-    vtkSmartPointer<vtkMatrix4x4> tool_desired_pose[2];
-
-    for (int k = 0; k < 1 + (int)bimanual; ++k) {
-        tool_desired_pose[k] =
-                vtkSmartPointer<vtkMatrix4x4>::New();
-        VTKConversions::KDLFrameToVTKMatrix(tool_desired_pose_kdl[k],
-                                            tool_desired_pose[k]);
-        tool_desired_frame_axes[k]->SetUserMatrix(tool_desired_pose[k]);
-    }
+    for (int k = 0; k < 1 + (int)bimanual; ++k)
+        VTKConversions::KDLFrameToVTKMatrixIfChanged(
+                tool_desired_pose_kdl[k], tool_desired_pose_vtk[k]);
 
     // -------------------------------------------------------------------------
     // Task logic
@@ -468,7 +465,7 @@ void TaskKidney::CalculatedDesiredToolPose() {
     for (int k = 0; k < 1 + (int)bimanual; ++k) {
 
         // make a copy of the current pose
-        KDL::Frame tool_current_pose= *tool_current_pose_kdl[k];
+        KDL::Frame tool_current_pose= tool_current_pose_kdl[k]->Get();
 
         //Find the closest cell to the grip point
         double grip_point[3] = {(tool_current_pose).p[0],
@@ -690,16 +687,22 @@ void TaskKidney::HapticsThread() {
 
     while (ros::ok())
     {
-        VTKConversions::KDLFrameToVTKMatrix(*tool_current_pose_kdl[0],
+        // one consistent sample of each tool per iteration
+        KDL::Frame tool_pose[2] = {tool_current_pose_kdl[0]->Get(),
+                                   KDL::Frame()};
+        if(bimanual)
+            tool_pose[1] = tool_current_pose_kdl[1]->Get();
+
+        VTKConversions::KDLFrameToVTKMatrix(tool_pose[0],
                                             tool_current_pose[0]);
         // find the center of the ring
-        ring_center[0] = *tool_current_pose_kdl[0] *
+        ring_center[0] = tool_pose[0] *
                          KDL::Vector(0.0, 0.0,ring_radius);
 
         if(bimanual){
-            VTKConversions::KDLFrameToVTKMatrix(*tool_current_pose_kdl[1],
+            VTKConversions::KDLFrameToVTKMatrix(tool_pose[1],
                                                 tool_current_pose[1]);
-            ring_center[1] = *tool_current_pose_kdl[1] *
+            ring_center[1] = tool_pose[1] *
                              KDL::Vector(0.0, ring_radius, 0.0);
         }
 
@@ -719,7 +722,6 @@ void TaskKidney::HapticsThread() {
             pub_desired[n_arm].publish(pose_msg);
         }
 
-        ros::spinOnce();
         loop_rate.sleep();
         boost::this_thread::interruption_point();
     }
@@ -331,17 +331,17 @@ TaskNeedle::TaskNeedle(const std::string mesh_files_dir,
 
 
 //------------------------------------------------------------------------------
-void TaskNeedle::SetCurrentToolPosePointer(KDL::Frame &tool_pose,
-                                           const int tool_id) {
+void TaskNeedle::SetCurrentToolPoseChannel(
+        const PoseChannel *tool_pose, const int tool_id) {
 
-    tool_current_pose_kdl[tool_id] = &tool_pose;
+    tool_current_pose_kdl[tool_id] = tool_pose;
 
 }
 
 
-void TaskNeedle::SetCurrentGripperpositionPointer(double &grip_position, const int
-tool_id) {
-    gripper_position[tool_id] = &grip_position;
+void TaskNeedle::SetCurrentGripperPositionChannel(
+        const GripperChannel *grip_position, const int tool_id) {
+    gripper_position[tool_id] = grip_position;
 };
 
 //------------------------------------------------------------------------------
@@ -353,9 +353,9 @@ void TaskNeedle::StepWorld() {
 //    std::cout << "in " << result.connected << std::endl;
 
     //-------------------------------- UPDATE RIGHT GRIPPER
-    KDL::Frame grpr_right_pose = (*tool_current_pose_kdl[0]);
+    KDL::Frame grpr_right_pose = tool_current_pose_kdl[0]->Get();
     // map gripper value to an angle
-    double grip_posit = (*gripper_position[0]);
+    double grip_posit = gripper_position[0]->Get();
     double theta_min=14*M_PI/180;
     double theta_max=40*M_PI/180;
     double grip_angle = theta_max*(grip_posit+0.5)/1.55;
@@ -366,9 +366,9 @@ void TaskNeedle::StepWorld() {
                            right_gripper_links);
 
     //-------------------------------- UPDATE LEFT GRIPPER
-    KDL::Frame grpr_left_pose = (*tool_current_pose_kdl[1]);
+    KDL::Frame grpr_left_pose = tool_current_pose_kdl[1]->Get();
     // map gripper value to an angle
-    grip_posit = (*gripper_position[1]);
+    grip_posit = gripper_position[1]->Get();
     grip_angle = theta_max*(grip_posit+0.5)/1.55;
     if(grip_angle<theta_min)
         grip_angle=theta_min;
@@ -444,7 +444,6 @@ void TaskNeedle::HapticsThread() {
 //            pub_desired[n_arm].publish(pose_msg);
 //        }
 
-        ros::spinOnce();
         loop_rate.sleep();
         boost::this_thread::interruption_point();
     }
@@ -225,17 +225,17 @@ TaskRingTransfer::TaskRingTransfer(const std::string mesh_files_dir,
 
 
 //------------------------------------------------------------------------------
-void TaskRingTransfer::SetCurrentToolPosePointer(KDL::Frame &tool_pose,
-                                         const int tool_id) {
+void TaskRingTransfer::SetCurrentToolPoseChannel(
+        const PoseChannel *tool_pose, const int tool_id) {
 
-    tool_current_pose_kdl[tool_id] = &tool_pose;
+    tool_current_pose_kdl[tool_id] = tool_pose;
 
 }
 
 
-void TaskRingTransfer::SetCurrentGripperpositionPointer(double &grip_position, const int
-tool_id) {
-    jaw_position[tool_id] = &grip_position;
+void TaskRingTransfer::SetCurrentGripperPositionChannel(
+        const GripperChannel *grip_position, const int tool_id) {
+    jaw_position[tool_id] = grip_position;
 };
 
 //------------------------------------------------------------------------------
@@ -243,9 +243,9 @@ void TaskRingTransfer::StepWorld() {
 
 
     //-------------------------------- UPDATE RIGHT GRIPPER
-    KDL::Frame grpr_right_pose = (*tool_current_pose_kdl[0]);
+    KDL::Frame grpr_right_pose = tool_current_pose_kdl[0]->Get();
     // map gripper value to an angle
-    double grip_posit = (*jaw_position[0]);
+    double grip_posit = jaw_position[0]->Get();
     double theta_min=0*M_PI/180;
     double theta_max=40*M_PI/180;
     double grip_angle = theta_max*(grip_posit+0.5)/1.55;
@@ -264,7 +264,7 @@ void TaskRingTransfer::StepWorld() {
 
     //Update the pose of hook
     {
-        KDL::Frame tool_pose = (*tool_current_pose_kdl[1]);
+        KDL::Frame tool_pose = tool_current_pose_kdl[1]->Get();
         KDL::Frame local_tool_transform;
 
         // locally transform the tool if needed
@@ -354,7 +354,6 @@ void TaskRingTransfer::HapticsThread() {
 //            pub_desired[n_arm].publish(pose_msg);
 //        }
 
-        ros::spinOnce();
         loop_rate.sleep();
         boost::this_thread::interruption_point();
     }
@@ -41,6 +41,10 @@ TaskSteadyHand::TaskSteadyHand(
 
     tool_current_frame_axes[0] = vtkSmartPointer<vtkAxesActor>::New();
     tool_desired_frame_axes[0] = vtkSmartPointer<vtkAxesActor>::New();
+    tool_current_pose_vtk[0] = vtkSmartPointer<vtkMatrix4x4>::New();
+    tool_desired_pose_vtk[0] = vtkSmartPointer<vtkMatrix4x4>::New();
+    tool_current_frame_axes[0]->SetUserMatrix(tool_current_pose_vtk[0]);
+    tool_desired_frame_axes[0]->SetUserMatrix(tool_desired_pose_vtk[0]);
 
     //if (bimanual) {
     //    tool_current_frame_axes[1] = vtkSmartPointer<vtkAxesActor>::New();
@@ -429,14 +433,14 @@ TaskSteadyHand::TaskSteadyHand(
 
 
 //------------------------------------------------------------------------------
-void TaskSteadyHand::SetCurrentToolPosePointer(KDL::Frame &tool_pose,
-                                               const int tool_id) {
-    tool_current_pose_ptr[tool_id] = &tool_pose;
+void TaskSteadyHand::SetCurrentToolPoseChannel(
+        const PoseChannel *tool_pose, const int tool_id) {
+    tool_current_pose_ptr[tool_id] = tool_pose;
 }
 
-void TaskSteadyHand::SetCurrentGripperpositionPointer(double &grip_position, const int
-tool_id) {
-    gripper_position[tool_id] = &grip_position;
+void TaskSteadyHand::SetCurrentGripperPositionChannel(
+        const GripperChannel *grip_position, const int tool_id) {
+    gripper_position[tool_id] = grip_position;
 };
 //------------------------------------------------------------------------------
 void TaskSteadyHand::StepWorld() {
@@ -499,7 +503,7 @@ void TaskSteadyHand::StepWorld() {
 
     //-------------------------------- UPDATE RIGHT GRIPPER
     // map gripper value to an angle
-    double grip_posit = (*gripper_position[0]);
+    double grip_posit = gripper_position[0]->Get();
     double theta_min=0*M_PI/180;
     double theta_max=20*M_PI/180;
     double grip_angle = theta_max*(grip_posit)/1.55;
@@ -510,7 +514,7 @@ void TaskSteadyHand::StepWorld() {
 
     //-------------------------------- UPDATE LEFT GRIPPER
     // map gripper value to an angle
-    grip_posit = (*gripper_position[1]);
+    grip_posit = gripper_position[1]->Get();
     grip_angle = theta_max*(grip_posit+0.5)/1.55;
     if(grip_angle<theta_min)
         grip_angle=theta_min;
@@ -929,8 +933,8 @@ void TaskSteadyHand::HapticsThread() {
         ring_pose_loc = ring_pose;
 
         // find the center of the ring
-        tool_current_pose[0] = *tool_current_pose_ptr[0];
-        tool_current_pose[1] = *tool_current_pose_ptr[1];
+        tool_current_pose[0] = tool_current_pose_ptr[0]->Get();
+        tool_current_pose[1] = tool_current_pose_ptr[1]->Get();
 
         KDL::Frame tr_to_desired_ring_pose, desired_ring_pose;
         KDL::Frame estimated_ring_pose_loc;
@@ -1032,7 +1036,6 @@ void TaskSteadyHand::HapticsThread() {
                                          rpy[2]);
         orientation_error_norm = rpy.Norm();
 
-        ros::spinOnce();
         loop_rate.sleep();
         boost::this_thread::interruption_point();
     }
@@ -1262,20 +1265,13 @@ void TaskSteadyHand::UpdateCurrentAndDesiredReferenceFrames(
         const KDL::Frame desired_pose[2]
 ) {
 
-    vtkSmartPointer<vtkMatrix4x4> tool_desired_pose_vtk[2];
-    vtkSmartPointer<vtkMatrix4x4> tool_current_pose_vtk[2];
-
     //for (int k = 0; k < 1 + (int)bimanual; ++k) {
     for (int k = 0; k < 1 ; ++k) {
-        tool_desired_pose_vtk[k] = vtkSmartPointer<vtkMatrix4x4>::New();
-        VTKConversions::KDLFrameToVTKMatrix(desired_pose[k],
-                                            tool_desired_pose_vtk[k]);
-        tool_desired_frame_axes[k]->SetUserMatrix(tool_desired_pose_vtk[k]);
-
-        tool_current_pose_vtk[k] = vtkSmartPointer<vtkMatrix4x4>::New();
-        VTKConversions::KDLFrameToVTKMatrix(current_pose[k],
-                                            tool_current_pose_vtk[k]);
-        tool_current_frame_axes[k]->SetUserMatrix(tool_current_pose_vtk[k]);
+        // the axes are only modified when their pose changed
+        VTKConversions::KDLFrameToVTKMatrixIfChanged(
+                desired_pose[k], tool_desired_pose_vtk[k]);
+        VTKConversions::KDLFrameToVTKMatrixIfChanged(
+                current_pose[k], tool_current_pose_vtk[k]);
     }
 
 }
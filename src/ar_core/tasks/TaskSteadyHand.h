@@ -97,11 +97,12 @@ public:
     std::vector< vtkSmartPointer <vtkProp> > GetActors() {return graphics_actors;}
 
     // sets the pose of the tools
-    void SetCurrentToolPosePointer(KDL::Frame &tool_pose, const int tool_id);
+    void SetCurrentToolPoseChannel(const PoseChannel *tool_pose,
+                                   const int tool_id);
 
     // sets the position of the gripper
-    void SetCurrentGripperpositionPointer(double &gripper_position, const int
-    tool_id);
+    void SetCurrentGripperPositionChannel(
+            const GripperChannel *gripper_position, const int tool_id);
 
     custom_msgs::TaskState GetTaskStateMsg();
 
@@ -204,7 +205,7 @@ private:
     bool ac_params_changed;
 
     KDL::Frame tool_desired_pose[2];
-    KDL::Frame *tool_current_pose_ptr[2];
+    const PoseChannel *tool_current_pose_ptr[2];
     KDL::Frame tool_current_pose[2];
 
     uint destination_ring_counter;
@@ -217,6 +218,9 @@ private:
 
     vtkSmartPointer<vtkAxesActor>                   tool_current_frame_axes[2];
     vtkSmartPointer<vtkAxesActor>                   tool_desired_frame_axes[2];
+    // user matrices of the axes, only modified when the poses change
+    vtkSmartPointer<vtkMatrix4x4>                   tool_current_pose_vtk[2];
+    vtkSmartPointer<vtkMatrix4x4>                   tool_desired_pose_vtk[2];
 
     vtkSmartPointer<vtkCellLocator>                 cellLocator;
 
@@ -240,7 +244,7 @@ private:
     SimObject* arm[2];
     KDL::Vector rcm[2];
 
-    double * gripper_position[2];
+    const GripperChannel *gripper_position[2];
 
 
 };
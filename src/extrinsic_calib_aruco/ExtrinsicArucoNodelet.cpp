@@ -145,8 +145,11 @@ namespace atar {
         }
 
         it_.reset(new image_transport::ImageTransport(n));
+        // image_transport parameter, e.g. shm when the camera is on this host
         sub_ = it_->subscribe(image_transport_namespace, 1,
-                              &ExtrinsicArucoNodelet::ImageCallback, this);
+                              &ExtrinsicArucoNodelet::ImageCallback, this,
+                              image_transport::TransportHints(
+                                      "raw", ros::TransportHints(), n));
 
 
         // Load the description of the aruco board from the parameters
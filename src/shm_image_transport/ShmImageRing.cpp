@@ -0,0 +1,256 @@
+//
+// Ring of image slots in POSIX shared memory, written by one publisher and
+// read by the subscribers on the same host.
+//
+
+#include "ShmImageRing.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+const uint32_t kMagic = 0x48534154; // "TASH"
+const size_t kAlignment = 64;
+
+size_t Align(const size_t size) {
+    return (size + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// bytes from the start of one slot header to the next
+size_t SlotStride(const size_t slot_size) {
+    return sizeof(atar::ShmSlotHeader) + Align(slot_size);
+}
+
+size_t SegmentSize(const uint32_t num_slots, const size_t slot_size) {
+    return Align(sizeof(atar::ShmRingHeader))
+           + num_slots * SlotStride(slot_size);
+}
+
+uint8_t *SlotHeaderAddress(uint8_t *segment, const size_t slot_size,
+                           const uint32_t slot) {
+    return segment + Align(sizeof(atar::ShmRingHeader))
+           + slot * SlotStride(slot_size);
+}
+
+}
+
+namespace atar {
+
+//------------------------------------------------------------------------------
+std::string GetHostId() {
+
+    char hostname[256] = {0};
+    gethostname(hostname, sizeof(hostname) - 1);
+    // a container can have the name of the host without sharing its memory
+    std::string boot_id;
+    std::ifstream file("/proc/sys/kernel/random/boot_id");
+    std::getline(file, boot_id);
+    return std::string(hostname) + "/" + boot_id;
+}
+
+//------------------------------------------------------------------------------
+ShmImageWriter::ShmImageWriter(const std::string &name_prefix,
+                               const uint32_t num_slots)
+        : num_slots_(std::max<uint32_t>(2, num_slots)),
+          generation_(0),
+          segment_(NULL),
+          segment_size_(0),
+          slot_size_(0),
+          next_slot_(0)
+{
+    for (size_t i = 0; i < name_prefix.size(); ++i) {
+        const char c = name_prefix[i];
+        if(isalnum((unsigned char)c) || c == '_')
+            name_prefix_ += c;
+    }
+    // shm names are limited to NAME_MAX with the pid and generation
+    if(name_prefix_.size() > 160)
+        name_prefix_ = name_prefix_.substr(name_prefix_.size() - 160);
+}
+
+//------------------------------------------------------------------------------
+ShmImageWriter::~ShmImageWriter() {
+    Release();
+}
+
+//------------------------------------------------------------------------------
+void ShmImageWriter::Write(const uint8_t *data, const size_t size,
+                           uint32_t &slot, uint64_t &sequence) {
+
+    if(!segment_ || size > slot_size_)
+        Create(std::max(size, 2 * slot_size_));
+
+    slot = next_slot_;
+    next_slot_ = (next_slot_ + 1) % num_slots_;
+
+    uint8_t *address = SlotHeaderAddress(segment_, slot_size_, slot);
+    ShmSlotHeader *header = reinterpret_cast<ShmSlotHeader *>(address);
+    const uint64_t before = header->sequence.load(std::memory_order_relaxed);
+    header->sequence.store(before + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::memcpy(address + sizeof(ShmSlotHeader), data, size);
+
+    sequence = before + 2;
+    header->sequence.store(sequence, std::memory_order_release);
+}
+
+//------------------------------------------------------------------------------
+void ShmImageWriter::Create(const size_t slot_size) {
+
+    Release();
+
+    std::stringstream name;
+    name << "/atar" << name_prefix_ << "_" << getpid() << "_"
+         << ++generation_;
+    const std::string segment_name = name.str();
+    const size_t segment_size = SegmentSize(num_slots_, slot_size);
+
+    // left over by a crashed process with the same pid
+    shm_unlink(segment_name.c_str());
+    const int fd = shm_open(segment_name.c_str(), O_CREAT | O_EXCL | O_RDWR,
+                            0644);
+    if(fd < 0)
+        throw std::runtime_error("Could not create the shared memory segment "
+                                 + segment_name + ": " + strerror(errno));
+    if(ftruncate(fd, (off_t)segment_size) != 0) {
+        close(fd);
+        shm_unlink(segment_name.c_str());
+        throw std::runtime_error("Could not size the shared memory segment "
+                                 + segment_name + ": " + strerror(errno));
+    }
+    void *address = mmap(NULL, segment_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    close(fd);
+    if(address == MAP_FAILED) {
+        shm_unlink(segment_name.c_str());
+        throw std::runtime_error("Could not map the shared memory segment "
+                                 + segment_name + ": " + strerror(errno));
+    }
+
+    // ftruncate zeroed the segment, all the sequences start at 0
+    segment_ = static_cast<uint8_t *>(address);
+    segment_size_ = segment_size;
+    segment_name_ = segment_name;
+    slot_size_ = Align(slot_size);
+    next_slot_ = 0;
+
+    ShmRingHeader *header = reinterpret_cast<ShmRingHeader *>(segment_);
+    header->num_slots = num_slots_;
+    header->slot_size = slot_size_;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = kMagic;
+}
+
+//------------------------------------------------------------------------------
+void ShmImageWriter::Release() {
+
+    if(!segment_)
+        return;
+    munmap(segment_, segment_size_);
+    // the readers keep their mapping until they unmap it
+    shm_unlink(segment_name_.c_str());
+    segment_ = NULL;
+    segment_size_ = 0;
+    slot_size_ = 0;
+}
+
+//------------------------------------------------------------------------------
+ShmImageReader::ShmImageReader()
+        : segment_(NULL), segment_size_(0)
+{
+}
+
+//------------------------------------------------------------------------------
+ShmImageReader::~ShmImageReader() {
+    Unmap();
+}
+
+//------------------------------------------------------------------------------
+bool ShmImageReader::Read(const std::string &segment_name,
+                          const uint32_t slot, const uint64_t sequence,
+                          uint8_t *dst, const size_t size,
+                          bool &overwritten) {
+
+    overwritten = false;
+    if(segment_name != segment_name_ && !Map(segment_name))
+        return false;
+
+    const ShmRingHeader *ring =
+            reinterpret_cast<const ShmRingHeader *>(segment_);
+    if(slot >= ring->num_slots || size > ring->slot_size) {
+        overwritten = true;
+        return true;
+    }
+
+    const uint8_t *address = SlotHeaderAddress(
+            const_cast<uint8_t *>(segment_), ring->slot_size, slot);
+    const ShmSlotHeader *header =
+            reinterpret_cast<const ShmSlotHeader *>(address);
+    if(header->sequence.load(std::memory_order_acquire) != sequence) {
+        overwritten = true;
+        return true;
+    }
+
+    std::memcpy(dst, address + sizeof(ShmSlotHeader), size);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    overwritten =
+            header->sequence.load(std::memory_order_relaxed) != sequence;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool ShmImageReader::Map(const std::string &segment_name) {
+
+    Unmap();
+    const int fd = shm_open(segment_name.c_str(), O_RDONLY, 0);
+    if(fd < 0)
+        return false;
+
+    struct stat status;
+    if(fstat(fd, &status) != 0
+       || (size_t)status.st_size < sizeof(ShmRingHeader)) {
+        close(fd);
+        return false;
+    }
+    void *address = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED,
+                         fd, 0);
+    close(fd);
+    if(address == MAP_FAILED)
+        return false;
+
+    segment_ = static_cast<const uint8_t *>(address);
+    segment_size_ = (size_t)status.st_size;
+    segment_name_ = segment_name;
+
+    const ShmRingHeader *ring =
+            reinterpret_cast<const ShmRingHeader *>(segment_);
+    if(ring->magic != kMagic
+       || SegmentSize(ring->num_slots, ring->slot_size) > segment_size_) {
+        Unmap();
+        return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void ShmImageReader::Unmap() {
+
+    if(segment_)
+        munmap(const_cast<uint8_t *>(segment_), segment_size_);
+    segment_ = NULL;
+    segment_size_ = 0;
+    segment_name_.clear();
+}
+
+}
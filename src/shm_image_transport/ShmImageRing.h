@@ -0,0 +1,121 @@
+//
+// Ring of image slots in POSIX shared memory, written by one publisher and
+// read by the subscribers on the same host.
+//
+
+#ifndef ATAR_SHMIMAGERING_H
+#define ATAR_SHMIMAGERING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace atar {
+
+/**
+ * \brief Layout of the shared memory segment: a header, then num_slots
+ * slots of slot_size bytes of image data, each preceded by its sequence
+ * number. Everything is aligned to 64 bytes so that two slots never share
+ * a cache line.
+ *
+ * The sequence of a slot works like a sequence lock: odd while the writer
+ * fills the slot, even once the frame is complete. The message announcing a
+ * frame carries the even sequence of its slot. A reader copies the frame
+ * and checks the sequence before and after: if it differs the writer went
+ * round the ring and overwrote the frame in the meantime.
+ */
+struct ShmRingHeader {
+    uint32_t magic;
+    uint32_t num_slots;
+    uint64_t slot_size;
+};
+
+struct alignas(64) ShmSlotHeader {
+    std::atomic<uint64_t> sequence;
+};
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t)
+              && ATOMIC_LLONG_LOCK_FREE == 2,
+              "The slot sequences must be lock free to be shared between "
+              "processes");
+
+// Hostname and boot id of this machine. Two processes can share memory only
+// if they have the same host id.
+std::string GetHostId();
+
+/**
+ * \class ShmImageWriter
+ * \brief Creates the segment and writes the frames in its slots in turn.
+ *
+ * When a frame does not fit in the slots, a new segment twice as large is
+ * created under a new name and the old one is unlinked. The readers that
+ * still map it keep a valid mapping and switch to the new name with the
+ * next message. The segment is unlinked when the writer is destroyed.
+ */
+class ShmImageWriter {
+public:
+
+    // name_prefix identifies the publisher, e.g. its topic. Only
+    // [A-Za-z0-9_] are kept.
+    ShmImageWriter(const std::string &name_prefix, const uint32_t num_slots);
+
+    ~ShmImageWriter();
+
+    // Copies size bytes in the next slot. Returns the slot and its sequence
+    // for the message announcing the frame. Throws std::runtime_error if
+    // the segment can not be created.
+    void Write(const uint8_t *data, const size_t size, uint32_t &slot,
+               uint64_t &sequence);
+
+    const std::string &GetSegmentName() const { return segment_name_; }
+
+private:
+    void Create(const size_t slot_size);
+
+    void Release();
+
+    std::string name_prefix_;
+    uint32_t num_slots_;
+    // incremented with each new segment
+    uint32_t generation_;
+    std::string segment_name_;
+    uint8_t *segment_;
+    size_t segment_size_;
+    size_t slot_size_;
+    uint32_t next_slot_;
+};
+
+/**
+ * \class ShmImageReader
+ * \brief Maps the segment of a writer read-only and copies frames out of it.
+ */
+class ShmImageReader {
+public:
+
+    ShmImageReader();
+
+    ~ShmImageReader();
+
+    // Copies the frame announced with slot and sequence, of size bytes, in
+    // dst. Returns false if the segment can not be mapped (it is not on this
+    // host), and sets overwritten if the writer reused the slot before the
+    // copy was done.
+    bool Read(const std::string &segment_name, const uint32_t slot,
+              const uint64_t sequence, uint8_t *dst, const size_t size,
+              bool &overwritten);
+
+private:
+    bool Map(const std::string &segment_name);
+
+    void Unmap();
+
+    std::string segment_name_;
+    const uint8_t *segment_;
+    size_t segment_size_;
+};
+
+}
+
+#endif //ATAR_SHMIMAGERING_H
@@ -0,0 +1,73 @@
+//
+// image_transport publisher plugin writing the frames in shared memory.
+//
+
+#include "ShmPublisher.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace atar {
+
+//------------------------------------------------------------------------------
+ShmPublisher::ShmPublisher()
+        : host_id_(GetHostId())
+{
+}
+
+//------------------------------------------------------------------------------
+ShmPublisher::~ShmPublisher() {
+}
+
+//------------------------------------------------------------------------------
+void ShmPublisher::advertiseImpl(
+        ros::NodeHandle &nh, const std::string &base_topic,
+        uint32_t queue_size,
+        const image_transport::SubscriberStatusCallback &user_connect_cb,
+        const image_transport::SubscriberStatusCallback &user_disconnect_cb,
+        const ros::VoidPtr &tracked_object, bool latch) {
+
+    SimplePublisherPlugin<atar::ShmImage>::advertiseImpl(
+            nh, base_topic, queue_size, user_connect_cb, user_disconnect_cb,
+            tracked_object, latch);
+
+    ros::NodeHandle param_nh(nh, base_topic + "/" + getTransportName());
+    int num_slots = 4;
+    param_nh.param<int>("num_slots", num_slots, 4);
+
+    // the segment itself is created with the first frame, once its size is
+    // known
+    std::lock_guard<std::mutex> lock(mutex_);
+    writer_.reset(new ShmImageWriter(nh.resolveName(base_topic),
+                                     (uint32_t)std::max(2, num_slots)));
+}
+
+//------------------------------------------------------------------------------
+void ShmPublisher::publish(const sensor_msgs::Image &message,
+                           const PublishFn &publish_fn) const {
+
+    atar::ShmImage msg;
+    msg.header = message.header;
+    msg.host_id = host_id_;
+    msg.height = message.height;
+    msg.width = message.width;
+    msg.encoding = message.encoding;
+    msg.is_bigendian = message.is_bigendian;
+    msg.step = message.step;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(!writer_)
+            return;
+        try {
+            writer_->Write(message.data.data(), message.data.size(),
+                           msg.slot, msg.sequence);
+        }
+        catch (std::runtime_error &e) {
+            ROS_ERROR_THROTTLE(5, "[shm] %s", e.what());
+            return;
+        }
+        msg.segment = writer_->GetSegmentName();
+    }
+    publish_fn(msg);
+}
+
+}
@@ -0,0 +1,58 @@
+//
+// image_transport publisher plugin writing the frames in shared memory.
+//
+
+#ifndef ATAR_SHMPUBLISHER_H
+#define ATAR_SHMPUBLISHER_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <image_transport/simple_publisher_plugin.h>
+#include <atar/ShmImage.h>
+#include "ShmImageRing.h"
+
+namespace atar {
+
+/**
+ * \class ShmPublisher
+ * \brief The "shm" transport: each frame is copied once in a ring of slots
+ * in POSIX shared memory, and only a small ShmImage message announcing its
+ * slot and sequence goes through TCPROS.
+ *
+ * Like the other transports, the frame is written only when the shm topic
+ * has subscribers. The number of slots is read from the parameter
+ * <base_topic>/shm/num_slots (default 4): a subscriber that is more than
+ * num_slots - 1 frames late finds its frame overwritten and drops it.
+ */
+class ShmPublisher
+        : public image_transport::SimplePublisherPlugin<atar::ShmImage> {
+public:
+
+    ShmPublisher();
+
+    virtual ~ShmPublisher();
+
+    virtual std::string getTransportName() const { return "shm"; }
+
+protected:
+    virtual void advertiseImpl(
+            ros::NodeHandle &nh, const std::string &base_topic,
+            uint32_t queue_size,
+            const image_transport::SubscriberStatusCallback &user_connect_cb,
+            const image_transport::SubscriberStatusCallback &user_disconnect_cb,
+            const ros::VoidPtr &tracked_object, bool latch);
+
+    virtual void publish(const sensor_msgs::Image &message,
+                         const PublishFn &publish_fn) const;
+
+private:
+    std::string host_id_;
+    // publish() is const and can be called from several threads
+    mutable std::mutex mutex_;
+    std::unique_ptr<ShmImageWriter> writer_;
+};
+
+}
+
+#endif //ATAR_SHMPUBLISHER_H
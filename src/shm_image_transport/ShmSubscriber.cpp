@@ -0,0 +1,122 @@
+//
+// image_transport subscriber plugin reading the frames from shared memory.
+//
+
+#include "ShmSubscriber.h"
+#include <boost/make_shared.hpp>
+#include <sensor_msgs/Image.h>
+
+namespace atar {
+
+//------------------------------------------------------------------------------
+ShmSubscriber::ShmSubscriber()
+        : host_id_(GetHostId()),
+          segment_mapped_once_(false),
+          num_dropped_(0),
+          queue_size_(1)
+{
+}
+
+//------------------------------------------------------------------------------
+ShmSubscriber::~ShmSubscriber() {
+}
+
+//------------------------------------------------------------------------------
+std::string ShmSubscriber::getTopic() const {
+    if(raw_subscriber_)
+        return raw_subscriber_.getTopic();
+    return SimpleSubscriberPlugin<atar::ShmImage>::getTopic();
+}
+
+//------------------------------------------------------------------------------
+uint32_t ShmSubscriber::getNumPublishers() const {
+    if(raw_subscriber_)
+        return raw_subscriber_.getNumPublishers();
+    return SimpleSubscriberPlugin<atar::ShmImage>::getNumPublishers();
+}
+
+//------------------------------------------------------------------------------
+void ShmSubscriber::shutdown() {
+    raw_subscriber_.shutdown();
+    SimpleSubscriberPlugin<atar::ShmImage>::shutdown();
+}
+
+//------------------------------------------------------------------------------
+void ShmSubscriber::subscribeImpl(
+        ros::NodeHandle &nh, const std::string &base_topic,
+        uint32_t queue_size, const Callback &callback,
+        const ros::VoidPtr &tracked_object,
+        const image_transport::TransportHints &transport_hints) {
+
+    nh_ = nh;
+    base_topic_ = base_topic;
+    queue_size_ = queue_size;
+    callback_ = callback;
+    tracked_object_ = tracked_object;
+    ros_hints_ = transport_hints.getRosHints();
+
+    SimpleSubscriberPlugin<atar::ShmImage>::subscribeImpl(
+            nh, base_topic, queue_size, callback, tracked_object,
+            transport_hints);
+}
+
+//------------------------------------------------------------------------------
+void ShmSubscriber::internalCallback(const atar::ShmImage::ConstPtr &message,
+                                     const Callback &user_cb) {
+
+    // messages already queued when we fell back
+    if(raw_subscriber_)
+        return;
+
+    if(message->host_id != host_id_) {
+        FallBackToRaw("the publisher is on host " + message->host_id);
+        return;
+    }
+
+    sensor_msgs::ImagePtr image = boost::make_shared<sensor_msgs::Image>();
+    image->header = message->header;
+    image->height = message->height;
+    image->width = message->width;
+    image->encoding = message->encoding;
+    image->is_bigendian = message->is_bigendian;
+    image->step = message->step;
+    image->data.resize((size_t)message->step * message->height);
+
+    bool overwritten = false;
+    if(!reader_.Read(message->segment, message->slot, message->sequence,
+                     image->data.data(), image->data.size(), overwritten)) {
+        // the publisher may have replaced a segment we never mapped, but if
+        // none could ever be mapped it is not reachable from this process
+        if(!segment_mapped_once_)
+            FallBackToRaw("could not map " + message->segment);
+        else
+            num_dropped_++;
+        return;
+    }
+    segment_mapped_once_ = true;
+
+    if(overwritten) {
+        num_dropped_++;
+        ROS_WARN_THROTTLE(5, "[shm] %s: %lu frames overwritten before they "
+                "were read. Increase %s/shm/num_slots on the publisher.",
+                          base_topic_.c_str(), num_dropped_,
+                          base_topic_.c_str());
+        return;
+    }
+
+    user_cb(image);
+}
+
+//------------------------------------------------------------------------------
+void ShmSubscriber::FallBackToRaw(const std::string &reason) {
+
+    ROS_WARN("[shm] %s: %s. Subscribing to the raw transport instead.",
+             base_topic_.c_str(), reason.c_str());
+
+    // roscpp allows shutting a subscriber down from its own callback
+    SimpleSubscriberPlugin<atar::ShmImage>::shutdown();
+    raw_subscriber_ = nh_.subscribe<sensor_msgs::Image>(
+            base_topic_, queue_size_, callback_, tracked_object_, ros_hints_);
+}
+
+}
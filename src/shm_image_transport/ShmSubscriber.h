@@ -0,0 +1,73 @@
+//
+// image_transport subscriber plugin reading the frames from shared memory.
+//
+
+#ifndef ATAR_SHMSUBSCRIBER_H
+#define ATAR_SHMSUBSCRIBER_H
+
+#include <string>
+#include <image_transport/simple_subscriber_plugin.h>
+#include <atar/ShmImage.h>
+#include "ShmImageRing.h"
+
+namespace atar {
+
+/**
+ * \class ShmSubscriber
+ * \brief The "shm" transport: copies each announced frame out of the
+ * shared memory ring of the publisher.
+ *
+ * When the publisher is on another host, or its segment can not be mapped
+ * from this process, the subscriber logs it once, drops the shm
+ * subscription and subscribes to the raw topic instead, so that a node
+ * asking for shm still gets its images over TCP from a remote camera.
+ * Frames overwritten before they were copied are dropped and counted.
+ */
+class ShmSubscriber
+        : public image_transport::SimpleSubscriberPlugin<atar::ShmImage> {
+public:
+
+    ShmSubscriber();
+
+    virtual ~ShmSubscriber();
+
+    virtual std::string getTransportName() const { return "shm"; }
+
+    virtual std::string getTopic() const;
+
+    virtual uint32_t getNumPublishers() const;
+
+    virtual void shutdown();
+
+protected:
+    virtual void subscribeImpl(
+            ros::NodeHandle &nh, const std::string &base_topic,
+            uint32_t queue_size, const Callback &callback,
+            const ros::VoidPtr &tracked_object,
+            const image_transport::TransportHints &transport_hints);
+
+    virtual void internalCallback(const atar::ShmImage::ConstPtr &message,
+                                  const Callback &user_cb);
+
+private:
+    // Replaces the shm subscription with one to the raw topic
+    void FallBackToRaw(const std::string &reason);
+
+    std::string host_id_;
+    ShmImageReader reader_;
+    bool segment_mapped_once_;
+    unsigned long num_dropped_;
+
+    // kept to subscribe to the raw topic
+    ros::NodeHandle nh_;
+    std::string base_topic_;
+    uint32_t queue_size_;
+    Callback callback_;
+    ros::VoidPtr tracked_object_;
+    ros::TransportHints ros_hints_;
+    ros::Subscriber raw_subscriber_;
+};
+
+}
+
+#endif //ATAR_SHMSUBSCRIBER_H
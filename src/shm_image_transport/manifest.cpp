@@ -0,0 +1,10 @@
+//
+// Registers the shm transport with image_transport.
+//
+
+#include <pluginlib/class_list_macros.h>
+#include "ShmPublisher.h"
+#include "ShmSubscriber.h"
+
+PLUGINLIB_EXPORT_CLASS(atar::ShmPublisher, image_transport::PublisherPlugin)
+PLUGINLIB_EXPORT_CLASS(atar::ShmSubscriber, image_transport::SubscriberPlugin)
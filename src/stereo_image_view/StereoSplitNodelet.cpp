@@ -0,0 +1,108 @@
+//
+// Splits the images of a stereo camera that sends both eyes in one frame
+// into a left and a right image topic.
+//
+
+#include <string>
+#include <nodelet/nodelet.h>
+#include <ros/ros.h>
+#include <cv_bridge/cv_bridge.h>
+#include <image_transport/image_transport.h>
+
+namespace atar {
+
+/**
+ * \class StereoSplitNodelet
+ * \brief Subscribes to stereo_image_topic_name and publishes its two halves
+ * on left/image_color and right/image_color.
+ *
+ * layout is side_by_side (left eye on the left) or top_bottom (left eye on
+ * top). Each half is copied once into its message, in the encoding of the
+ * stereo image. Loaded in the manager of the camera and of ar_core, the
+ * messages are passed as pointers and never serialized. Both halves keep
+ * the header of the stereo image, so the pairs stay exactly synchronized.
+ */
+class StereoSplitNodelet : public nodelet::Nodelet {
+public:
+
+    virtual void onInit();
+
+private:
+    void ImageCallback(const sensor_msgs::ImageConstPtr &msg);
+
+    bool top_bottom_;
+    std::shared_ptr<image_transport::ImageTransport> it_;
+    image_transport::Subscriber subscriber_;
+    image_transport::Publisher publishers_[2];
+};
+
+//------------------------------------------------------------------------------
+void StereoSplitNodelet::onInit() {
+
+    ros::NodeHandle &nh = getNodeHandle();
+    ros::NodeHandle &private_nh = getPrivateNodeHandle();
+
+    std::string stereo_image_topic_name;
+    if(!private_nh.getParam("stereo_image_topic_name",
+                            stereo_image_topic_name)) {
+        NODELET_ERROR("Parameter '%s' is required.",
+                      private_nh.resolveName("stereo_image_topic_name")
+                              .c_str());
+        return;
+    }
+
+    std::string layout;
+    private_nh.param<std::string>("layout", layout, "side_by_side");
+    if(layout != "side_by_side" && layout != "top_bottom") {
+        NODELET_WARN("Unknown layout '%s', using side_by_side.",
+                     layout.c_str());
+        layout = "side_by_side";
+    }
+    top_bottom_ = layout == "top_bottom";
+
+    it_.reset(new image_transport::ImageTransport(nh));
+    publishers_[0] = it_->advertise("left/image_color", 1);
+    publishers_[1] = it_->advertise("right/image_color", 1);
+    subscriber_ = it_->subscribe(
+            stereo_image_topic_name, 1, &StereoSplitNodelet::ImageCallback,
+            this, image_transport::TransportHints(
+                    "raw", ros::TransportHints(), private_nh));
+    NODELET_INFO("Splitting '%s' (%s).", stereo_image_topic_name.c_str(),
+                 layout.c_str());
+}
+
+//------------------------------------------------------------------------------
+void StereoSplitNodelet::ImageCallback(
+        const sensor_msgs::ImageConstPtr &msg) {
+
+    cv_bridge::CvImageConstPtr stereo;
+    try {
+        stereo = cv_bridge::toCvShare(msg);
+    }
+    catch (cv_bridge::Exception &e) {
+        NODELET_ERROR("Could not read the stereo image: %s", e.what());
+        return;
+    }
+
+    const cv::Mat &image = stereo->image;
+    const cv::Rect halves[2] = {
+            top_bottom_ ? cv::Rect(0, 0, image.cols, image.rows / 2)
+                        : cv::Rect(0, 0, image.cols / 2, image.rows),
+            top_bottom_ ? cv::Rect(0, image.rows / 2, image.cols,
+                                   image.rows / 2)
+                        : cv::Rect(image.cols / 2, 0, image.cols / 2,
+                                   image.rows)};
+
+    for (int i = 0; i < 2; ++i) {
+        if(publishers_[i].getNumSubscribers() == 0)
+            continue;
+        // toImageMsg copies the half, the roi is not continuous
+        publishers_[i].publish(cv_bridge::CvImage(
+                msg->header, msg->encoding, image(halves[i])).toImageMsg());
+    }
+}
+
+}
+
+#include <pluginlib/class_list_macros.h>
+PLUGINLIB_EXPORT_CLASS(atar::StereoSplitNodelet, nodelet::Nodelet)
@@ -0,0 +1,41 @@
+//
+// The usb camera capture as a nodelet, to share a manager with ar_core and
+// the board detectors.
+//
+
+#include <memory>
+#include <stdexcept>
+#include <nodelet/nodelet.h>
+#include "StereoUsbCamPublisher.h"
+
+namespace atar {
+
+/**
+ * \class StereoUsbCamNodelet
+ * \brief Runs StereoUsbCamPublisher in a nodelet manager. The capture
+ * threads publish the messages of their pools as shared pointers, so the
+ * nodelets of the same manager receive the frames without any copy.
+ */
+class StereoUsbCamNodelet : public nodelet::Nodelet {
+public:
+
+    virtual void onInit() {
+        try {
+            publisher_.reset(new StereoUsbCamPublisher(
+                    getNodeHandle(), getPrivateNodeHandle()));
+            publisher_->Start();
+        }
+        catch (std::runtime_error &e) {
+            NODELET_ERROR("%s", e.what());
+            publisher_.reset();
+        }
+    }
+
+private:
+    std::unique_ptr<StereoUsbCamPublisher> publisher_;
+};
+
+}
+
+#include <pluginlib/class_list_macros.h>
+PLUGINLIB_EXPORT_CLASS(atar::StereoUsbCamNodelet, nodelet::Nodelet)
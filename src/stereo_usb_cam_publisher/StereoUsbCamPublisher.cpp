@@ -0,0 +1,319 @@
+//
+// Captures the images of one or two usb cameras and publishes them.
+//
+
+#include "StereoUsbCamPublisher.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <boost/make_shared.hpp>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <sensor_msgs/image_encodings.h>
+
+namespace {
+
+//------------------------------------------------------------------------------
+void AddValue(diagnostic_msgs::DiagnosticStatus &status,
+              const std::string &key, const double value) {
+    diagnostic_msgs::KeyValue key_value;
+    key_value.key = key;
+    key_value.value = std::to_string(value);
+    status.values.push_back(key_value);
+}
+
+//------------------------------------------------------------------------------
+// Sets the layout of msg and copies frame in it, when retrieve() could not
+// decode in the data of the message
+bool CopyToMessage(const cv::Mat &frame, sensor_msgs::Image &msg) {
+
+    if(frame.type() == CV_8UC3)
+        msg.encoding = sensor_msgs::image_encodings::BGR8;
+    else if(frame.type() == CV_8UC1)
+        msg.encoding = sensor_msgs::image_encodings::MONO8;
+    else
+        return false;
+
+    msg.height = (uint32_t)frame.rows;
+    msg.width = (uint32_t)frame.cols;
+    msg.is_bigendian = 0;
+    msg.step = (uint32_t)(frame.cols * frame.elemSize());
+    msg.data.resize((size_t)msg.step * frame.rows);
+    for (int row = 0; row < frame.rows; ++row)
+        std::memcpy(msg.data.data() + (size_t)row * msg.step,
+                    frame.ptr(row), msg.step);
+    return true;
+}
+
+}
+
+//------------------------------------------------------------------------------
+StereoUsbCamPublisher::StereoUsbCamPublisher(ros::NodeHandle nh,
+                                             ros::NodeHandle private_nh)
+        : nh_(nh), it_(nh),
+          running_(false), arrived_(0), generation_(0),
+          grabbed_(0), cycle_failed_(false),
+          last_skew_(0.0), max_skew_(0.0), sum_skew_(0.0), num_skews_(0)
+{
+    std::vector<int> camera_ids = {0, 1};
+    private_nh.getParam("camera_ids", camera_ids);
+    std::vector<std::string> topic_names =
+            {"left/image_color", "right/image_color"};
+    private_nh.getParam("topic_names", topic_names);
+    std::vector<std::string> frame_ids = {"camera_left", "camera_right"};
+    private_nh.getParam("frame_ids", frame_ids);
+    if(camera_ids.empty() || camera_ids.size() > topic_names.size()
+       || camera_ids.size() > frame_ids.size())
+        throw std::runtime_error("StereoUsbCamPublisher: camera_ids needs "
+                                         "as many topic_names and frame_ids.");
+
+    private_nh.param<int>("frame_width", frame_width_, 0);
+    private_nh.param<int>("frame_height", frame_height_, 0);
+    private_nh.param<double>("frame_rate", frame_rate_, 0.0);
+    int pool_size = 4;
+    private_nh.param<int>("buffer_pool_size", pool_size, 4);
+
+    for (size_t i = 0; i < camera_ids.size(); ++i) {
+        cameras_.push_back(std::unique_ptr<Camera>(new Camera));
+        Camera &camera = *cameras_.back();
+        camera.id = camera_ids[i];
+        camera.frame_id = frame_ids[i];
+        camera.publisher = it_.advertise(topic_names[i], 1);
+        for (int k = 0; k < std::max(2, pool_size); ++k)
+            camera.pool.push_back(boost::make_shared<sensor_msgs::Image>());
+        ROS_INFO("Camera %d published on '%s'", camera.id,
+                 nh_.resolveName(topic_names[i]).c_str());
+    }
+
+    publisher_diagnostics_ = nh_.advertise<diagnostic_msgs::DiagnosticArray>(
+            "/diagnostics", 1);
+}
+
+//------------------------------------------------------------------------------
+StereoUsbCamPublisher::~StereoUsbCamPublisher() {
+    Stop();
+}
+
+//------------------------------------------------------------------------------
+void StereoUsbCamPublisher::Start() {
+
+    for (size_t i = 0; i < cameras_.size(); ++i) {
+        Camera &camera = *cameras_[i];
+        if(!camera.capture.open(camera.id))
+            throw std::runtime_error("Could not open camera "
+                                     + std::to_string(camera.id));
+        if(frame_width_ > 0 && frame_height_ > 0) {
+            camera.capture.set(cv::CAP_PROP_FRAME_WIDTH, frame_width_);
+            camera.capture.set(cv::CAP_PROP_FRAME_HEIGHT, frame_height_);
+        }
+        if(frame_rate_ > 0.0)
+            camera.capture.set(cv::CAP_PROP_FPS, frame_rate_);
+        ROS_INFO("Camera %d opened: %.0fx%.0f at %.0f fps", camera.id,
+                 camera.capture.get(cv::CAP_PROP_FRAME_WIDTH),
+                 camera.capture.get(cv::CAP_PROP_FRAME_HEIGHT),
+                 camera.capture.get(cv::CAP_PROP_FPS));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = true;
+        arrived_ = 0;
+    }
+    for (size_t i = 0; i < cameras_.size(); ++i)
+        cameras_[i]->thread = std::thread(
+                &StereoUsbCamPublisher::CaptureThread, this,
+                std::ref(*cameras_[i]));
+
+    last_diagnostics_time_ = ros::WallTime::now();
+    diagnostics_timer_ = nh_.createWallTimer(
+            ros::WallDuration(1.0),
+            &StereoUsbCamPublisher::PublishDiagnostics, this);
+}
+
+//------------------------------------------------------------------------------
+void StereoUsbCamPublisher::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    barrier_condition_.notify_all();
+    diagnostics_timer_.stop();
+
+    for (size_t i = 0; i < cameras_.size(); ++i) {
+        if(cameras_[i]->thread.joinable())
+            cameras_[i]->thread.join();
+        cameras_[i]->capture.release();
+    }
+}
+
+//------------------------------------------------------------------------------
+void StereoUsbCamPublisher::CaptureThread(Camera &camera) {
+
+    while (WaitForAllCameras()) {
+
+        // the other cameras grab now too
+        if(!camera.capture.grab()) {
+            RecordGrab(camera, ros::Time());
+            ROS_WARN_THROTTLE(5, "Camera %d: grab failed.", camera.id);
+            // the other threads wait for this one at the barrier
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        const ros::Time stamp = ros::Time::now();
+        RecordGrab(camera, stamp);
+
+        // decode in the data of the message when it has the size of the
+        // frame, which it has from its second use on
+        sensor_msgs::ImagePtr msg = AcquireBuffer(camera);
+        cv::Mat frame;
+        if(!msg->data.empty()) {
+            const bool mono =
+                    msg->encoding == sensor_msgs::image_encodings::MONO8;
+            frame = cv::Mat((int)msg->height, (int)msg->width,
+                            mono ? CV_8UC1 : CV_8UC3, msg->data.data(),
+                            msg->step);
+        }
+        if(!camera.capture.retrieve(frame) || frame.empty())
+            continue;
+        if(frame.data != msg->data.data() && !CopyToMessage(frame, *msg)) {
+            ROS_ERROR_THROTTLE(5, "Camera %d: unsupported image type %d.",
+                               camera.id, frame.type());
+            continue;
+        }
+
+        msg->header.stamp = stamp;
+        msg->header.frame_id = camera.frame_id;
+        camera.publisher.publish(msg);
+    }
+}
+
+//------------------------------------------------------------------------------
+bool StereoUsbCamPublisher::WaitForAllCameras() {
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(!running_)
+        return false;
+
+    const uint64_t generation = generation_;
+    if(++arrived_ == cameras_.size()) {
+        arrived_ = 0;
+        generation_++;
+        barrier_condition_.notify_all();
+        return true;
+    }
+    barrier_condition_.wait(lock, [this, generation] {
+        return generation_ != generation || !running_;
+    });
+    return running_;
+}
+
+//------------------------------------------------------------------------------
+void StereoUsbCamPublisher::RecordGrab(Camera &camera,
+                                       const ros::Time &stamp) {
+
+    std::lock_guard<std::mutex> lock(statistics_mutex_);
+    camera.grab_stamp = stamp;
+    if(stamp.isZero()) {
+        camera.failed_grabs++;
+        cycle_failed_ = true;
+    }
+    else
+        camera.frames++;
+    if(++grabbed_ < cameras_.size())
+        return;
+
+    // all the cameras went through this cycle
+    grabbed_ = 0;
+    const bool failed = cycle_failed_;
+    cycle_failed_ = false;
+    if(failed || cameras_.size() < 2)
+        return;
+    ros::Time first = cameras_[0]->grab_stamp;
+    ros::Time last = first;
+    for (size_t i = 1; i < cameras_.size(); ++i) {
+        first = std::min(first, cameras_[i]->grab_stamp);
+        last = std::max(last, cameras_[i]->grab_stamp);
+    }
+    last_skew_ = (last - first).toSec();
+    max_skew_ = std::max(max_skew_, last_skew_);
+    sum_skew_ += last_skew_;
+    num_skews_++;
+}
+
+//------------------------------------------------------------------------------
+sensor_msgs::ImagePtr StereoUsbCamPublisher::AcquireBuffer(Camera &camera) {
+
+    const size_t pool_size = camera.pool.size();
+    for (size_t k = 0; k < pool_size; ++k) {
+        const size_t index = (camera.next_buffer + k) % pool_size;
+        if(camera.pool[index].unique()) {
+            camera.next_buffer = (index + 1) % pool_size;
+            return camera.pool[index];
+        }
+    }
+
+    // all held by subscribers: the oldest is left to them
+    {
+        std::lock_guard<std::mutex> lock(statistics_mutex_);
+        camera.pool_misses++;
+    }
+    const size_t index = camera.next_buffer;
+    camera.pool[index] = boost::make_shared<sensor_msgs::Image>();
+    camera.next_buffer = (index + 1) % pool_size;
+    return camera.pool[index];
+}
+
+//------------------------------------------------------------------------------
+void StereoUsbCamPublisher::PublishDiagnostics(const ros::WallTimerEvent &) {
+
+    const ros::WallTime now = ros::WallTime::now();
+    const double elapsed = (now - last_diagnostics_time_).toSec();
+    last_diagnostics_time_ = now;
+    if(elapsed <= 0.0)
+        return;
+
+    diagnostic_msgs::DiagnosticArray msg;
+    msg.header.stamp = ros::Time::now();
+
+    std::lock_guard<std::mutex> lock(statistics_mutex_);
+    std::string summary;
+    for (size_t i = 0; i < cameras_.size(); ++i) {
+        Camera &camera = *cameras_[i];
+        const double fps = (camera.frames - camera.reported_frames) / elapsed;
+        camera.reported_frames = camera.frames;
+
+        diagnostic_msgs::DiagnosticStatus status;
+        status.name = nh_.getNamespace() + ": camera "
+                      + std::to_string(camera.id);
+        status.hardware_id = "usb_camera_" + std::to_string(camera.id);
+        status.level = diagnostic_msgs::DiagnosticStatus::OK;
+        status.message = "OK";
+        if(fps == 0.0) {
+            status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+            status.message = "No frame grabbed";
+        }
+        AddValue(status, "fps", fps);
+        AddValue(status, "frames", (double)camera.frames);
+        AddValue(status, "failed_grabs", (double)camera.failed_grabs);
+        AddValue(status, "buffer_pool_misses", (double)camera.pool_misses);
+        msg.status.push_back(status);
+        summary += " camera " + std::to_string(camera.id) + " "
+                   + std::to_string((int)(fps + 0.5)) + " fps";
+    }
+
+    if(cameras_.size() > 1) {
+        diagnostic_msgs::DiagnosticStatus status;
+        status.name = nh_.getNamespace() + ": inter-camera skew";
+        status.hardware_id = "stereo_camera";
+        status.level = diagnostic_msgs::DiagnosticStatus::OK;
+        status.message = "OK";
+        AddValue(status, "last_skew_ms", last_skew_ * 1000.0);
+        AddValue(status, "mean_skew_ms",
+                 num_skews_ ? sum_skew_ / num_skews_ * 1000.0 : 0.0);
+        AddValue(status, "max_skew_ms", max_skew_ * 1000.0);
+        msg.status.push_back(status);
+        summary += ", skew " + std::to_string(last_skew_ * 1000.0) + " ms";
+    }
+
+    publisher_diagnostics_.publish(msg);
+    ROS_INFO_THROTTLE(10, "Capture:%s", summary.c_str());
+}
@@ -0,0 +1,121 @@
+//
+// Captures the images of one or two usb cameras and publishes them.
+//
+
+#ifndef ATAR_STEREOUSBCAMPUBLISHER_H
+#define ATAR_STEREOUSBCAMPUBLISHER_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include <ros/ros.h>
+#include <image_transport/image_transport.h>
+#include <sensor_msgs/Image.h>
+#include <opencv2/videoio.hpp>
+
+/**
+ * \class StereoUsbCamPublisher
+ * \brief One capture thread per camera. The threads grab together: each
+ * one waits for the others before calling grab(), so the frames of the two
+ * cameras are latched at nearly the same time. The slower decoding in
+ * retrieve() comes after. Each frame is stamped at its grab.
+ *
+ * A frame is retrieved straight into the data of a message from a small
+ * pool per camera. A message is reused once no subscriber holds it any
+ * more; subscribers in the same process, such as nodelets, get it without
+ * any copy.
+ *
+ * The frames per second of each camera and the skew between the grab
+ * stamps of the cameras are published on /diagnostics every second.
+ *
+ * Parameters, read from the private node handle:
+ *  camera_ids          device ids, default [0, 1]
+ *  topic_names         default [left/image_color, right/image_color]
+ *  frame_ids           default [camera_left, camera_right]
+ *  frame_width/height  requested resolution, 0 keeps the camera's
+ *  frame_rate          requested rate, 0 keeps the camera's
+ *  buffer_pool_size    messages per camera, default 4
+ */
+class StereoUsbCamPublisher {
+public:
+
+    // The images are advertised in nh, the parameters are read from
+    // private_nh
+    StereoUsbCamPublisher(ros::NodeHandle nh, ros::NodeHandle private_nh);
+
+    ~StereoUsbCamPublisher();
+
+    // Opens the cameras and starts the capture threads. Throws
+    // std::runtime_error if a camera can not be opened.
+    void Start();
+
+    // Stops and joins the capture threads and releases the cameras
+    void Stop();
+
+private:
+
+    struct Camera {
+        int id;
+        std::string frame_id;
+        cv::VideoCapture capture;
+        image_transport::Publisher publisher;
+        std::vector<sensor_msgs::ImagePtr> pool;
+        size_t next_buffer = 0;
+        std::thread thread;
+
+        // guarded by statistics_mutex_
+        ros::Time grab_stamp;
+        uint64_t frames = 0;
+        uint64_t failed_grabs = 0;
+        // no free message in the pool, a new one was allocated
+        uint64_t pool_misses = 0;
+        // frames at the last diagnostics
+        uint64_t reported_frames = 0;
+    };
+
+    void CaptureThread(Camera &camera);
+
+    // Barrier of the capture threads before each grab. Returns false when
+    // the capture is stopped.
+    bool WaitForAllCameras();
+
+    // Records the grab stamp, zero if the grab failed, and once all the
+    // cameras grabbed, the skew
+    void RecordGrab(Camera &camera, const ros::Time &stamp);
+
+    // A message of the pool that no subscriber holds
+    sensor_msgs::ImagePtr AcquireBuffer(Camera &camera);
+
+    void PublishDiagnostics(const ros::WallTimerEvent &);
+
+    ros::NodeHandle nh_;
+    image_transport::ImageTransport it_;
+    std::vector<std::unique_ptr<Camera> > cameras_;
+    int frame_width_;
+    int frame_height_;
+    double frame_rate_;
+
+    std::mutex mutex_;
+    std::condition_variable barrier_condition_;
+    bool running_;
+    size_t arrived_;
+    uint64_t generation_;
+
+    std::mutex statistics_mutex_;
+    // cameras that went through the current cycle, and if one failed
+    size_t grabbed_;
+    bool cycle_failed_;
+    double last_skew_;
+    double max_skew_;
+    double sum_skew_;
+    uint64_t num_skews_;
+
+    ros::Publisher publisher_diagnostics_;
+    ros::WallTimer diagnostics_timer_;
+    ros::WallTime last_diagnostics_time_;
+};
+
+#endif //ATAR_STEREOUSBCAMPUBLISHER_H
@@ -1,10 +1,15 @@
 //
 // Created by nima on 24/05/17.
 //
+// Captures and publishes the images of one or two usb cameras. The camera
+// ids can be given on the command line, otherwise they are read from the
+// camera_ids parameter. See StereoUsbCamPublisher for the parameters.
+//
 #include <iostream>
+#include <stdexcept>
 #include <ros/ros.h>
-#include <opencv2/highgui.hpp>
 #include <opencv2/core.hpp>
+#include "StereoUsbCamPublisher.h"
 
 
 namespace {
@@ -17,74 +22,42 @@ namespace {
 
 int main(int argc, char *argv[]){
 
-    cv::CommandLineParser parser(argc, argv, keys);
+    ros::init(argc, argv, "usb_cam_publisher");
+    ros::NodeHandle n;
+    ros::NodeHandle private_n("~");
+
+    // the arguments left once ros removed the remappings
+    std::vector<std::string> args;
+    ros::removeROSArgs(argc, argv, args);
+    std::vector<const char *> argv_left;
+    for (size_t i = 0; i < args.size(); ++i)
+        argv_left.push_back(args[i].c_str());
+
+    cv::CommandLineParser parser((int)argv_left.size(), argv_left.data(),
+                                 keys);
     parser.about(about);
 
-
     std::vector<int> cam_ids;
-    std::vector<std::string> window_names;
-
-    std::cout << "argc= " << argc << std::endl;
-    if(argc == 3){
+    if(parser.has("id1"))
         cam_ids.push_back(parser.get<int>("id1"));
-        std::cout << "Using uSB cam with id " << cam_ids[0] << std::endl;
-
+    if(parser.has("id2"))
         cam_ids.push_back(parser.get<int>("id2"));
-        std::cout << "Using uSB cam with id " << cam_ids[1] << std::endl;
-    }
-    else if(argc == 2) {
-        cam_ids.push_back(parser.get<int>("id1"));
+    if(!cam_ids.empty())
+        private_n.setParam("camera_ids", cam_ids);
+
+    try {
+        StereoUsbCamPublisher publisher(n, private_n);
+        publisher.Start();
+        // the publishing happens in the capture threads, the spinner only
+        // serves the subscriber connections and the diagnostics timer
+        ros::spin();
+        publisher.Stop();
     }
-    else{
+    catch (std::runtime_error &e) {
+        ROS_ERROR("%s", e.what());
         parser.printMessage();
-        return 0;
-    }
-
-
-    for (int i = 0; i < cam_ids.size(); ++i) {
-        std::stringstream win_name;
-        win_name << "cam " << cam_ids[i];
-        window_names.push_back(win_name.str());
+        return 1;
     }
 
-
-    ros::init(argc, argv, "usb_cam_publisher");
-    std::string ros_node_name = ros::this_node::getName();
-    ros::NodeHandle n(ros_node_name);
-
-
-    ros::Rate loop_rate(1);
-
-    cv::VideoCapture inputVideo[cam_ids.size()];
-    int waitTime;
-
-
-    for (int i = 0; i < cam_ids.size(); ++i) {
-        inputVideo[i].open(cam_ids[i]);
-    }
-
-
-
-    while(ros::ok() ){
-
-        for (int i = 0; i < cam_ids.size(); ++i) {
-            inputVideo[i].grab();
-            cv::Mat image;
-            inputVideo[i].retrieve(image);
-
-            imshow(window_names[i], image);
-            loop_rate.sleep();
-
-
-        }
-
-        char key = (char)cv::waitKey(1);
-        if(key == 27) break;
-
-
-        ros::spinOnce();
-        loop_rate.sleep();
-    }
-
-
+    return 0;
 }
@@ -0,0 +1,190 @@
+//
+// Compares the conversion of a rendered image to OpenCV's layout done with
+// cvtColor followed by flip, as ar_core used to do after each readback, with
+// the single pass ImageKernels::FlipVerticalAndSwapRedBlue.
+//
+// Then compares, for each camera encoding, the decoding to bgr8 done by
+// cv_bridge (a cvtColor into a new image) with ImageKernels::DecodeToBGR.
+//
+// usage: benchmark_image_kernels [iterations]
+//
+// Exits with 1 if a result differs from OpenCV's by more than the rounding.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#include "../ar_core/ImageKernels.h"
+
+typedef std::chrono::steady_clock Clock;
+
+//------------------------------------------------------------------------------
+double MsPerFrame(const Clock::time_point start, const Clock::time_point end,
+                  const int iterations) {
+    return std::chrono::duration<double, std::milli>(end - start).count()
+           / (double)iterations;
+}
+
+//------------------------------------------------------------------------------
+// The previous path: a new image for the conversion, then a second pass to
+// flip it
+double TwoPass(const cv::Mat &rendered, cv::Mat &result,
+               const int iterations) {
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        cv::Mat converted;
+        cv::cvtColor(rendered, converted, cv::COLOR_RGB2BGR);
+        cv::flip(converted, converted, 0);
+        result = converted;
+    }
+    return MsPerFrame(start, Clock::now(), iterations);
+}
+
+//------------------------------------------------------------------------------
+double Fused(const cv::Mat &rendered, cv::Mat &result, const int iterations) {
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; ++i)
+        ImageKernels::FlipVerticalAndSwapRedBlue(rendered, result);
+    return MsPerFrame(start, Clock::now(), iterations);
+}
+
+//------------------------------------------------------------------------------
+struct Encoding {
+    const char *name;
+    int raw_type;
+    // the conversion cv_bridge does to get bgr8, -1 for none
+    int cv_bridge_code;
+};
+
+//------------------------------------------------------------------------------
+double CvBridgeDecode(const cv::Mat &raw, const Encoding &encoding,
+                      cv::Mat &result, const int iterations) {
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        cv::Mat decoded;
+        if (encoding.cv_bridge_code < 0)
+            decoded = raw;
+        else
+            cv::cvtColor(raw, decoded, encoding.cv_bridge_code);
+        result = decoded;
+    }
+    return MsPerFrame(start, Clock::now(), iterations);
+}
+
+//------------------------------------------------------------------------------
+double Decode(const cv::Mat &raw, const Encoding &encoding, cv::Mat &result,
+              const int iterations) {
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; ++i)
+        ImageKernels::DecodeToBGR(raw, encoding.name, result);
+    return MsPerFrame(start, Clock::now(), iterations);
+}
+
+//------------------------------------------------------------------------------
+// Returns false if a decoded image differs from cv_bridge's by more than one
+bool BenchmarkDecode(const cv::Size sizes[3], const int iterations) {
+
+    const Encoding encodings[] = {
+            {"bgr8",        CV_8UC3, -1},
+            {"rgb8",        CV_8UC3, cv::COLOR_RGB2BGR},
+            {"mono8",       CV_8UC1, cv::COLOR_GRAY2BGR},
+            {"yuv422",      CV_8UC2, cv::COLOR_YUV2BGR_UYVY},
+            {"bayer_rggb8", CV_8UC1, cv::COLOR_BayerBG2BGR}};
+    const int num_encodings = sizeof(encodings) / sizeof(encodings[0]);
+    bool all_match = true;
+
+    printf("\n%-12s %-12s %16s %16s %9s %9s\n", "size", "encoding",
+           "cv_bridge [ms]", "decode [ms]", "speedup", "max diff");
+
+    for (int s = 0; s < 3; ++s) {
+        for (int e = 0; e < num_encodings; ++e) {
+
+            cv::Mat raw(sizes[s], encodings[e].raw_type);
+            cv::randu(raw, cv::Scalar::all(0), cv::Scalar::all(255));
+
+            cv::Mat cv_bridge_result, decode_result;
+            CvBridgeDecode(raw, encodings[e], cv_bridge_result, 5);
+            Decode(raw, encodings[e], decode_result, 5);
+
+            double cv_bridge_ms = CvBridgeDecode(raw, encodings[e],
+                                                 cv_bridge_result, iterations);
+            double decode_ms = Decode(raw, encodings[e], decode_result,
+                                      iterations);
+
+            // the yuv coefficients are the same as OpenCV's but the
+            // rounding may differ by one
+            double max_diff = cv::norm(cv_bridge_result, decode_result,
+                                       cv::NORM_INF);
+            if (max_diff > 1.0)
+                all_match = false;
+
+            char size_name[32];
+            snprintf(size_name, sizeof(size_name), "%dx%d", sizes[s].width,
+                     sizes[s].height);
+            printf("%-12s %-12s %16.3f %16.3f %8.2fx %9.0f\n", size_name,
+                   encodings[e].name, cv_bridge_ms, decode_ms,
+                   cv_bridge_ms / decode_ms, max_diff);
+        }
+    }
+    return all_match;
+}
+
+//------------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 200;
+    if (iterations < 1) {
+        printf("usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    // the sizes of one eye
+    const cv::Size sizes[3] = {cv::Size(640, 480), cv::Size(1280, 720),
+                               cv::Size(1920, 1080)};
+
+    printf("%d iterations, %d threads\n\n", iterations,
+           cv::getNumThreads());
+    printf("%-12s %16s %16s %9s %10s\n", "size", "two pass [ms]",
+           "fused [ms]", "speedup", "identical");
+    bool all_match = true;
+
+    for (int s = 0; s < 3; ++s) {
+
+        cv::Mat rendered(sizes[s], CV_8UC3);
+        cv::randu(rendered, cv::Scalar::all(0), cv::Scalar::all(255));
+
+        cv::Mat two_pass_result, fused_result;
+        // warm up, and let the fused path allocate its output once
+        TwoPass(rendered, two_pass_result, 5);
+        Fused(rendered, fused_result, 5);
+
+        double two_pass_ms = TwoPass(rendered, two_pass_result, iterations);
+        double fused_ms = Fused(rendered, fused_result, iterations);
+
+        bool identical = cv::countNonZero(
+                (two_pass_result != fused_result).reshape(1)) == 0;
+        if (!identical)
+            all_match = false;
+
+        char size_name[32];
+        snprintf(size_name, sizeof(size_name), "%dx%d", sizes[s].width,
+                 sizes[s].height);
+        printf("%-12s %16.3f %16.3f %8.2fx %10s\n", size_name, two_pass_ms,
+               fused_ms, two_pass_ms / fused_ms, identical ? "yes" : "NO");
+    }
+
+    if (!BenchmarkDecode(sizes, iterations))
+        all_match = false;
+
+    if (!all_match) {
+        printf("\nFAILED: the results differ from OpenCV's\n");
+        return 1;
+    }
+    return 0;
+}
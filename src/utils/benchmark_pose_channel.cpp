@@ -0,0 +1,106 @@
+//
+// Measures the cost of writing and reading a PoseChannel, alone and while
+// other threads hammer the same channel, like the ROS callbacks, the haptics
+// loop and the render loop do in ar_core.
+//
+// usage: benchmark_pose_channel [iterations] [reader threads]
+//
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "../ar_core/SeqLockChannel.h"
+
+typedef std::chrono::steady_clock Clock;
+
+//------------------------------------------------------------------------------
+double NsPerOp(const Clock::time_point start, const Clock::time_point end,
+               const uint64_t ops) {
+    return std::chrono::duration<double, std::nano>(end - start).count()
+           / (double)ops;
+}
+
+//------------------------------------------------------------------------------
+// The writer changes all the elements of the pose so that a torn read can be
+// detected: in every sample written p.x() == p.y() == p.z().
+void WriterLoop(PoseChannel &channel, const uint64_t iterations,
+                double &ns_per_op) {
+
+    KDL::Frame pose;
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        double v = (double)i;
+        pose.p = KDL::Vector(v, v, v);
+        pose.M = KDL::Rotation::RotZ(v);
+        channel.Write(pose, ros::Time(0, 1));
+    }
+    ns_per_op = NsPerOp(start, Clock::now(), iterations);
+}
+
+//------------------------------------------------------------------------------
+void ReaderLoop(const PoseChannel &channel, const uint64_t iterations,
+                double &ns_per_op, uint64_t &torn_reads) {
+
+    KDL::Frame pose;
+    torn_reads = 0;
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        channel.Read(pose);
+        if (pose.p.x() != pose.p.y() || pose.p.y() != pose.p.z())
+            torn_reads++;
+    }
+    ns_per_op = NsPerOp(start, Clock::now(), iterations);
+}
+
+//------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+
+    uint64_t iterations = (argc > 1) ? std::strtoull(argv[1], NULL, 10)
+                                     : 10000000;
+    int n_readers = (argc > 2) ? std::atoi(argv[2]) : 2;
+    if (iterations == 0 || n_readers < 1) {
+        std::fprintf(stderr,
+                     "usage: %s [iterations] [reader threads]\n", argv[0]);
+        return 1;
+    }
+
+    PoseChannel channel;
+    double writer_ns, reader_ns;
+    uint64_t torn;
+
+    // ---------------------- without contention
+    WriterLoop(channel, iterations, writer_ns);
+    ReaderLoop(channel, iterations, reader_ns, torn);
+    std::printf("uncontended:  write %7.1f ns/op  read %7.1f ns/op\n",
+                writer_ns, reader_ns);
+
+    // ---------------------- one writer and n readers at the same time
+    std::vector<double> readers_ns(n_readers);
+    std::vector<uint64_t> readers_torn(n_readers);
+    std::vector<std::thread> readers;
+
+    std::thread writer(WriterLoop, std::ref(channel), iterations,
+                       std::ref(writer_ns));
+    for (int k = 0; k < n_readers; ++k)
+        readers.push_back(std::thread(ReaderLoop, std::cref(channel),
+                                      iterations, std::ref(readers_ns[k]),
+                                      std::ref(readers_torn[k])));
+    writer.join();
+    for (int k = 0; k < n_readers; ++k)
+        readers[k].join();
+
+    std::printf("contended:    write %7.1f ns/op  (%d readers)\n",
+                writer_ns, n_readers);
+    uint64_t total_torn = 0;
+    for (int k = 0; k < n_readers; ++k) {
+        std::printf("              read  %7.1f ns/op  reader %d\n",
+                    readers_ns[k], k);
+        total_torn += readers_torn[k];
+    }
+    std::printf("torn reads:   %llu\n", (unsigned long long)total_torn);
+
+    return total_torn == 0 ? 0 : 2;
+}
@@ -0,0 +1,163 @@
+//
+// Compares the raw and the shm image transports between two processes, the
+// way the camera nodes feed ar_core and the board detectors.
+//
+// The publisher sends synthetic bgr8 frames on /benchmark_shm/image. The
+// subscriber subscribes with each transport in turn and reports the frames
+// received per second, the throughput, the frames lost and the latency
+// from the stamp of the frame to the callback.
+//
+// usage: benchmark_shm_transport pub [width height] [rate]
+//        benchmark_shm_transport sub [seconds per transport]
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+#include <image_transport/image_transport.h>
+#include <sensor_msgs/image_encodings.h>
+
+namespace {
+
+const char *kTopic = "/benchmark_shm/image";
+
+//------------------------------------------------------------------------------
+int Publish(const uint32_t width, const uint32_t height, const double rate) {
+
+    ros::NodeHandle n;
+    image_transport::ImageTransport it(n);
+    image_transport::Publisher publisher = it.advertise(kTopic, 1);
+
+    sensor_msgs::Image image;
+    image.height = height;
+    image.width = width;
+    image.encoding = sensor_msgs::image_encodings::BGR8;
+    image.is_bigendian = 0;
+    image.step = 3 * width;
+    image.data.resize((size_t)image.step * height);
+    for (size_t i = 0; i < image.data.size(); ++i)
+        image.data[i] = (uint8_t)i;
+
+    std::printf("publishing %ux%u bgr8 (%.1f MB) at %.0f Hz on %s\n",
+                width, height, image.data.size() / 1e6, rate, kTopic);
+
+    // the frame number is written in the first bytes so that the
+    // subscriber can count the lost frames
+    uint64_t frame = 0;
+    ros::Rate loop_rate(rate);
+    while (ros::ok()) {
+        std::memcpy(image.data.data(), &frame, sizeof(frame));
+        image.header.stamp = ros::Time::now();
+        publisher.publish(image);
+        frame++;
+        ros::spinOnce();
+        loop_rate.sleep();
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+struct Statistics {
+
+    Statistics() : frames(0), bytes(0), lost(0), last_frame(0) {}
+
+    void Callback(const sensor_msgs::ImageConstPtr &msg) {
+
+        latencies_ms.push_back(
+                (ros::Time::now() - msg->header.stamp).toSec() * 1000.0);
+        uint64_t frame = 0;
+        if(msg->data.size() >= sizeof(frame))
+            std::memcpy(&frame, msg->data.data(), sizeof(frame));
+        if(frames > 0 && frame > last_frame + 1)
+            lost += frame - last_frame - 1;
+        last_frame = frame;
+        frames++;
+        bytes += msg->data.size();
+    }
+
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t lost;
+    uint64_t last_frame;
+    std::vector<double> latencies_ms;
+};
+
+//------------------------------------------------------------------------------
+void Measure(const std::string &transport, const double seconds) {
+
+    ros::NodeHandle n;
+    image_transport::ImageTransport it(n);
+    Statistics statistics;
+    image_transport::Subscriber subscriber = it.subscribe(
+            kTopic, 1, &Statistics::Callback, &statistics,
+            image_transport::TransportHints(transport));
+
+    // let the connection settle before measuring
+    ros::WallTime start = ros::WallTime::now();
+    while (ros::ok() && (ros::WallTime::now() - start).toSec() < 1.0)
+        ros::spinOnce();
+    statistics = Statistics();
+
+    start = ros::WallTime::now();
+    while (ros::ok() && (ros::WallTime::now() - start).toSec() < seconds)
+        ros::spinOnce();
+    const double elapsed = (ros::WallTime::now() - start).toSec();
+    subscriber.shutdown();
+
+    std::vector<double> &latencies = statistics.latencies_ms;
+    double mean = 0.0, p95 = 0.0;
+    if(!latencies.empty()) {
+        for (size_t i = 0; i < latencies.size(); ++i)
+            mean += latencies[i];
+        mean /= latencies.size();
+        std::sort(latencies.begin(), latencies.end());
+        p95 = latencies[(size_t)(0.95 * (latencies.size() - 1))];
+    }
+    std::printf("%-5s %8.1f fps %9.1f MB/s %6llu lost   latency mean %6.2f ms"
+                "  p95 %6.2f ms\n",
+                transport.c_str(), statistics.frames / elapsed,
+                statistics.bytes / elapsed / 1e6,
+                (unsigned long long)statistics.lost, mean, p95);
+}
+
+}
+
+//------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+
+    ros::init(argc, argv, "benchmark_shm_transport",
+              ros::init_options::AnonymousName);
+
+    const std::string mode = (argc > 1) ? argv[1] : "";
+    if (mode == "pub") {
+        uint32_t width = (argc > 3) ? (uint32_t)std::atoi(argv[2]) : 1920;
+        uint32_t height = (argc > 3) ? (uint32_t)std::atoi(argv[3]) : 1080;
+        double rate = (argc > 4) ? std::atof(argv[4]) : 60.0;
+        if (width == 0 || height == 0 || rate <= 0.0) {
+            std::fprintf(stderr, "usage: %s pub [width height] [rate]\n",
+                         argv[0]);
+            return 1;
+        }
+        return Publish(width, height, rate);
+    }
+    if (mode == "sub") {
+        double seconds = (argc > 2) ? std::atof(argv[2]) : 10.0;
+        if (seconds <= 0.0) {
+            std::fprintf(stderr, "usage: %s sub [seconds per transport]\n",
+                         argv[0]);
+            return 1;
+        }
+        Measure("raw", seconds);
+        Measure("shm", seconds);
+        return 0;
+    }
+
+    std::fprintf(stderr, "usage: %s pub [width height] [rate]\n"
+                         "       %s sub [seconds per transport]\n",
+                 argv[0], argv[0]);
+    return 1;
+}
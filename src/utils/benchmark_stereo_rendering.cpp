@@ -0,0 +1,189 @@
+//
+// Compares the frame time of the ways of rendering the two eyes:
+//  - two windows, one renderer per eye
+//  - one window, one renderer per eye in the two halves (one_window_mode)
+//  - one window, one renderer drawing both eyes (single_pass_stereo)
+// each without shadows, with shadows baked at each frame and with shadows
+// baked only when the scene changed (static here). The windows are rendered
+// off screen, over the camera images, and read back synchronously at each
+// frame so that the time includes the work of the GPU. The windows have the
+// size of the camera images, e.g. 1920 1080 for an HD endoscope, and the
+// virtual scene can be rendered at a fraction of it.
+//
+// usage: benchmark_stereo_rendering [iterations] [spheres per side]
+//                                   [width height] [scene render scale]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <vtkActor.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkSphereSource.h>
+#include "../ar_core/Rendering.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Mode {
+    const char *name;
+    uint num_windows;
+    bool single_pass_stereo;
+};
+
+struct FrameTimes {
+    double render_mean;
+    double render_p95;
+    double frame_mean;
+    double frame_p95;
+};
+
+//------------------------------------------------------------------------------
+void MeanAndP95(std::vector<double> &times, double &mean, double &p95) {
+
+    mean = 0.0;
+    for (size_t i = 0; i < times.size(); ++i)
+        mean += times[i];
+    mean /= (double)times.size();
+
+    std::sort(times.begin(), times.end());
+    p95 = times[std::min(times.size() - 1, (size_t)(0.95 * times.size()))];
+}
+
+//------------------------------------------------------------------------------
+// A grid of spheres in front of the cameras
+std::vector<vtkSmartPointer<vtkProp> > CreateScene(const int spheres_per_side) {
+
+    std::vector<vtkSmartPointer<vtkProp> > actors;
+    const double spacing = 0.02;
+    const double offset = -0.5 * spacing * (spheres_per_side - 1);
+
+    for (int i = 0; i < spheres_per_side; ++i) {
+        for (int j = 0; j < spheres_per_side; ++j) {
+            vtkSmartPointer<vtkSphereSource> source =
+                    vtkSmartPointer<vtkSphereSource>::New();
+            source->SetRadius(0.008);
+            source->SetThetaResolution(48);
+            source->SetPhiResolution(48);
+            source->SetCenter(offset + i * spacing, offset + j * spacing,
+                              0.01 * ((i + j) % 3));
+
+            vtkSmartPointer<vtkPolyDataMapper> mapper =
+                    vtkSmartPointer<vtkPolyDataMapper>::New();
+            mapper->SetInputConnection(source->GetOutputPort());
+
+            vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
+            actor->SetMapper(mapper);
+            actors.push_back(actor);
+        }
+    }
+    return actors;
+}
+
+//------------------------------------------------------------------------------
+// shadows: 0 none, 1 baked at each frame, 2 baked on change
+FrameTimes Benchmark(const Mode &mode, const int shadows,
+                     const int iterations, const int spheres_per_side,
+                     const cv::Size &image_size, const double scene_scale) {
+
+    Rendering *graphics = new Rendering(true, mode.num_windows, shadows > 0,
+                                        true, std::vector<int>(4, 0),
+                                        mode.single_pass_stereo);
+    graphics->SetShadowBakeOnlyOnChange(shadows == 2);
+    graphics->SetSceneRenderScale(scene_scale);
+
+    // the same field of view at all resolutions
+    const double f = 1.25 * image_size.width;
+    cv::Mat intrinsics[2];
+    cv::Mat camera_images[2];
+    for (int i = 0; i < 2; ++i) {
+        intrinsics[i] = (cv::Mat_<double>(3, 3)
+                << f, 0.0, 0.5 * (image_size.width - 1),
+                   0.0, f, 0.5 * (image_size.height - 1),
+                   0.0, 0.0, 1.0);
+        camera_images[i] = cv::Mat(image_size, CV_8UC3,
+                                   cv::Scalar(90, 60, 60));
+    }
+    // 5 mm baseline, 30 cm from the scene
+    const cv::Vec3d rvec[2] = {cv::Vec3d(0.0, 0.0, 0.0),
+                               cv::Vec3d(0.0, 0.0, 0.0)};
+    const cv::Vec3d tvec[2] = {cv::Vec3d(0.0, 0.0, 0.3),
+                               cv::Vec3d(-0.005, 0.0, 0.3)};
+
+    graphics->SetCameraIntrinsics(intrinsics);
+    graphics->ConfigureBackgroundImage(camera_images);
+    graphics->SetEnableBackgroundImage(true);
+    graphics->SetWorldToCameraTransform(rvec, tvec);
+    graphics->UpdateCameraViewForActualWindowSize();
+    graphics->AddActorsToScene(CreateScene(spheres_per_side));
+
+    cv::Mat rendered[2];
+    for (int i = 0; i < 10; ++i) {
+        graphics->Render();
+        graphics->GetRenderedImage(rendered);
+    }
+
+    std::vector<double> render_times, frame_times;
+    for (int i = 0; i < iterations; ++i) {
+        graphics->UpdateBackgroundImage(camera_images);
+
+        Clock::time_point start = Clock::now();
+        graphics->Render();
+        Clock::time_point rendered_time = Clock::now();
+        graphics->GetRenderedImage(rendered);
+        Clock::time_point end = Clock::now();
+
+        render_times.push_back(std::chrono::duration<double, std::milli>(
+                rendered_time - start).count());
+        frame_times.push_back(std::chrono::duration<double, std::milli>(
+                end - start).count());
+    }
+    delete graphics;
+
+    FrameTimes times;
+    MeanAndP95(render_times, times.render_mean, times.render_p95);
+    MeanAndP95(frame_times, times.frame_mean, times.frame_p95);
+    return times;
+}
+
+//------------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 300;
+    const int spheres_per_side = argc > 2 ? std::atoi(argv[2]) : 8;
+    const cv::Size image_size(argc > 4 ? std::atoi(argv[3]) : 640,
+                              argc > 4 ? std::atoi(argv[4]) : 480);
+    const double scene_scale = argc > 5 ? std::atof(argv[5]) : 1.0;
+    if (iterations < 1 || spheres_per_side < 1 || image_size.area() <= 0
+        || scene_scale <= 0.0 || scene_scale > 1.0) {
+        printf("usage: %s [iterations] [spheres per side] [width height] "
+               "[scene render scale]\n", argv[0]);
+        return 1;
+    }
+
+    const Mode modes[3] = {{"two windows", 2, false},
+                           {"one window", 1, false},
+                           {"single pass", 1, true}};
+
+    printf("%d iterations, %d spheres, 2 x %dx%d, scene at %.2f\n\n",
+           iterations, spheres_per_side * spheres_per_side, image_size.width,
+           image_size.height, scene_scale);
+    printf("%-14s %-8s %17s %17s %17s %17s\n", "mode", "shadows",
+           "render mean [ms]", "render p95 [ms]", "frame mean [ms]",
+           "frame p95 [ms]");
+
+    const char *shadow_names[3] = {"no", "yes", "change"};
+    for (int shadows = 0; shadows < 3; ++shadows) {
+        for (int m = 0; m < 3; ++m) {
+            FrameTimes times = Benchmark(modes[m], shadows, iterations,
+                                         spheres_per_side, image_size,
+                                         scene_scale);
+            printf("%-14s %-8s %17.3f %17.3f %17.3f %17.3f\n", modes[m].name,
+                   shadow_names[shadows], times.render_mean,
+                   times.render_p95, times.frame_mean, times.frame_p95);
+        }
+    }
+
+    return 0;
+}